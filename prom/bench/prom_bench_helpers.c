@@ -0,0 +1,106 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "prom_bench_helpers.h"
+
+typedef struct pbh_thread {
+	pthread_t tid;
+	unsigned int idx;
+	size_t ops;
+	pbh_thread_fn *fn;
+	void *arg;
+	pthread_barrier_t *barrier;
+} pbh_thread_t;
+
+double
+pbh_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *
+pbh_thread_main(void *data) {
+	pbh_thread_t *t = (pbh_thread_t *) data;
+	pthread_barrier_wait(t->barrier);
+	t->fn(t->arg, t->idx, t->ops);
+	return NULL;
+}
+
+double
+pbh_run_threads(unsigned int thread_count, size_t ops, pbh_thread_fn *fn,
+	void *arg)
+{
+	pthread_barrier_t barrier;
+	pbh_thread_t *t = calloc(thread_count, sizeof(pbh_thread_t));
+	if (t == NULL)
+		return 0;
+
+	pthread_barrier_init(&barrier, NULL, thread_count + 1);
+	for (unsigned int i = 0; i < thread_count; i++) {
+		t[i].idx = i;
+		t[i].ops = ops;
+		t[i].fn = fn;
+		t[i].arg = arg;
+		t[i].barrier = &barrier;
+		pthread_create(&t[i].tid, NULL, pbh_thread_main, &t[i]);
+	}
+	double start = pbh_now();
+	pthread_barrier_wait(&barrier);
+	for (unsigned int i = 0; i < thread_count; i++)
+		pthread_join(t[i].tid, NULL);
+	double duration = pbh_now() - start;
+
+	pthread_barrier_destroy(&barrier);
+	free(t);
+	return (duration > 0) ? (thread_count * ops) / duration : 0;
+}
+
+unsigned int
+pbh_max_threads(unsigned int limit) {
+	const char *s = getenv("PROM_BENCH_THREADS");
+	long n = (s == NULL) ? 0 : strtol(s, NULL, 10);
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN) * 2;
+	if (n < 2)
+		n = 2;
+	return (n > limit) ? limit : n;
+}
+
+size_t
+pbh_heap_size(void) {
+#ifdef __GLIBC__
+	struct mallinfo2 mi = mallinfo2();
+	// incl. large blocks, which get mmap()ed
+	return mi.uordblks + mi.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+size_t
+pbh_ops(size_t dflt) {
+	const char *s = getenv("PROM_BENCH_OPS");
+	if (s == NULL)
+		return dflt;
+	size_t n = strtoull(s, NULL, 10);
+	return (n == 0) ? dflt : n;
+}
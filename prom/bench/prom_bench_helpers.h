@@ -0,0 +1,67 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_BENCH_HELPERS_H
+#define PROM_BENCH_HELPERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prom.h"
+#include "prom_metric_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_t.h"
+#include "prom_metric_t.h"
+
+/**
+ * @brief The function run by each benchmark thread.
+ * @param arg	The argument passed to \c pbh_run_threads().
+ * @param idx	Index of the thread, 0 .. thread_count - 1.
+ * @param ops	Number of operations to run.
+ */
+typedef void pbh_thread_fn(void *arg, unsigned int idx, size_t ops);
+
+/**
+ * @brief Get the current value of the monotonic clock in seconds.
+ */
+double pbh_now(void);
+
+/**
+ * @brief Run the given function on \c thread_count threads in parallel, each
+ *	doing \c ops operations, and measure the wall time needed.
+ * @return The number of operations per second of all threads together.
+ */
+double pbh_run_threads(unsigned int thread_count, size_t ops, pbh_thread_fn *fn, void *arg);
+
+/**
+ * @brief Get the max. number of threads to use for scaling benchmarks: 2x the
+ *	number of online CPUs, but not more than \c limit. Can be overridden with
+ *	the environment variable \c PROM_BENCH_THREADS.
+ */
+unsigned int pbh_max_threads(unsigned int limit);
+
+/**
+ * @brief Get the number of bytes currently allocated from the heap.
+ * @return \c 0 if unknown, i.e. not using glibc.
+ */
+size_t pbh_heap_size(void);
+
+/**
+ * @brief Get the number of operations to run per benchmark. Can be
+ *	overridden with the environment variable \c PROM_BENCH_OPS.
+ */
+size_t pbh_ops(size_t dflt);
+
+#endif  // PROM_BENCH_HELPERS_H
@@ -0,0 +1,107 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include "prom_bench_helpers.h"
+
+// All threads increment the same sample of a counter via its handle.
+static void
+counter_inc(void *arg, unsigned int idx, size_t ops) {
+	prom_counter_handle_t *h = (prom_counter_handle_t *) arg;
+	for (size_t i = 0; i < ops; i++)
+		prom_counter_handle_inc(h);
+}
+
+static double
+bench_counter(unsigned int threads, size_t ops, unsigned int stripes) {
+	prom_counter_t *c = prom_counter_new("bench_counter", "counter under bench",
+		0, NULL);
+	// Less than 2 stripes keep the sample on the CAS path.
+	if (stripes > 1 && prom_metric_set_stripes(c, stripes))
+		fprintf(stderr, "Unable to stripe the counter\n");
+	prom_counter_handle_t *h = prom_counter_bind(c, NULL);
+	if ((stripes > 1) != (atomic_load(&h->stripes) != NULL))
+		fprintf(stderr, "Unexpected stripes of the counter\n");
+	double r = pbh_run_threads(threads, ops, counter_inc, h);
+	if (pms_get(h) != (double) threads * ops)
+		fprintf(stderr, "Unexpected counter value %g\n", pms_get(h));
+	prom_counter_destroy(c);
+	return r;
+}
+
+typedef struct labeled_bench {
+	prom_counter_t *counter;
+	const char **values;	// one label value per thread
+} labeled_bench_t;
+
+// Each thread increments its own series of the same counter by label value.
+static void
+counter_inc_labeled(void *arg, unsigned int idx, size_t ops) {
+	labeled_bench_t *b = (labeled_bench_t *) arg;
+	const char *labels[] = { "GET", b->values[idx] };
+	for (size_t i = 0; i < ops; i++)
+		prom_counter_inc(b->counter, labels);
+}
+
+static double
+bench_counter_labeled(unsigned int threads, size_t ops) {
+	labeled_bench_t b;
+	b.counter = prom_counter_new("bench_counter", "counter under bench", 2,
+		(const char *[]) { "method", "worker" });
+	b.values = calloc(threads, sizeof(char *));
+	for (unsigned int i = 0; i < threads; i++) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "worker-%u", i);
+		b.values[i] = strdup(buf);
+		// create the series upfront, only lookups get measured
+		prom_counter_add(b.counter, 0, (const char *[]) { "GET", buf });
+	}
+	double r = pbh_run_threads(threads, ops, counter_inc_labeled, &b);
+	for (unsigned int i = 0; i < threads; i++)
+		free((char *) b.values[i]);
+	free(b.values);
+	prom_counter_destroy(b.counter);
+	return r;
+}
+
+int
+main(int argc, const char **argv) {
+	size_t ops = pbh_ops(2000000);
+	unsigned int max = pbh_max_threads(64);
+	// A stripe per CPU as prom_metric_set_stripes(c, 0) does, but striped
+	// on a single CPU, too.
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int stripes = (cpus < 2) ? 2 : cpus;
+
+	printf("# counter increments of a single sample, %zu ops/thread, "
+		"%u stripes\n", ops, stripes);
+	printf("%8s %16s %16s %8s\n", "threads", "cas ops/s", "striped ops/s",
+		"speedup");
+	for (unsigned int t = 1; t <= max; t <<= 1) {
+		double cas = bench_counter(t, ops, 0);
+		double striped = bench_counter(t, ops, stripes);
+		printf("%8u %16.0f %16.0f %8.2f\n", t, cas, striped, striped / cas);
+	}
+
+	ops /= 10;
+	printf("\n# prom_counter_inc() with a distinct label set per thread, "
+		"%zu ops/thread\n", ops);
+	printf("%8s %16s %16s\n", "threads", "ops/s", "ops/s/thread");
+	for (unsigned int t = 1; t <= max; t <<= 1) {
+		double r = bench_counter_labeled(t, ops);
+		printf("%8u %16.0f %16.0f\n", t, r, r / t);
+	}
+	return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prom_bench_helpers.h"
+#include "prom_dtoa_i.h"
+#include "prom_metric_formatter_i.h"
+#include "prom_metric_formatter_t.h"
+#include "prom_string_builder.h"
+
+static size_t sink;
+
+// Whole numbers (counters) and random fractions (gauges, sums) mixed 1:1
+static double *
+make_values(size_t n) {
+	double *v = malloc(n * sizeof(double));
+	unsigned int seed = 42;
+	for (size_t i = 0; v != NULL && i < n; i++) {
+		v[i] = (i & 1)
+			? (double) rand_r(&seed)
+			: rand_r(&seed) * 1e-3 / RAND_MAX * rand_r(&seed);
+	}
+	return v;
+}
+
+static void
+bench_dtoa(const double *v, size_t n) {
+	char buf[64];
+	size_t r = 0;
+
+	double start = pbh_now();
+	for (size_t i = 0; i < n; i++)
+		r += sprintf(buf, " %.17g", v[i]);
+	double d_sprintf = pbh_now() - start;
+
+	start = pbh_now();
+	for (size_t i = 0; i < n; i++)
+		r += prom_dtoa(v[i], buf);
+	double d_dtoa = pbh_now() - start;
+	sink += r;
+
+	printf("# formatting %zu values\n%-12s %12s\n", n, "function", "ns/op");
+	printf("%-12s %12.2f\n", "sprintf", d_sprintf * 1e9 / n);
+	printf("%-12s %12.2f\n\n", "prom_dtoa", d_dtoa * 1e9 / n);
+}
+
+static void
+bench_scrape(const double *v, size_t n) {
+	const char *keys[] = { "series" };
+	char label[32];
+	const char *values[] = { label };
+	prom_gauge_t *g = prom_gauge_new("bench_gauge", "gauge under bench", 1,
+		keys);
+	for (size_t i = 0; i < n; i++) {
+		sprintf(label, "%zu", i);
+		prom_gauge_set(g, v[i], values);
+	}
+	pmf_t *pmf = pmf_new();
+
+	// What pmf_load_sample() did before: sprintf(" %.17g")
+	char buf[64];
+	double start = pbh_now();
+	prom_map_iter_t iter;
+	prom_map_iter_init(&iter, g->samples);
+	while (prom_map_iter_next(&iter)) {
+		pms_t *s = (pms_t *) iter.value;
+		pmf_load_l_value(pmf, g->name, NULL, 1, keys, s->label_values);
+		sprintf(buf, " %.17g", pms_get(s));
+		psb_add_str(pmf->string_builder, buf);
+		psb_add_char(pmf->string_builder, '\n');
+	}
+	double d_sprintf = pbh_now() - start;
+	size_t len_sprintf = psb_len(pmf->string_builder);
+	pmf_clear(pmf);
+
+	start = pbh_now();
+	pmf_load_metric(pmf, g, NULL, true);
+	double d_pmf = pbh_now() - start;
+	size_t len_pmf = psb_len(pmf->string_builder);
+
+	printf("# rendering %zu samples\n%-12s %12s %12s\n", n, "function", "ms",
+		"bytes");
+	printf("%-12s %12.1f %12zu\n", "sprintf", d_sprintf * 1e3, len_sprintf);
+	printf("%-12s %12.1f %12zu\n", "pmf", d_pmf * 1e3, len_pmf);
+	pmf_destroy(pmf);
+	prom_gauge_destroy(g);
+}
+
+// Change the value of every step-th sample of the given metric.
+static void
+touch(prom_metric_t *m, size_t step) {
+	prom_map_iter_t iter;
+	size_t i = 0;
+
+	prom_map_iter_init(&iter, m->samples);
+	while (prom_map_iter_next(&iter)) {
+		if (i++ % step != 0)
+			continue;
+		if (m->type == PROM_HISTOGRAM)
+			pms_histogram_observe(iter.value, 0.5);
+		else
+			pms_add(iter.value, 1);
+	}
+}
+
+static double
+render(pmf_t *pmf, prom_metric_t *g, prom_metric_t *h) {
+	pmf_clear(pmf);
+	double start = pbh_now();
+	pmf_load_metric(pmf, g, NULL, false);
+	pmf_load_metric(pmf, h, NULL, false);
+	return pbh_now() - start;
+}
+
+static void
+bench_formats(const double *v, size_t n) {
+	static const char *names[PROM_FORMAT_COUNT] = { "text", "protobuf",
+		"openmetrics" };
+	const char *keys[] = { "series", "code" };
+	char label[32];
+	const char *values[] = { label, "200" };
+	prom_gauge_t *g = prom_gauge_new("bench_gauge", "gauge under bench", 2,
+		keys);
+	prom_histogram_t *h = prom_histogram_new("bench_histogram",
+		"histogram under bench", phb_exponential(0.001, 2, 16), 2, keys);
+	for (size_t i = 0; i < n; i++) {
+		sprintf(label, "%zu", i);
+		prom_gauge_set(g, v[i], values);
+		// fewer histograms, they render ~20 lines each
+		if ((i & 15) == 0)
+			prom_histogram_observe(h, v[i], values);
+	}
+	pmf_t *pmf = pmf_new();
+
+	// Samples render from scratch after a change, otherwise from the line
+	// cached by the previous scrape of the same format.
+	printf("\n# rendering %zu gauge and %zu histogram samples\n"
+		"%-12s %12s %12s %12s %12s\n", n, (n + 15) / 16, "format",
+		"all ms", "1% ms", "none ms", "bytes");
+	for (int f = 0; f < PROM_FORMAT_COUNT; f++) {
+		// Warm up, so that no format pays for growing the buffer.
+		pmf->format = f;
+		render(pmf, g, h);
+		touch(g, 1);
+		touch(h, 1);
+		double all = render(pmf, g, h);
+		touch(g, 100);
+		touch(h, 100);
+		double some = render(pmf, g, h);
+		double none = render(pmf, g, h);
+		printf("%-12s %12.1f %12.1f %12.1f %12zu\n", names[f], all * 1e3,
+			some * 1e3, none * 1e3, psb_len(pmf->string_builder));
+	}
+	pmf_destroy(pmf);
+	prom_histogram_destroy(h);
+	prom_gauge_destroy(g);
+}
+
+// Heap used by the given number of label sets of a gauge, whose label values
+// mostly repeat across series
+static void
+bench_memory(size_t n) {
+	static const char *methods[] = { "GET", "PUT", "POST", "DELETE" };
+	static const char *codes[] = { "200", "204", "404", "500", "503" };
+	const char *keys[] = { "path", "method", "code" };
+	char label[32];
+	const char *values[] = { label, NULL, NULL };
+
+	prom_gauge_t *g = prom_gauge_new("bench_gauge", "gauge under bench", 3,
+		keys);
+	size_t before = pbh_heap_size();
+	if (before == 0) {
+		prom_gauge_destroy(g);
+		return;
+	}
+	for (size_t i = 0; i < n; i++) {
+		sprintf(label, "/api/v1/endpoint/%zu", i / 20);
+		values[1] = methods[i % 4];
+		values[2] = codes[i / 4 % 5];
+		prom_gauge_set(g, i, values);
+	}
+	size_t created = pbh_heap_size();
+	// scrapes keep the rendered lines of each series
+	pmf_t *pmf = pmf_new();
+	pmf_load_metric(pmf, g, NULL, false);
+	pmf_destroy(pmf);
+	size_t rendered = pbh_heap_size();
+	prom_gauge_destroy(g);
+
+	printf("# memory of %zu gauge series, 3 labels\n%-12s %12s\n", n,
+		"state", "bytes/series");
+	printf("%-12s %12zu\n", "created", (created - before) / n);
+	printf("%-12s %12zu\n\n", "rendered", (rendered - before) / n);
+}
+
+int
+main(int argc, const char **argv) {
+	size_t n = pbh_ops(1000000);
+	bench_memory(100000);
+	double *v = make_values(n);
+	if (v == NULL)
+		return 1;
+	bench_dtoa(v, n);
+	bench_scrape(v, n);
+	bench_formats(v, n);
+	free(v);
+	return sink == 0;
+}
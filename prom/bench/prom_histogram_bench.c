@@ -0,0 +1,130 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prom_bench_helpers.h"
+#include "prom_histogram_buckets_i.h"
+#include "prom_metric_formatter_i.h"
+
+// Uniformly distributed over the bucket range plus 10% above, to hit +Inf.
+static double *
+make_values(phb_t *b, size_t n) {
+	double *v = malloc(n * sizeof(double));
+	double max = b->upper_bound[phb_count(b) - 1] * 1.1;
+	unsigned int seed = 42;
+	for (size_t i = 0; v != NULL && i < n; i++)
+		v[i] = max * rand_r(&seed) / RAND_MAX;
+	return v;
+}
+
+static size_t sink;
+
+static void
+bench_kernel(const char *name, phb_search_fn *fn, phb_t *b,
+	const double *v, size_t n, size_t ops)
+{
+	size_t r = 0, count = phb_count(b);
+	if (!phb_search_supported(fn)) {
+		printf("%-12s %12s\n", name, "n/a");
+		return;
+	}
+	double start = pbh_now();
+	for (size_t i = 0; i < ops; i++)
+		r += fn(b->upper_bound, count, v[i % n]);
+	double d = pbh_now() - start;
+	sink += r;
+	printf("%-12s %12.2f\n", name, d * 1e9 / ops);
+}
+
+static void
+bench_buckets(const char *title, phb_t *b, size_t ops) {
+	size_t n = 4096;
+	double *v = make_values(b, n);
+	if (v == NULL)
+		return;
+
+	printf("# %s, %zu buckets, %zu ops\n%-12s %12s\n", title, phb_count(b),
+		ops, "kernel", "ns/op");
+	bench_kernel("scan", phb_search_scan, b, v, n, ops);
+	bench_kernel("branchless", phb_search_branchless, b, v, n, ops);
+	bench_kernel("sse2", phb_search_sse2, b, v, n, ops);
+	bench_kernel("avx2", phb_search_avx2, b, v, n, ops);
+
+	size_t r = 0;
+	double start = pbh_now();
+	for (size_t i = 0; i < ops; i++)
+		r += phb_index(b, v[i % n]);
+	double d = pbh_now() - start;
+	sink += r;
+	printf("%-12s %12.2f\n", "phb_index", d * 1e9 / ops);
+
+	prom_histogram_t *h = prom_histogram_new("bench_histogram",
+		"histogram under bench", b, 0, NULL);
+	prom_histogram_handle_t *hh = prom_histogram_bind(h, NULL);
+	start = pbh_now();
+	for (size_t i = 0; i < ops; i++)
+		prom_histogram_handle_observe(hh, v[i % n]);
+	d = pbh_now() - start;
+	printf("%-12s %12.2f\n\n", "observe", d * 1e9 / ops);
+	prom_histogram_destroy(h);	// destroys b as well
+	free(v);
+}
+
+// Heap used by the given number of label sets of a histogram with 20 buckets
+static void
+bench_memory(size_t n) {
+	const char *keys[] = { "path", "code" };
+	char label[32];
+	const char *values[] = { label, "200" };
+
+	prom_histogram_t *h = prom_histogram_new("bench_histogram",
+		"histogram under bench", phb_exponential(0.0001, 2, 20), 2, keys);
+	size_t before = pbh_heap_size();
+	if (before == 0) {
+		prom_histogram_destroy(h);
+		return;
+	}
+	for (size_t i = 0; i < n; i++) {
+		sprintf(label, "/api/v1/endpoint/%zu", i);
+		prom_histogram_observe(h, i * 1e-4, values);
+	}
+	size_t created = pbh_heap_size();
+	// scrapes keep the rendered lines of each series
+	pmf_t *pmf = pmf_new();
+	pmf_load_metric(pmf, h, NULL, false);
+	pmf_destroy(pmf);
+	size_t rendered = pbh_heap_size();
+	prom_histogram_destroy(h);
+
+	printf("# memory of %zu histogram series, 20 buckets\n%-12s %12s\n", n,
+		"state", "bytes/series");
+	printf("%-12s %12zu\n", "created", (created - before) / n);
+	printf("%-12s %12zu\n\n", "rendered", (rendered - before) / n);
+}
+
+int
+main(int argc, const char **argv) {
+	size_t ops = pbh_ops(10000000);
+
+	bench_memory(5000);
+
+	bench_buckets("linear", phb_linear(0.005, 0.005, 60), ops);
+	bench_buckets("exponential", phb_exponential(0.0001, 1.3, 40), ops);
+	bench_buckets("arbitrary (default)", phb_new(11, 0.005, 0.01, 0.025, 0.05,
+		0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0), ops);
+	bench_buckets("arbitrary", phb_new(30, 0.001, 0.002, 0.003, 0.005, 0.0075,
+		0.01, 0.015, 0.02, 0.03, 0.05, 0.075, 0.1, 0.15, 0.2, 0.3, 0.5, 0.75,
+		1.0, 1.5, 2.0, 3.0, 5.0, 7.5, 10.0, 15.0, 20.0, 30.0, 50.0, 75.0,
+		100.0), ops);
+	return sink == 0;
+}
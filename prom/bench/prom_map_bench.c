@@ -0,0 +1,126 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prom_bench_helpers.h"
+#include "prom_map_i.h"
+#include "prom_map_t.h"
+
+// l_value like keys
+static char **
+make_keys(size_t n, const char *fmt) {
+	char **keys = malloc(n * sizeof(char *));
+	char buf[128];
+	for (size_t i = 0; keys != NULL && i < n; i++) {
+		snprintf(buf, sizeof(buf), fmt, i % 97, i);
+		keys[i] = strdup(buf);
+	}
+	return keys;
+}
+
+static void
+free_keys(char **keys, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		free(keys[i]);
+	free(keys);
+}
+
+static void
+bench_map(size_t n, size_t ops) {
+	char **keys = make_keys(n, "http_requests_total{method=\"GET\",code=\"%zu\","
+		"path=\"/api/v1/item/%zu\"}");
+	char **misses = make_keys(n, "http_requests_total{method=\"PUT\",code=\"%zu\","
+		"path=\"/api/v1/item/%zu\"}");
+	if (keys == NULL || misses == NULL)
+		return;
+	prom_map_t *map = prom_map_new();
+	size_t sink = 0;
+
+	double start = pbh_now();
+	for (size_t i = 0; i < n; i++)
+		prom_map_set(map, keys[i], keys[i]);
+	double set = (pbh_now() - start) * 1e9 / n;
+
+	start = pbh_now();
+	for (size_t i = 0; i < ops; i++)
+		sink += prom_map_get(map, keys[(i * 7919) % n]) != NULL;
+	double hit = (pbh_now() - start) * 1e9 / ops;
+
+	start = pbh_now();
+	for (size_t i = 0; i < ops; i++)
+		sink += prom_map_get(map, misses[(i * 7919) % n]) != NULL;
+	double miss = (pbh_now() - start) * 1e9 / ops;
+
+	size_t rounds = (ops + n - 1) / n;
+	start = pbh_now();
+	for (size_t r = 0; r < rounds; r++) {
+		prom_map_iter_t iter;
+		prom_map_iter_init(&iter, map);
+		while (prom_map_iter_next(&iter))
+			sink += iter.value != NULL;
+	}
+	double iterate = (pbh_now() - start) * 1e9 / (rounds * n);
+
+	if (sink != ops + rounds * n)
+		fprintf(stderr, "Unexpected result %zu\n", sink);
+	printf("%10zu %10.1f %10.1f %10.1f %10.2f\n", n, set, hit, miss, iterate);
+	prom_map_destroy(map);
+	free_keys(keys, n);
+	free_keys(misses, n);
+}
+
+// Worst case latency of a single insert, in particular of those, which
+// trigger a resize of the table
+static void
+bench_insert_latency(size_t n) {
+	char **keys = make_keys(n, "http_requests_total{code=\"%zu\",id=\"%zu\"}");
+	if (keys == NULL)
+		return;
+	prom_map_t *map = prom_map_new();
+	double worst = 0, worst_resize = 0;
+	size_t worst_at = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		size_t resizes = map->resizes;
+		double start = pbh_now();
+		prom_map_set(map, keys[i], keys[i]);
+		double d = pbh_now() - start;
+		if (d > worst) {
+			worst = d;
+			worst_at = i;
+		}
+		if (resizes != map->resizes && d > worst_resize)
+			worst_resize = d;
+	}
+	printf("\n# prom_map, latency of %zu inserts\n", n);
+	printf("%-24s %10.3f ms at %zu keys\n", "worst insert", worst * 1e3,
+		worst_at);
+	printf("%-24s %10.3f ms of %zu resizes\n", "worst resizing insert",
+		worst_resize * 1e3, map->resizes);
+	printf("%-24s %10zu slots\n", "max. migrated per insert", map->moved_max);
+	prom_map_destroy(map);
+	free_keys(keys, n);
+}
+
+int
+main(int argc, const char **argv) {
+	size_t ops = pbh_ops(2000000);
+
+	printf("# prom_map, %zu lookups per size, ns/op\n", ops);
+	printf("%10s %10s %10s %10s %10s\n", "keys", "set", "get hit", "get miss",
+		"iterate");
+	for (size_t n = 1000; n <= 1000000; n *= 10)
+		bench_map(n, ops);
+	bench_insert_latency(1000000);
+	return 0;
+}
@@ -117,6 +117,22 @@ limitations under the License.
  * This function will increment the default metric sample for my_counter. Since
  * we are not using metric labels, we pass \c NULL as the second argument.
  *
+ * Each such call has to find the sample for the given label values first. On
+ * hot paths bind the sample once and update it via its handle instead, which
+ * is a single atomic operation without any lookup, lock or allocation:
+ *
+ * @code{.c}
+ *
+ * prom_counter_handle_t *get_ok = prom_counter_bind(requests, (const char *[]) { "GET", "200" });
+ *
+ * void my_lib_handle_get(void) {
+ *   prom_counter_handle_inc(get_ok);
+ * }
+ * @endcode
+ *
+ * Metrics without labels get their handle bound on construction, so
+ * \c prom_counter_bind(my_counter, NULL) is just a cheap field access.
+ *
  *
  * @section Metric-Exposition-Over-HTTP Metric Exposition Over HTTP
  *
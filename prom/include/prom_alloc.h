@@ -26,23 +26,110 @@ limitations under the License.
 #include <string.h>
 
 /**
- * @brief Redefine this macro if you wish to override it. The default value is malloc.
+ * @brief Allocates \c size bytes of uninitialized memory.
+ * @param ctx	The context passed to prom_set_allocator().
  */
-#define prom_malloc malloc
+typedef void *(*prom_malloc_fn)(size_t size, void *ctx);
 
 /**
- * @brief Redefine this macro if you wish to override it. The default value is realloc.
+ * @brief Resizes the given block to \c size bytes like \c realloc(3).
+ * @param ctx	The context passed to prom_set_allocator().
  */
-#define prom_realloc realloc
+typedef void *(*prom_realloc_fn)(void *ptr, size_t size, void *ctx);
 
 /**
- * @brief Redefine this macro if you wish to override it. The default value is strdup.
+ * @brief Releases the given block. Gets never called with \c NULL.
+ * @param ctx	The context passed to prom_set_allocator().
  */
-#define prom_strdup strdup
+typedef void (*prom_free_fn)(void *ptr, void *ctx);
 
 /**
- * @brief Redefine this macro if you wish to override it. The default value is free.
+ * @brief Set the allocator used for all memory of the library. By default
+ *	the allocator of the libc gets used.
+ *
+ * Since memory must be released by the allocator it was obtained from, this
+ * needs to be done before anything else of the library gets used, i.e.
+ * before \c pcr_init() or creating any metric. Also it is not thread-safe.
+ * Memory returned to the application (e.g. by \c pcr_bridge()) must be
+ * released using \c prom_free().
+ *
+ * Fixed size objects like histogram samples get carved from larger blocks,
+ * so the allocator sees fewer, larger requests than the library makes.
+ * @param malloc_fn		Function to allocate memory.
+ * @param realloc_fn	Function to resize memory.
+ * @param free_fn		Function to release memory.
+ * @param ctx			Passed as is to the functions above, e.g. an arena.
+ * @return \c 0 on success, a non-zero value if a function is \c NULL or the
+ *	library has already allocated memory.
  */
-#define prom_free free
+int prom_set_allocator(prom_malloc_fn malloc_fn, prom_realloc_fn realloc_fn, prom_free_fn free_fn, void *ctx);
+
+/**
+ * @brief Allocate memory using the allocator set via prom_set_allocator().
+ */
+void *prom_alloc_malloc(size_t size);
+
+/**
+ * @brief Allocate zeroed memory using the allocator set via
+ *	prom_set_allocator().
+ */
+void *prom_alloc_calloc(size_t count, size_t size);
+
+/**
+ * @brief Resize memory using the allocator set via prom_set_allocator().
+ */
+void *prom_alloc_realloc(void *ptr, size_t size);
+
+/**
+ * @brief Copy the given string using the allocator set via
+ *	prom_set_allocator().
+ */
+char *prom_alloc_strdup(const char *s);
+
+/**
+ * @brief Release memory obtained from one of the functions above. \c NULL is
+ *	ignored.
+ */
+void prom_alloc_free(void *ptr);
+
+#ifndef prom_malloc
+/**
+ * @brief Define this macro if you wish to override it at compile time. The
+ *	default value is prom_alloc_malloc.
+ */
+#define prom_malloc prom_alloc_malloc
+#endif
+
+#ifndef prom_calloc
+/**
+ * @brief Define this macro if you wish to override it at compile time. The
+ *	default value is prom_alloc_calloc.
+ */
+#define prom_calloc prom_alloc_calloc
+#endif
+
+#ifndef prom_realloc
+/**
+ * @brief Define this macro if you wish to override it at compile time. The
+ *	default value is prom_alloc_realloc.
+ */
+#define prom_realloc prom_alloc_realloc
+#endif
+
+#ifndef prom_strdup
+/**
+ * @brief Define this macro if you wish to override it at compile time. The
+ *	default value is prom_alloc_strdup.
+ */
+#define prom_strdup prom_alloc_strdup
+#endif
+
+#ifndef prom_free
+/**
+ * @brief Define this macro if you wish to override it at compile time. The
+ *	default value is prom_alloc_free.
+ */
+#define prom_free prom_alloc_free
+#endif
 
 #endif  // PROM_ALLOC_H
@@ -128,6 +128,36 @@ int prom_collector_add_metric(prom_collector_t *self, prom_metric_t *metric);
  */
 int prom_collector_set_collect_fn(prom_collector_t *self, prom_collect_fn *fn);
 
+/**
+ * @brief Set the time budget of the given collector. If collecting and
+ *	rendering its metrics takes longer, the export continues without waiting
+ *	for it and contains the last export of the collector, which was in time,
+ *	if any. Each miss gets counted by the registry's \c METRIC_NAME_TIMEOUTS
+ *	counter.
+ * @param self		The collector in question.
+ * @param timeout	The budget in ms. \c 0 means no budget (the default).
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ * @note Budgets get enforced only, if the registry has workers.
+ * @see \c pcr_set_workers(), \c pcr_bridge_timeout()
+ */
+int prom_collector_set_timeout(prom_collector_t *self, unsigned int timeout);
+
+/**
+ * @brief Refresh the metrics of the given collector periodically instead of
+ *	on each export. A thread of the registry calls its collect function every
+ *	\c interval ms and keeps the result as snapshot, and exports just copy the
+ *	latest snapshot. So the time needed to collect the metrics does not add
+ *	to the scrape latency anymore. The age of the snapshot gets exported via
+ *	the registry's \c METRIC_NAME_SNAPSHOT_AGE gauge.
+ * @param self		The collector in question.
+ * @param interval	Refresh interval in ms. \c 0 means collect on export
+ *	(the default).
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ * @note Must be set before the collector gets registered.
+ * @see \c pcr_register_collector()
+ */
+int prom_collector_set_interval(prom_collector_t *self, unsigned int interval);
+
 /**
  * @brief Attach custom data to the given collector as well as the callback to
  * use to clean it up.
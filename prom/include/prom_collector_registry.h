@@ -24,6 +24,8 @@ limitations under the License.
 #define PROM_REGISTRY_H
 
 #include <stdbool.h>
+#include <sys/types.h>
+
 #include "prom_collector.h"
 #include "prom_metric.h"
 
@@ -33,6 +35,20 @@ limitations under the License.
 /** @brief	Reserved name for libprom's own scrape duration metric.
 	@note Do not use unless you know, what you are doing. */
 #define METRIC_NAME_SCRAPE "scrape_duration_seconds"
+/** @brief	Reserved name for libprom's own counter of collectors, which
+		missed their scrape deadline. Labeled with the name of the collector.
+	@note Do not use unless you know, what you are doing. */
+#define METRIC_NAME_TIMEOUTS "collector_timeouts_total"
+/** @brief	Reserved name for libprom's own gauge of the age of the snapshots
+		of periodically refreshed collectors in seconds. Labeled with the name
+		of the collector.
+	@note Do not use unless you know, what you are doing. */
+#define METRIC_NAME_SNAPSHOT_AGE "collector_snapshot_age_seconds"
+/** @brief	Reserved name for libprom's own counter of new series, which got
+		dropped or folded into the overflow series of their metric.
+		Labeled with the name of the metric.
+	@note Do not use unless you know, what you are doing. */
+#define METRIC_NAME_REJECTED "series_rejected_total"
 /** @brief	Reserved name for libprom's own default prom collector, where
 		usually new metrics get attached.
 	@note	Do not use unless you know, what you are doing. */
@@ -140,6 +156,42 @@ int pcr_destroy(pcr_t *self);
  */
 int pcr_enable_process_metrics(pcr_t *self);
 
+/**
+ * @brief Reserve a fixed memory budget for the metrics of the given registry,
+ *	so that updating them never calls the allocator anymore.
+ *
+ * Applies prom_metric_set_capacity() to all metrics registered with the
+ * registry so far and, if it is the default registry, to all metrics
+ * registered via pcr_register_metric() later on. Metrics added to a
+ * collector afterwards otherwise need to be handled by the caller. Also each
+ * thread updating metrics needs some state once, which gets reserved as well.
+ * So call it on startup, e.g. right after pcr_init().
+ *
+ * @param self			Registry whose metrics to handle.
+ * @param series		Max. number of series per metric.
+ * @param label_bytes	Bytes of label storage per metric.
+ * @param threads		Max. number of threads updating metrics at the same
+ *	time.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int pcr_set_capacity(pcr_t *self, size_t series, size_t label_bytes, unsigned int threads);
+
+/**
+ * @brief Limit the number of series of each metric of the given registry.
+ *
+ * Applies prom_metric_set_max_series() to all metrics registered with the
+ * registry so far and, if it is the default registry, to all metrics
+ * registered via pcr_register_metric() later on. The number of new series
+ * folded into an overflow series gets exported per metric by the counter
+ * \c METRIC_NAME_REJECTED of the registry's default collector.
+ *
+ * @param self		Registry whose metrics to limit.
+ * @param series	Max. number of series per metric besides the overflow
+ *	series. \c 0 means unlimited.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int pcr_set_max_series(pcr_t *self, size_t series);
+
 /**
  * @brief Create a scrape duration gauge metric and attach it to the given
  *	prom collector registry. If available, \c pcr_bridge()
@@ -151,6 +203,25 @@ int pcr_enable_process_metrics(pcr_t *self);
  */
 int pcr_enable_scrape_metrics(pcr_t *self);
 
+/**
+ * @brief Set the number of threads, which run the collectors of the given
+ *	registry concurrently on export. Each collector gets rendered into its own
+ *	buffer and the buffers get concatenated in registry order, so the export
+ *	is the same as without workers. Per default there are no workers, i.e.
+ *	all collectors run one after another in the calling thread.
+ *
+ *	With workers \c pcr_cursor_read() renders the whole export on the first
+ *	call, so its memory usage is the same as with \c pcr_bridge().
+ *
+ * @param self	The registry to change.
+ * @param count	Number of threads to use. \c 0 stops all workers.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ * @note This function MUST NOT be called while the registry gets exported.
+ *	Stopping the workers waits for collectors still running, even if they
+ *	missed their deadline.
+ */
+int pcr_set_workers(pcr_t *self, unsigned int count);
+
 /**
  * @brief Registers a metric with the default collector on
  *	PROM_COLLECTOR_REGISTRY.
@@ -180,6 +251,8 @@ int pcr_register_metric(prom_metric_t *metric);
 /**
  * @brief Register a collector with the given registry. If the registry already
  *	contains a collector with the same name, the registration will fail.
+ *	If the collector has a refresh interval, the registry starts a thread to
+ *	refresh it, unless already running.
  * @param self	Where to register the collector.
  * @param collector The collector to register.
  * @return A non-zero integer value upon failure, \c 0 otherwise.
@@ -208,6 +281,108 @@ prom_collector_t *pcr_get(pcr_t *self, const char *name);
  */
 char *pcr_bridge(pcr_t *self);
 
+/**
+ * @brief Same as \c pcr_bridge(), but the export as a whole should not take
+ *	longer than the given time. Collectors, which did not finish in time
+ *	(see \c prom_collector_set_timeout()), contribute their last export
+ *	finished in time, or nothing. Each miss increments the counter
+ *	\c METRIC_NAME_TIMEOUTS of the registry's default collector.
+ *
+ *	A collector, which missed its deadline, keeps running in the background.
+ *	Until it returns, subsequent exports skip it and contribute its last
+ *	export instead, without counting another miss. Concurrent exports
+ *	without a miss run the collector each on its own.
+ *
+ * @param self		The registry containing the collectors with the relevant
+ *	metrics.
+ * @param timeout	The budget in ms. \c 0 means no budget except the
+ *	collectors' own ones.
+ * @return \c NULL on failure, the export otherwise.
+ * @note Budgets get enforced only, if the registry has workers. Without
+ *	workers all collectors run in the calling thread and cannot be abandoned.
+ * @see \c pcr_set_workers()
+ */
+char *pcr_bridge_timeout(pcr_t *self, unsigned int timeout);
+
+/**
+ * @brief Same as \c pcr_bridge_timeout(), but renders the export in the given
+ *	format. Binary formats like \c PROM_FORMAT_PROTOBUF may contain \c '\0'
+ *	bytes, so the caller should use the length returned via \c len.
+ *
+ * @param self		The registry containing the collectors with the relevant
+ *	metrics.
+ * @param format	The exposition format to use.
+ * @param timeout	The budget in ms. \c 0 means no budget except the
+ *	collectors' own ones.
+ * @param len		Where to store the length of the export excl. the trailing
+ *	\c '\0'. Ignored if \c NULL.
+ * @return \c NULL on failure, the export otherwise.
+ */
+char *pcr_export(pcr_t *self, prom_format_t format, unsigned int timeout,
+	size_t *len);
+
+/**
+ * @brief A cursor to export all relevant metrics of a registry piecewise.
+ * @see \c pcr_cursor_new()
+ */
+typedef struct pcr_cursor pcr_cursor_t;
+
+/**
+ * @brief Start a streaming export of all relevant metrics registered with the
+ * given registry in the default metric exposition format. Unlike
+ * \c pcr_bridge() the export never gets buffered as a whole, so memory usage
+ * stays bounded to about the size of the chunks requested via
+ * \c pcr_cursor_read(), and the first chunk is available immediately.
+ *
+ * Collectors get asked for their metrics, when the cursor reaches them. The
+ * scrape duration reported is the time spent within \c pcr_cursor_read(),
+ * i.e. it does not include the time the caller needed to process the chunks.
+ *
+ * @param self The registry containing the collectors with the relevant metrics.
+ * @return \c NULL on failure, a new cursor otherwise. It must be destroyed
+ *	using \c pcr_cursor_destroy() when no longer needed.
+ */
+pcr_cursor_t *pcr_cursor_new(pcr_t *self);
+
+/**
+ * @brief Same as \c pcr_cursor_new(), but renders the export in the given
+ *	format. Binary formats get rendered per metric family instead of per
+ *	sample.
+ * @param self		The registry containing the collectors with the relevant
+ *	metrics.
+ * @param format	The exposition format to use.
+ * @return \c NULL on failure, a new cursor otherwise.
+ */
+pcr_cursor_t *pcr_cursor_new_format(pcr_t *self, prom_format_t format);
+
+/**
+ * @brief Copy the next part of the export into the given buffer.
+ * @param self	Cursor to read from.
+ * @param buf	Where to store the data. It does not get \c '\0' terminated.
+ * @param size	The size of the buffer.
+ * @return The number of bytes stored, \c 0 if the export is complete, or
+ *	\c -1 on error.
+ */
+ssize_t pcr_cursor_read(pcr_cursor_t *self, char *buf, size_t size);
+
+/**
+ * @brief Limit the time needed to render the export of the given cursor to
+ *	the given budget, starting now. Same as for \c pcr_bridge_timeout().
+ *	Must be called before the first \c pcr_cursor_read().
+ * @param self		The cursor in question.
+ * @param timeout	The budget in ms. \c 0 means no budget.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int pcr_cursor_set_timeout(pcr_cursor_t *self, unsigned int timeout);
+
+/**
+ * @brief Destroy the given cursor. It is ok to destroy a cursor, before the
+ *	export is complete, but it must be destroyed before its registry.
+ * @param self	Cursor to destroy.
+ * @return \c 0 .
+ */
+int pcr_cursor_destroy(pcr_cursor_t *self);
+
 /**
  *@brief Validates that the given metric name complies with the specification:
  *
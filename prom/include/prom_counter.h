@@ -119,4 +119,57 @@ int prom_counter_add(prom_counter_t *self, double r_value, const char **label_va
  */
 int prom_counter_reset(prom_counter_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief A counter sample bound to a fixed set of label values.
+ *
+ * A handle points directly to the sample, so updating it neither needs to
+ * lookup the sample nor to lock or allocate anything. It stays valid until the
+ * counter it belongs to gets destroyed.
+ */
+typedef pms_t prom_counter_handle_t;
+
+/**
+ * @brief Get the handle of the counter sample with the given label values.
+ *	If the sample does not yet exist, it gets created.
+ * @param self	Counter to query.
+ * @param label_values	The label values associated with the counter sample
+ *	to bind. The number of labels must match the value passed as
+ *	\c label_key_count in the counter's constructor. If no label values are
+ *	necessary, pass \c NULL. For counters without labels the handle got
+ *	already bound on construction, so this is just a cheap field access.
+ * @return The handle on success, \c NULL otherwise.
+ *
+ * *Example*
+ *
+ *	prom_counter_handle_t *get_ok = prom_counter_bind(requests, (const char *[]) { "GET", "200" });
+ *	...
+ *	prom_counter_handle_inc(get_ok);
+ */
+prom_counter_handle_t *prom_counter_bind(prom_counter_t *self, const char **label_values);
+
+/**
+ * @brief Increment the counter sample referenced by the given handle by 1.
+ * @param handle	Handle obtained via \c prom_counter_bind().
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_counter_handle_inc(prom_counter_handle_t *handle);
+
+/**
+ * @brief Add the given value to the counter sample referenced by the given
+ *	handle.
+ * @param handle	Handle obtained via \c prom_counter_bind().
+ * @param r_value	Value to add. MUST be >= 0.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_counter_handle_add(prom_counter_handle_t *handle, double r_value);
+
+/**
+ * @brief Reset the counter sample referenced by the given handle to the given
+ *	value.
+ * @param handle	Handle obtained via \c prom_counter_bind().
+ * @param r_value	Value to set. MUST be >= 0.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_counter_handle_reset(prom_counter_handle_t *handle, double r_value);
+
 #endif  // PROM_COUNTER_H
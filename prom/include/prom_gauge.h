@@ -166,4 +166,64 @@ int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values
  */
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief A gauge sample bound to a fixed set of label values.
+ *
+ * A handle points directly to the sample, so updating it neither needs to
+ * lookup the sample nor to lock or allocate anything. It stays valid until the
+ * gauge it belongs to gets destroyed.
+ */
+typedef pms_t prom_gauge_handle_t;
+
+/**
+ * @brief Get the handle of the gauge sample with the given label values.
+ *	If the sample does not yet exist, it gets created.
+ * @param self	Gauge to query.
+ * @param label_values	The label values associated with the gauge sample
+ *	to bind. The number of labels must match the value passed as
+ *	\c label_key_count in the gauge's constructor. If no label values are
+ *	necessary, pass \c NULL.
+ * @return The handle on success, \c NULL otherwise.
+ */
+prom_gauge_handle_t *prom_gauge_bind(prom_gauge_t *self, const char **label_values);
+
+/**
+ * @brief Increment the gauge sample referenced by the given handle by 1.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_gauge_handle_inc(prom_gauge_handle_t *handle);
+
+/**
+ * @brief Decrement the gauge sample referenced by the given handle by 1.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_gauge_handle_dec(prom_gauge_handle_t *handle);
+
+/**
+ * @brief Add the given value to the gauge sample referenced by the given
+ *	handle.
+ * @param handle	Handle obtained via \c prom_gauge_bind().
+ * @param r_value	Value to add. MUST be >= 0.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_gauge_handle_add(prom_gauge_handle_t *handle, double r_value);
+
+/**
+ * @brief Subtract the given value from the gauge sample referenced by the
+ *	given handle.
+ * @param handle	Handle obtained via \c prom_gauge_bind().
+ * @param r_value	Value to substract (which might be < 0).
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_gauge_handle_sub(prom_gauge_handle_t *handle, double r_value);
+
+/**
+ * @brief Set the gauge sample referenced by the given handle to the given
+ *	value.
+ * @param handle	Handle obtained via \c prom_gauge_bind().
+ * @param r_value	Value to set (which might be < 0).
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_gauge_handle_set(prom_gauge_handle_t *handle, double r_value);
+
 #endif  // PROM_GAUGE_H
@@ -82,4 +82,34 @@ int prom_histogram_destroy(prom_histogram_t *self);
  */
 int prom_histogram_observe(prom_histogram_t *self, double value, const char **label_values);
 
+/**
+ * @brief A histogram sample bound to a fixed set of label values.
+ *
+ * A handle points directly to the sample, so observing a value does not need
+ * to lookup the sample first. It stays valid until the histogram it belongs
+ * to gets destroyed.
+ */
+typedef pms_histogram_t prom_histogram_handle_t;
+
+/**
+ * @brief Get the handle of the histogram sample with the given label values.
+ *	If the sample does not yet exist, it gets created.
+ * @param self	Histogram to query.
+ * @param label_values	The label values associated with the histogram sample
+ *	to bind. The number of labels must match the value passed as
+ *	\c label_key_count in the histogram's constructor. If no label values are
+ *	necessary, pass \c NULL.
+ * @return The handle on success, \c NULL otherwise.
+ */
+prom_histogram_handle_t *prom_histogram_bind(prom_histogram_t *self, const char **label_values);
+
+/**
+ * @brief Observe the given value using the histogram sample referenced by the
+ *	given handle.
+ * @param handle	Handle obtained via \c prom_histogram_bind().
+ * @param value		Value to observe.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_histogram_handle_observe(prom_histogram_handle_t *handle, double value);
+
 #endif  // PROM_HISTOGRAM_INCLUDED
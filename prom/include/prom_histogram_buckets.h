@@ -27,10 +27,22 @@ limitations under the License.
 #ifndef PROM_HISTOGRAM_BUCKETS_H
 #define PROM_HISTOGRAM_BUCKETS_H
 
+/**
+ * @brief How the upper bounds of a bucket got computed.
+ */
+typedef enum phb_layout {
+	PHB_ARBITRARY = 0,	/**< given explicitly, see phb_new() */
+	PHB_LINEAR,			/**< start + i * width, see phb_linear() */
+	PHB_EXPONENTIAL		/**< start * factor^i, see phb_exponential() */
+} phb_layout_t;
+
 typedef struct phb {
 	int count;						/**< Number of buckets */
 	const double *upper_bound;		/**< count ascending upper limits */
 	const char **key;				/**< count keys used to lookup samples. */
+	phb_layout_t layout;			/**< how upper_bound got computed */
+	double start;					/**< first upper bound */
+	double step;					/**< 1/width or 1/log2(factor) */
 } phb_t;
 
 /**
@@ -83,4 +95,16 @@ int phb_destroy(phb_t *self);
  */
 size_t phb_count(phb_t *self);
 
+/**
+ * @brief Get the index of the bucket the given value belongs to, i.e. of the
+ *	first upper bound, which is greater than or equal to the value.
+ *	For linear and exponential buckets it gets computed arithmetically, for
+ *	all others via the fastest search the CPU supports.
+ * @param self	The bucket to query.
+ * @param value	The value to lookup.
+ * @return The index of the bucket. If the value is greater than all upper
+ *	bounds or \c NaN, \c phb_count(self) (i.e. the +Inf bucket).
+ */
+size_t phb_index(phb_t *self, double value);
+
 #endif  // PROM_HISTOGRAM_BUCKETS_H
@@ -25,6 +25,8 @@ limitations under the License.
 #define PROM_METRIC_H
 
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef NAN
 #define NaN NAN
@@ -35,6 +37,30 @@ limitations under the License.
 #include "prom_metric_sample.h"
 #include "prom_metric_sample_histogram.h"
 
+/**
+ * @brief Exposition formats, metrics can be exported in.
+ */
+typedef enum prom_format {
+	/** Prometheus text format 0.0.4, i.e. Content-Type
+		\c "text/plain; version=0.0.4; charset=utf-8" . */
+	PROM_FORMAT_TEXT = 0,
+	/** Length delimited \c io.prometheus.client.MetricFamily protocol buffer
+		messages, i.e. Content-Type \c "application/vnd.google.protobuf;
+		proto=io.prometheus.client.MetricFamily; encoding=delimited" . */
+	PROM_FORMAT_PROTOBUF = 1,
+	/** OpenMetrics 1.0 text format, i.e. Content-Type
+		\c "application/openmetrics-text; version=1.0.0; charset=utf-8" . */
+	PROM_FORMAT_OPENMETRICS = 2
+} prom_format_t;
+
+/** @brief Number of supported exposition formats. */
+#define PROM_FORMAT_COUNT 3
+
+/** @brief Value of all labels of the series, new label sets of a metric get
+	folded into, once its series limit is reached (see
+	prom_metric_set_max_series()). */
+#define PROM_OVERFLOW_LABEL_VALUE "__overflow__"
+
 struct prom_metric;
 /**
  * @brief A prometheus metric.
@@ -49,7 +75,8 @@ typedef struct prom_metric prom_metric_t;
  * You may use this function to cache metric samples to avoid sample lookup.
  * Metric samples are stored in a hash map with O(1) lookups in average case.
  * Nonethless, caching metric samples and updating them directly might be
- * preferrable in performance-sensitive situations.
+ * preferrable in performance-sensitive situations. See also
+ * \c prom_counter_bind() and \c prom_gauge_bind().
  *
  * @param self Metric to use for lookup.
  * @param label_values	label values associated with the metric sample being
@@ -68,7 +95,8 @@ pms_t *pms_from_labels(prom_metric_t *self, const char **label_values);
  * You may use this function to cache metric samples to avoid sample lookup.
  * Metric samples are stored in a hash map with O(1) lookups in average case.
  * Nonethless, caching metric samples and updating them directly might be
- * preferrable in performance-sensitive situations.
+ * preferrable in performance-sensitive situations. See also
+ * \c prom_histogram_bind().
  *
  * @param self	Metric to use for lookup.
  * @param label_values	label values associated with the metric sample being
@@ -80,4 +108,79 @@ pms_t *pms_from_labels(prom_metric_t *self, const char **label_values);
  */
 pms_histogram_t *pms_histogram_from_labels(prom_metric_t *self, const char **label_values);
 
+/**
+ * @brief Stripe all current and future samples of the given counter or gauge.
+ *
+ * Additions to a sample are usually a compare-and-swap loop on a single
+ * value. If many threads update the same sample, the cache line holding it
+ * bounces between the CPUs. A striped sample spreads additions over
+ * \c count cache line sized cells instead - on Linux one cell per CPU, per
+ * thread elsewhere - and sums them up when the value gets read, e.g. on scrape.
+ * So updates get cheaper, reading gets more expensive and each sample needs
+ * \c count * 64 bytes more memory. Therefore use it for hot samples only.
+ *
+ * @param self	Counter or gauge to stripe.
+ * @param count	The number of cells per sample. \c 0 means the number of
+ *	online CPUs. Values < 2 leave the samples as they are.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ * @note Once striped, a sample stays striped.
+ */
+int prom_metric_set_stripes(prom_metric_t *self, unsigned int count);
+
+/**
+ * @brief Reserve all memory the given metric needs for the given number of
+ *	series up front, so that updating it never calls the allocator anymore.
+ *
+ * This covers the series themselves and the structures to look them up. Their
+ * label values get copied to a block of \c label_bytes bytes. Once
+ * \c series series exist or the block is exhausted, updates of new series
+ * fail with a non-zero return value and get counted (see
+ * prom_metric_dropped()). Updates of existing series are not affected.
+ * Exporting the metric, e.g. on scrape, still allocates memory.
+ *
+ * @param self			Labeled metric to reserve memory for. Must not have any
+ *	series yet and must not be striped.
+ * @param series		The max. number of series.
+ * @param label_bytes	The number of bytes to reserve for label values. A
+ *	series needs the length of its label values plus a pointer per label.
+ * @return A non-zero integer value upon failure, \c 0 otherwise. It fails
+ *	as well, if \c series leaves no room for the overflow series (see
+ *	prom_metric_set_max_series()).
+ * @note Unlabeled metrics have a single series, which got allocated with the
+ *	metric. So for them this is a no-op.
+ * @see pcr_set_capacity()
+ */
+int prom_metric_set_capacity(prom_metric_t *self, size_t series, size_t label_bytes);
+
+/**
+ * @brief Limit the number of series of the given metric, e.g. to survive a
+ *	bug, which puts request IDs into a label.
+ *
+ * Once \c series series exist, new label sets get folded into a single
+ * overflow series instead, whose labels are all set to
+ * \c PROM_OVERFLOW_LABEL_VALUE . So updates still succeed, but memory stays
+ * bounded no matter which label values get passed. Each folded update gets
+ * counted (see prom_metric_dropped()).
+ *
+ * @param self		Metric to limit. Existing series are kept, even if there
+ *	are more of them than the limit.
+ * @param series	The max. number of series besides the overflow series.
+ *	\c 0 means unlimited.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ * @note If a capacity is set as well (see prom_metric_set_capacity()), the
+ *	overflow series needs room within it. So the limit must be below the
+ *	capacity, and new series get dropped, if existing ones exhausted the
+ *	capacity already.
+ * @see pcr_set_max_series()
+ */
+int prom_metric_set_max_series(prom_metric_t *self, size_t series);
+
+/**
+ * @brief Get the number of times, a new series of the given metric got
+ *	rejected, because its capacity was exhausted, or got folded into its
+ *	overflow series, because its series limit was reached.
+ * @see prom_metric_set_capacity(), prom_metric_set_max_series()
+ */
+uint64_t prom_metric_dropped(prom_metric_t *self);
+
 #endif  // PROM_METRIC_H
@@ -56,4 +56,11 @@ int pms_sub(pms_t *self, double r_value);
  */
 int pms_set(pms_t *self, double r_value);
 
+/**
+ * @brief Get the current value of the given sample.
+ * @param self	Sample to query.
+ * @return The value of the sample. If it is striped, the sum of all its cells.
+ */
+double pms_get(pms_t *self);
+
 #endif  // PROM_METRIC_SAMPLE_H
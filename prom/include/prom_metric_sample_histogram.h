@@ -31,8 +31,10 @@ typedef struct pms_histogram pms_histogram_t;
 
 /**
  * @brief Find the bucket for the given value in the given prom sample
- *	metric histogram and increment the sample assigned to it by 1. Furthermore
- *	update its sum and count sample, if found and appropriate.
+ *	metric histogram and increment its counter by 1. Furthermore update its
+ *	sum and count. Does not block: a scrape reads a snapshot of counts, which
+ *	are not touched by observations anymore (hot/cold swap). \c NaN values
+ *	are counted in the +Inf bucket only.
  * @param self		Where to lockup the bucket and sample.
  * @param value		The value to find.
  * @return Non-zero integer value upon failure, \c 0 otherwise.
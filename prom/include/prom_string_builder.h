@@ -65,6 +65,16 @@ int psb_add_str(psb_t *self, const char *str);
  */
 int psb_add_char(psb_t *self, char c);
 
+/**
+ * @brief Append the given bytes to the buffer of the given string builder.
+ *	Unlike \c psb_add_str() the bytes may contain \c '\0' .
+ * @param self	Where to append the bytes.
+ * @param buf	Bytes to append.
+ * @param len	Number of bytes to append.
+ * @return \c 0 on success, a number > 0 otherwise.
+ */
+int psb_add_bytes(psb_t *self, const void *buf, size_t len);
+
 /**
  * @brief Free the allocated string buffer area of the given string builder,
  * allocate a new one with a default initial size and set its length to \c 0.
@@ -73,6 +83,24 @@ int psb_add_char(psb_t *self, char c);
  */
 int psb_clear(psb_t *self);
 
+/**
+ * @brief Set the length of the buffered string of the given string builder
+ *	to \c 0, but keep the allocated buffer, so that it can be refilled without
+ *	growing it again.
+ * @param self	String builder to reset.
+ * @return \c 0 .
+ */
+int psb_reset(psb_t *self);
+
+/**
+ * @brief Make sure, that the buffer of the given string builder can hold a
+ *	string of the given length without growing it.
+ * @param self	String builder to prepare.
+ * @param size	The expected length of the buffered string.
+ * @return \c 0 on success, a number > 0 otherwise.
+ */
+int psb_reserve(psb_t *self, size_t size);
+
 /**
  * @brief Set the length of the buffered string of the given string builder
  *	to the given length and append \c '\0'.
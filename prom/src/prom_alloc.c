@@ -0,0 +1,111 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+static void *
+libc_malloc(size_t size, void *ctx) {
+	return malloc(size);
+}
+
+static void *
+libc_realloc(void *ptr, size_t size, void *ctx) {
+	return realloc(ptr, size);
+}
+
+static void
+libc_free(void *ptr, void *ctx) {
+	free(ptr);
+}
+
+static struct {
+	prom_malloc_fn malloc;
+	prom_realloc_fn realloc;
+	prom_free_fn free;
+	void *ctx;
+} allocator = { libc_malloc, libc_realloc, libc_free, NULL };
+
+// Set on the first allocation, so that the allocator can't be changed anymore.
+static atomic_bool allocated = ATOMIC_VAR_INIT(false);
+
+static inline void
+mark_allocated(void) {
+	if (!atomic_load_explicit(&allocated, memory_order_relaxed))
+		atomic_store_explicit(&allocated, true, memory_order_relaxed);
+}
+
+int
+prom_set_allocator(prom_malloc_fn malloc_fn, prom_realloc_fn realloc_fn,
+	prom_free_fn free_fn, void *ctx)
+{
+	if (malloc_fn == NULL || realloc_fn == NULL || free_fn == NULL)
+		return 1;
+	if (atomic_load(&allocated))
+		return 2;
+	allocator.malloc = malloc_fn;
+	allocator.realloc = realloc_fn;
+	allocator.free = free_fn;
+	allocator.ctx = ctx;
+	return 0;
+}
+
+void *
+prom_alloc_malloc(size_t size) {
+	mark_allocated();
+	return allocator.malloc(size, allocator.ctx);
+}
+
+void *
+prom_alloc_calloc(size_t count, size_t size) {
+	// libc's calloc gets fresh pages zeroed for free, so large tables don't
+	// need to be touched.
+	if (allocator.malloc == libc_malloc) {
+		mark_allocated();
+		return calloc(count, size);
+	}
+	if (size != 0 && count > SIZE_MAX / size)
+		return NULL;
+	void *p = prom_alloc_malloc(count * size);
+	if (p != NULL)
+		memset(p, 0, count * size);
+	return p;
+}
+
+void *
+prom_alloc_realloc(void *ptr, size_t size) {
+	mark_allocated();
+	return allocator.realloc(ptr, size, allocator.ctx);
+}
+
+char *
+prom_alloc_strdup(const char *s) {
+	size_t len = strlen(s) + 1;
+	char *p = (char *) prom_alloc_malloc(len);
+	if (p != NULL)
+		memcpy(p, s, len);
+	return p;
+}
+
+void
+prom_alloc_free(void *ptr) {
+	if (ptr != NULL)
+		allocator.free(ptr, allocator.ctx);
+}
@@ -0,0 +1,57 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_arena_i.h"
+#include "prom_arena_t.h"
+
+int
+prom_arena_init(prom_arena_t *self, size_t size) {
+	if (self == NULL || size == 0)
+		return 1;
+	memset(self, 0, sizeof(prom_arena_t));
+	if ((self->mem = (char *) prom_malloc(size)) == NULL)
+		return 2;
+	self->size = size;
+	return 0;
+}
+
+void
+prom_arena_destroy(prom_arena_t *self) {
+	if (self == NULL)
+		return;
+	prom_free(self->mem);
+	memset(self, 0, sizeof(prom_arena_t));
+}
+
+void *
+prom_arena_alloc(prom_arena_t *self, size_t size) {
+	size_t start = (self->used + _Alignof(void *) - 1)
+		& ~(_Alignof(void *) - 1);
+	if (start > self->size || size > self->size - start)
+		return NULL;
+	self->used = start + size;
+	return self->mem + start;
+}
+
+bool
+prom_arena_active(prom_arena_t *self) {
+	return self != NULL && self->mem != NULL;
+}
@@ -0,0 +1,52 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_ARENA_I_H
+#define PROM_ARENA_I_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief PRIVATE A bump allocator (see prom_arena_t.h).
+ */
+typedef struct prom_arena prom_arena_t;
+
+/**
+ * @brief PRIVATE Allocate the block of the given arena.
+ * @param self	The arena to initialize.
+ * @param size	The number of bytes the arena can hand out.
+ * @return \c 0 on success, a non-zero value otherwise.
+ */
+int prom_arena_init(prom_arena_t *self, size_t size);
+
+/**
+ * @brief PRIVATE Release the block of the given arena. All memory obtained
+ *	from it becomes invalid. A zeroed arena gets ignored.
+ */
+void prom_arena_destroy(prom_arena_t *self);
+
+/**
+ * @brief PRIVATE Get the given number of bytes from the given arena, aligned
+ *	for storing pointers.
+ * @return \c NULL if the arena is exhausted.
+ */
+void *prom_arena_alloc(prom_arena_t *self, size_t size);
+
+/**
+ * @brief PRIVATE Check, whether the given arena got initialized.
+ */
+bool prom_arena_active(prom_arena_t *self);
+
+#endif  // PROM_ARENA_I_H
@@ -0,0 +1,34 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_ARENA_T_H
+#define PROM_ARENA_T_H
+
+#include <stddef.h>
+
+// Private
+#include "prom_arena_i.h"
+
+/**
+ * @brief PRIVATE A fixed block of memory, which gets handed out piecewise
+ * from the start to the end. Pieces can't be released on their own, only
+ * all of them together by destroying the arena. Not thread-safe.
+ */
+struct prom_arena {
+	char *mem;		/**< the block, \c NULL if not initialized */
+	size_t size;	/**< size of the block */
+	size_t used;	/**< bytes handed out so far */
+};
+
+#endif  // PROM_ARENA_T_H
@@ -16,6 +16,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/sysinfo.h>
 
@@ -24,7 +25,9 @@
 #include "prom_collector.h"
 
 // Private
+#include "prom_collector_i.h"
 #include "prom_collector_t.h"
+#include "prom_epoch_i.h"
 #include "prom_log.h"
 #include "prom_metric_i.h"
 #include "prom_string_builder.h"
@@ -46,6 +49,13 @@ prom_collector_new(const char *name) {
 	self->free_data_fn = NULL;
 	self->collect_fn = &prom_collector_metrics_get;
 	self->string_builder = NULL;
+	self->timeout = 0;
+	atomic_init(&self->abandoned, 0);
+	for (int i = 0; i < PROM_FORMAT_COUNT; i++)
+		atomic_init(&self->snapshot[i], NULL);
+	self->interval = 0;
+	atomic_init(&self->refreshed, 0);
+	self->next = 0;
 
 	self->metrics = prom_map_new();
 	if (self->metrics == NULL)
@@ -78,6 +88,8 @@ prom_collector_destroy(prom_collector_t *self) {
 	self->metrics = NULL;
 	r += psb_destroy(self->string_builder);
 	self->string_builder = NULL;
+	for (int i = 0; i < PROM_FORMAT_COUNT; i++)
+		prom_free(atomic_load(&self->snapshot[i]));
 	prom_free((char *)self->name);
 	self->name = NULL;
 	prom_free(self);
@@ -108,6 +120,22 @@ prom_collector_set_collect_fn(prom_collector_t *self, prom_collect_fn *fn) {
 	return 0;
 }
 
+int
+prom_collector_set_timeout(prom_collector_t *self, unsigned int timeout) {
+	if (self == NULL)
+		return 1;
+	self->timeout = timeout;
+	return 0;
+}
+
+int
+prom_collector_set_interval(prom_collector_t *self, unsigned int interval) {
+	if (self == NULL)
+		return 1;
+	self->interval = interval;
+	return 0;
+}
+
 int
 prom_collector_add_metric(prom_collector_t *self, prom_metric_t *metric) {
 	if (self == NULL)
@@ -137,3 +165,39 @@ prom_collector_data_get(prom_collector_t *self) {
 		return NULL;
 	return self->data;
 }
+
+static void
+prom_collector_snapshot_free(void *ptr) {
+	prom_free(ptr);
+}
+
+void
+prom_collector_snapshot_set(prom_collector_t *self, prom_format_t format,
+	const char *buf, size_t len)
+{
+	prom_collector_snapshot_t *snapshot = (prom_collector_snapshot_t *)
+		prom_malloc(sizeof(prom_collector_snapshot_t) + len);
+	if (snapshot == NULL)
+		return;
+	snapshot->len = len;
+	memcpy(snapshot->data, buf, len);
+	// Concurrent exports may still copy the old one.
+	prom_collector_snapshot_t *old =
+		atomic_exchange(&self->snapshot[format], snapshot);
+	if (old != NULL && prom_epoch_retire(old, prom_collector_snapshot_free))
+		PROM_WARN("Unable to retire the snapshot of '%s' - leaking it.",
+			self->name);
+}
+
+int
+prom_collector_snapshot_load(prom_collector_t *self, prom_format_t format,
+	psb_t *sb)
+{
+	prom_epoch_enter();
+	prom_collector_snapshot_t *snapshot = atomic_load(&self->snapshot[format]);
+	int err = (snapshot == NULL)
+		? 0
+		: psb_add_bytes(sb, snapshot->data, snapshot->len);
+	prom_epoch_exit();
+	return err;
+}
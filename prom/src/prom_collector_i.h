@@ -0,0 +1,40 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_COLLECTOR_I_H
+#define PROM_COLLECTOR_I_H
+
+#include <stddef.h>
+
+// Public
+#include "prom_collector.h"
+#include "prom_metric.h"
+#include "prom_string_builder.h"
+
+/**
+ * @brief PRIVATE Replace the snapshot of the given collector in the given
+ *	format by a copy of the given export of its metrics.
+ */
+void prom_collector_snapshot_set(prom_collector_t *self, prom_format_t format,
+	const char *buf, size_t len);
+
+/**
+ * @brief PRIVATE Append the snapshot of the given collector in the given
+ *	format, if any, to the given string builder.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int prom_collector_snapshot_load(prom_collector_t *self, prom_format_t format,
+	psb_t *sb);
+
+#endif  // PROM_COLLECTOR_I_H
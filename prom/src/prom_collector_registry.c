@@ -17,19 +17,24 @@
 
 #include <pthread.h>
 #include <regex.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 // Public
 #include "prom_alloc.h"
 #include "prom_collector.h"
 #include "prom_collector_registry.h"
+#include "prom_counter.h"
 #include "prom_gauge.h"
 
 // Private
 #include "prom_assert.h"
+#include "prom_collector_i.h"
 #include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
+#include "prom_epoch_i.h"
 #include "prom_errors.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
@@ -38,9 +43,23 @@
 #include "prom_metric_t.h"
 #include "prom_process_limits_i.h"
 #include "prom_string_builder.h"
+#include "prom_worker_pool_t.h"
 
 pcr_t *PROM_COLLECTOR_REGISTRY;
 
+static int pcr_scheduler_start(pcr_t *self);
+static int pcr_scheduler_stop(pcr_t *self);
+
+/**
+ * @brief PRIVATE The current time in ms (CLOCK_MONOTONIC).
+ */
+static uint64_t
+pcr_now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
 pcr_t *
 pcr_new(const char *name) {
 	pcr_t *self = (pcr_t *) prom_malloc(sizeof(pcr_t));
@@ -50,6 +69,17 @@ pcr_new(const char *name) {
 	self->features = 0;
 	self->scrape_duration = NULL;
 	self->mprefix = NULL;
+	self->formatter_count = 0;
+	for (int i = 0; i < PROM_FORMAT_COUNT; i++)
+		atomic_init(&self->bridge_size[i], 0);
+	self->workers = NULL;
+	atomic_init(&self->timeouts, NULL);
+	self->scheduler = NULL;
+	atomic_init(&self->snapshot_age, NULL);
+	self->capacity = 0;
+	self->label_bytes = 0;
+	self->max_series = 0;
+	atomic_init(&self->rejected, NULL);
 
 	self->name = prom_strdup(name);
 	self->collectors = prom_map_new();
@@ -60,12 +90,10 @@ pcr_new(const char *name) {
 			prom_collector_new(COLLECTOR_NAME_DEFAULT));
 	}
 
-	self->metric_formatter = pmf_new();
 	self->string_builder = psb_new();
 	self->lock = (pthread_rwlock_t *) prom_malloc(sizeof(pthread_rwlock_t));
 	if (pthread_rwlock_init(self->lock, NULL) != 0 || self->name == NULL
-		|| self->collectors == NULL || self->metric_formatter == 0
-		|| self->string_builder == NULL)
+		|| self->collectors == NULL || self->string_builder == NULL)
 	{
 		PROM_WARN("failed to initialize rwlock for pcr '%s'", name);
 		pcr_destroy(self);
@@ -110,6 +138,90 @@ pcr_enable_scrape_metrics(pcr_t *self) {
 	return 0;
 }
 
+int
+pcr_set_capacity(pcr_t *self, size_t series, size_t label_bytes,
+	unsigned int threads)
+{
+	if (self == NULL || series == 0 || label_bytes == 0)
+		return 1;
+	if (prom_epoch_reserve(threads))
+		return 2;
+	if (pthread_rwlock_wrlock(self->lock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return 3;
+	}
+	int err = 0;
+	self->capacity = series;
+	self->label_bytes = label_bytes;
+	prom_map_iter_t citer, miter;
+	prom_map_iter_init(&citer, self->collectors);
+	while (prom_map_iter_next(&citer)) {
+		prom_map_iter_init(&miter, ((prom_collector_t *) citer.value)->metrics);
+		while (prom_map_iter_next(&miter)) {
+			if (prom_metric_set_capacity(miter.value, series, label_bytes))
+				err = 4;
+		}
+	}
+	if (pthread_rwlock_unlock(self->lock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return err;
+}
+
+int
+pcr_set_max_series(pcr_t *self, size_t series) {
+	if (self == NULL)
+		return 1;
+	if (pthread_rwlock_wrlock(self->lock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return 2;
+	}
+	int err = 0;
+	self->max_series = series;
+	prom_map_iter_t citer, miter;
+	prom_map_iter_init(&citer, self->collectors);
+	while (prom_map_iter_next(&citer)) {
+		prom_map_iter_init(&miter, ((prom_collector_t *) citer.value)->metrics);
+		while (prom_map_iter_next(&miter)) {
+			// Not libprom's own ones: they need a series per collector or
+			// metric.
+			if (miter.value == atomic_load(&self->timeouts)
+				|| miter.value == atomic_load(&self->snapshot_age)
+				|| miter.value == atomic_load(&self->rejected))
+			{
+				continue;
+			}
+			if (prom_metric_set_max_series(miter.value, series))
+				err = 3;
+		}
+	}
+	if (pthread_rwlock_unlock(self->lock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return err;
+}
+
+int
+pcr_set_workers(pcr_t *self, unsigned int count) {
+	pwp_t *workers = NULL;
+
+	if (self == NULL)
+		return 1;
+	if (count > 0 && (workers = pwp_new(count)) == NULL) {
+		PROM_WARN("Failed to start %u workers for registry '%s'.", count,
+			self->name);
+		return 1;
+	}
+	if (pthread_rwlock_wrlock(self->lock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		pwp_destroy(workers);
+		return 1;
+	}
+	pwp_t *old = self->workers;
+	self->workers = workers;
+	if (pthread_rwlock_unlock(self->lock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return pwp_destroy(old);
+}
+
 int
 pcr_enable_custom_process_metrics(pcr_t *self, const char *limits_path,
 	const char *stats_path)
@@ -190,9 +302,14 @@ pcr_destroy(pcr_t *self) {
 
 	if (PROM_COLLECTOR_REGISTRY == self)
 		PROM_COLLECTOR_REGISTRY = NULL;
-	int err = prom_map_destroy(self->collectors);
+	int err = pcr_scheduler_stop(self);
+	err += pwp_destroy(self->workers);
+	self->workers = NULL;
+	err += prom_map_destroy(self->collectors);
 	err += prom_gauge_destroy(self->scrape_duration);
-	err += pmf_destroy(self->metric_formatter);
+	for (unsigned int i = 0; i < self->formatter_count; i++)
+		err += pmf_destroy(self->formatter_pool[i]);
+	self->formatter_count = 0;
 	err += psb_destroy(self->string_builder);
 	err += pthread_rwlock_destroy(self->lock);
 	prom_free(self->lock);
@@ -213,6 +330,17 @@ pcr_register_metric(prom_metric_t *metric) {
 
 	if (default_collector == NULL)
 		return 1;
+	if (PROM_COLLECTOR_REGISTRY->capacity > 0 && prom_metric_set_capacity(
+		metric, PROM_COLLECTOR_REGISTRY->capacity,
+		PROM_COLLECTOR_REGISTRY->label_bytes))
+	{
+		return 2;
+	}
+	if (PROM_COLLECTOR_REGISTRY->max_series > 0 && prom_metric_set_max_series(
+		metric, PROM_COLLECTOR_REGISTRY->max_series))
+	{
+		return 3;
+	}
 
 	return prom_collector_add_metric(default_collector, metric);
 }
@@ -241,6 +369,8 @@ pcr_register_collector(pcr_t *self, prom_collector_t *collector) {
 	}
 	if (prom_map_set(self->collectors, collector->name, collector))
 		goto end;
+	if (collector->interval > 0 && pcr_scheduler_start(self))
+		PROM_WARN("Unable to refresh '%s' periodically.", collector->name);
 
 	ret = 0;
 
@@ -277,10 +407,588 @@ pcr_check_name(const char *name, bool is_label) {
 	return ret;
 }
 
+/**
+ * @brief PRIVATE Get an idle formatter of the given registry or a new one.
+ * @param size	Expected size of the export, so that its buffer does not need
+ *	to grow while rendering.
+ * @param format	What to render.
+ * @return \c NULL on error.
+ */
+static pmf_t *
+pcr_formatter_get(pcr_t *self, size_t size, prom_format_t format) {
+	pmf_t *pmf = NULL;
+
+	if (pthread_rwlock_wrlock(self->lock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+	} else {
+		if (self->formatter_count > 0)
+			pmf = self->formatter_pool[--self->formatter_count];
+		if (pthread_rwlock_unlock(self->lock))
+			PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	}
+	if (pmf == NULL && (pmf = pmf_new()) == NULL)
+		return NULL;
+	pmf_clear(pmf);
+	pmf->format = format;
+	if (size > 0)
+		psb_reserve(pmf->string_builder, size);
+	return pmf;
+}
+
+/**
+ * @brief PRIVATE Hand back the given formatter to the given registry.
+ */
+static void
+pcr_formatter_put(pcr_t *self, pmf_t *pmf) {
+	if (pmf == NULL)
+		return;
+	if (pthread_rwlock_wrlock(self->lock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		pmf_destroy(pmf);
+		return;
+	}
+	if (self->formatter_count < PCR_FORMATTER_POOL_SIZE) {
+		self->formatter_pool[self->formatter_count++] = pmf;
+		pmf = NULL;
+	}
+	if (pthread_rwlock_unlock(self->lock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	pmf_destroy(pmf);
+}
+
+/**
+ * @brief PRIVATE Take new snapshots of the given collector, one per format.
+ */
+static void
+pcr_refresh(pcr_t *self, const char *name, prom_collector_t *c) {
+	pmf_t *pmf = pcr_formatter_get(self, 0, PROM_FORMAT_TEXT);
+	if (pmf == NULL)
+		return;
+	bool compact = (self->features & PROM_COMPACT) ? true : false;
+	// Collect once, render all formats from the same state.
+	prom_map_t *metrics = c->collect_fn(c);
+	prom_map_iter_t iter;
+	for (int format = 0; format < PROM_FORMAT_COUNT; format++) {
+		int err = 0;
+		pmf_clear(pmf);
+		pmf->format = format;
+		prom_map_iter_init(&iter, metrics);
+		while (prom_map_iter_next(&iter)) {
+			if (iter.value != NULL
+				&& pmf_load_metric(pmf, iter.value, self->mprefix, compact))
+			{
+				err++;
+			}
+		}
+		if (err == 0)
+			prom_collector_snapshot_set(c, format,
+				psb_str(pmf->string_builder), psb_len(pmf->string_builder));
+	}
+	atomic_store(&c->refreshed, pcr_now_ms());
+	pcr_formatter_put(self, pmf);
+}
+
+/**
+ * @brief PRIVATE Main loop of the scheduler thread: refresh every periodic
+ *	collector when due.
+ */
+static void *
+pcr_scheduler_run(void *arg) {
+	pcr_t *self = (pcr_t *) arg;
+	pcr_scheduler_t *sched = self->scheduler;
+	prom_map_iter_t iter;
+
+	pthread_mutex_lock(&sched->lock);
+	while (!sched->stop) {
+		pthread_mutex_unlock(&sched->lock);
+		// Check for new collectors at least once a minute.
+		uint64_t next = pcr_now_ms() + 60000;
+		prom_map_iter_init(&iter, self->collectors);
+		while (prom_map_iter_next(&iter)) {
+			prom_collector_t *c = (prom_collector_t *) iter.value;
+			if (c == NULL || c->interval == 0)
+				continue;
+			if (c->next <= pcr_now_ms()) {
+				pcr_refresh(self, iter.key, c);
+				c->next = pcr_now_ms() + c->interval;
+			}
+			if (c->next < next)
+				next = c->next;
+		}
+		pthread_mutex_lock(&sched->lock);
+		if (sched->stop || next <= pcr_now_ms())
+			continue;
+		struct timespec ts = {
+			.tv_sec = next / 1000,
+			.tv_nsec = (next % 1000) * 1000000
+		};
+		pthread_cond_timedwait(&sched->wakeup, &sched->lock, &ts);
+	}
+	pthread_mutex_unlock(&sched->lock);
+	return NULL;
+}
+
+/**
+ * @brief PRIVATE Start the scheduler of the given registry, or wake it up if
+ *	already running. The caller must hold the registry's write lock.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+static int
+pcr_scheduler_start(pcr_t *self) {
+	pthread_condattr_t attr;
+	pcr_scheduler_t *sched = self->scheduler;
+
+	if (sched != NULL) {
+		pthread_mutex_lock(&sched->lock);
+		pthread_cond_signal(&sched->wakeup);
+		pthread_mutex_unlock(&sched->lock);
+		return 0;
+	}
+
+	if (atomic_load(&self->snapshot_age) == NULL) {
+		prom_metric_t *g = prom_gauge_new(METRIC_NAME_SNAPSHOT_AGE,
+			"Age of the snapshot of a periodically refreshed collector",
+			1, (const char *[]) { "collector" });
+		if (g != NULL && prom_collector_add_metric(
+			prom_map_get(self->collectors, COLLECTOR_NAME_DEFAULT), g))
+		{
+			prom_gauge_destroy(g);
+			g = NULL;
+		}
+		atomic_store(&self->snapshot_age, g);
+	}
+
+	sched = (pcr_scheduler_t *) prom_malloc(sizeof(pcr_scheduler_t));
+	if (sched == NULL)
+		return 1;
+	sched->stop = false;
+	if (pthread_mutex_init(&sched->lock, NULL))
+		goto fail;
+	// Due dates are CLOCK_MONOTONIC based.
+	if (pthread_condattr_init(&attr))
+		goto fail_mutex;
+	int err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)
+		|| pthread_cond_init(&sched->wakeup, &attr);
+	pthread_condattr_destroy(&attr);
+	if (err)
+		goto fail_mutex;
+	self->scheduler = sched;
+	if (pthread_create(&sched->thread, NULL, &pcr_scheduler_run, self) == 0)
+		return 0;
+
+	self->scheduler = NULL;
+	pthread_cond_destroy(&sched->wakeup);
+fail_mutex:
+	pthread_mutex_destroy(&sched->lock);
+fail:
+	prom_free(sched);
+	return 1;
+}
+
+/**
+ * @brief PRIVATE Stop the scheduler of the given registry, if running.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+static int
+pcr_scheduler_stop(pcr_t *self) {
+	pcr_scheduler_t *sched = self->scheduler;
+	int err = 0;
+
+	if (sched == NULL)
+		return 0;
+	pthread_mutex_lock(&sched->lock);
+	sched->stop = true;
+	pthread_cond_signal(&sched->wakeup);
+	pthread_mutex_unlock(&sched->lock);
+	err += pthread_join(sched->thread, NULL) ? 1 : 0;
+	self->scheduler = NULL;
+	err += pthread_cond_destroy(&sched->wakeup) ? 1 : 0;
+	err += pthread_mutex_destroy(&sched->lock) ? 1 : 0;
+	prom_free(sched);
+	return err;
+}
+
+/**
+ * @brief PRIVATE Update the snapshot ages of all periodic collectors of the
+ *	given registry.
+ */
+static void
+pcr_snapshot_ages(pcr_t *self) {
+	prom_metric_t *gauge = atomic_load(&self->snapshot_age);
+	prom_map_iter_t iter;
+
+	if (gauge == NULL)
+		return;
+	uint64_t now = pcr_now_ms();
+	prom_map_iter_init(&iter, self->collectors);
+	while (prom_map_iter_next(&iter)) {
+		prom_collector_t *c = (prom_collector_t *) iter.value;
+		if (c == NULL || c->interval == 0)
+			continue;
+		uint64_t refreshed = atomic_load(&c->refreshed);
+		if (refreshed == 0)
+			continue;
+		const char *labels[] = { iter.key };
+		prom_gauge_set(gauge, (now - refreshed) * 1e-3, labels);
+	}
+}
+
+/**
+ * @brief PRIVATE Count a missed deadline of the given collector. Creates the
+ *	timeouts counter of the given registry on the first miss.
+ */
+static void
+pcr_count_timeout(pcr_t *self, const char *name) {
+	const char *labels[] = { name };
+	prom_metric_t *counter = atomic_load(&self->timeouts);
+
+	if (counter == NULL) {
+		if (pthread_rwlock_wrlock(self->lock)) {
+			PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+			return;
+		}
+		counter = atomic_load(&self->timeouts);
+		if (counter == NULL) {
+			counter = prom_counter_new(METRIC_NAME_TIMEOUTS,
+				"Number of exports, a collector missed its deadline",
+				1, (const char *[]) { "collector" });
+			if (counter != NULL && prom_collector_add_metric(
+				prom_map_get(self->collectors, COLLECTOR_NAME_DEFAULT), counter))
+			{
+				prom_counter_destroy(counter);
+				counter = NULL;
+			}
+			atomic_store(&self->timeouts, counter);
+		}
+		if (pthread_rwlock_unlock(self->lock))
+			PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+		if (counter == NULL)
+			return;
+	}
+	prom_counter_inc(counter, labels);
+}
+
+/**
+ * @brief PRIVATE Get the counter of rejected series of the given registry.
+ *	Creates it on first use.
+ * @return \c NULL on error.
+ */
+static prom_metric_t *
+pcr_rejected_counter(pcr_t *self) {
+	prom_metric_t *counter = atomic_load(&self->rejected);
+	if (counter != NULL)
+		return counter;
+	if (pthread_rwlock_wrlock(self->lock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return NULL;
+	}
+	counter = atomic_load(&self->rejected);
+	if (counter == NULL) {
+		counter = prom_counter_new(METRIC_NAME_REJECTED,
+			"Number of new series, a metric dropped or folded into its "
+			"overflow series", 1, (const char *[]) { "metric" });
+		if (counter != NULL && prom_collector_add_metric(
+			prom_map_get(self->collectors, COLLECTOR_NAME_DEFAULT), counter))
+		{
+			prom_counter_destroy(counter);
+			counter = NULL;
+		}
+		atomic_store(&self->rejected, counter);
+	}
+	if (pthread_rwlock_unlock(self->lock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return counter;
+}
+
+/**
+ * @brief PRIVATE Update the counter of rejected series of the given registry
+ *	from the metrics of all its collectors.
+ */
+static void
+pcr_count_rejections(pcr_t *self) {
+	prom_map_iter_t citer, miter;
+
+	prom_map_iter_init(&citer, self->collectors);
+	while (prom_map_iter_next(&citer)) {
+		prom_collector_t *c = (prom_collector_t *) citer.value;
+		if (c == NULL)
+			continue;
+		prom_map_iter_init(&miter, c->metrics);
+		while (prom_map_iter_next(&miter)) {
+			prom_metric_t *m = (prom_metric_t *) miter.value;
+			uint64_t count = prom_metric_dropped(m);
+			if (count == 0)
+				continue;
+			prom_metric_t *counter = pcr_rejected_counter(self);
+			if (counter == NULL)
+				return;
+			const char *labels[] = { m->name };
+			prom_counter_reset(counter, count, labels);
+		}
+	}
+}
+
+static void
+pcr_scrape_free(pcr_scrape_t *scrape) {
+	pthread_cond_destroy(&scrape->done);
+	pthread_mutex_destroy(&scrape->lock);
+	prom_free(scrape);
+}
+
+/**
+ * @brief PRIVATE Create the job list for an export of the given number of
+ *	collectors.
+ * @return \c NULL on error.
+ */
+static pcr_scrape_t *
+pcr_scrape_new(pcr_t *self, size_t count) {
+	pthread_condattr_t attr;
+	pcr_scrape_t *scrape = (pcr_scrape_t *)
+		prom_calloc(1, sizeof(pcr_scrape_t) + count * sizeof(pcr_job_t));
+	if (scrape == NULL)
+		return NULL;
+	if (pthread_mutex_init(&scrape->lock, NULL))
+		goto fail;
+	// Deadlines are CLOCK_MONOTONIC based.
+	if (pthread_condattr_init(&attr) == 0) {
+		if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0
+			&& pthread_cond_init(&scrape->done, &attr) == 0)
+		{
+			pthread_condattr_destroy(&attr);
+			scrape->registry = self;
+			scrape->refs = 1;
+			return scrape;
+		}
+		pthread_condattr_destroy(&attr);
+	}
+	pthread_mutex_destroy(&scrape->lock);
+
+fail:
+	prom_free(scrape);
+	return NULL;
+}
+
+/**
+ * @brief PRIVATE Job function, which renders a single collector.
+ */
+static void
+pcr_job_run(void *arg) {
+	pcr_job_t *job = (pcr_job_t *) arg;
+	pcr_scrape_t *scrape = job->scrape;
+	pcr_t *registry = scrape->registry;
+	prom_collector_t *c = job->collector;
+	pmf_t *pmf = job->metric_formatter;
+
+	job->err = pmf_load_collector(pmf, job->name, job->collector,
+		job->scrape_metric, job->prefix, job->compact);
+	uint64_t end = pcr_now_ms();
+	// Even if late, it is the best one can offer next time.
+	if (job->deadline != 0 && job->err == 0)
+		prom_collector_snapshot_set(job->collector, pmf->format,
+			psb_str(pmf->string_builder), psb_len(pmf->string_builder));
+
+	pthread_mutex_lock(&scrape->lock);
+	job->end = end;
+	job->done = true;
+	scrape->remaining--;
+	bool abandoned = job->abandoned;
+	bool last = --scrape->refs == 0;
+	pthread_cond_broadcast(&scrape->done);
+	pthread_mutex_unlock(&scrape->lock);
+
+	// Nobody else touches the job anymore.
+	if (abandoned) {
+		pcr_formatter_put(registry, pmf);
+		atomic_fetch_sub(&c->abandoned, 1);
+	}
+	if (last)
+		pcr_scrape_free(scrape);
+}
+
+/**
+ * @brief PRIVATE Queue a job for the given collector, unless it still hangs
+ *	in a job of an earlier export, which missed its deadline.
+ */
+static void
+pcr_job_submit(pcr_t *self, pcr_scrape_t *scrape, pcr_job_t *job,
+	prom_format_t format)
+{
+	prom_collector_t *c = job->collector;
+
+	// Do not pile up jobs for a collector, which missed its deadline.
+	// Concurrent exports of a collector, which is just busy, are fine.
+	if (atomic_load(&c->abandoned) > 0)
+		return;
+	if ((job->metric_formatter = pcr_formatter_get(self, 0, format)) == NULL)
+		return;
+	pwp_job_init(&job->job, &pcr_job_run, job);
+	pthread_mutex_lock(&scrape->lock);
+	scrape->refs++;
+	scrape->remaining++;
+	pthread_mutex_unlock(&scrape->lock);
+	if (pwp_submit(self->workers, &job->job) == 0) {
+		job->submitted = true;
+		return;
+	}
+	pthread_mutex_lock(&scrape->lock);
+	scrape->refs--;
+	scrape->remaining--;
+	pthread_mutex_unlock(&scrape->lock);
+	pcr_formatter_put(self, job->metric_formatter);
+	job->metric_formatter = NULL;
+}
+
+/**
+ * @brief PRIVATE Wait until all submitted jobs of the given export are done,
+ *	or their deadlines have passed. Marks all others as abandoned.
+ */
+static void
+pcr_scrape_wait(pcr_scrape_t *scrape) {
+	pthread_mutex_lock(&scrape->lock);
+	while (scrape->remaining > 0) {
+		// Waiting for one collector anyway gives the others more time.
+		uint64_t until = 0;
+		bool forever = false;
+		for (size_t i = 0; i < scrape->count; i++) {
+			pcr_job_t *job = &scrape->jobs[i];
+			if (!job->submitted || job->done)
+				continue;
+			if (job->deadline == 0)
+				forever = true;
+			else if (job->deadline > until)
+				until = job->deadline;
+		}
+		if (forever) {
+			pthread_cond_wait(&scrape->done, &scrape->lock);
+			continue;
+		}
+		if (pcr_now_ms() >= until)
+			break;
+		struct timespec ts = {
+			.tv_sec = until / 1000,
+			.tv_nsec = (until % 1000) * 1000000
+		};
+		pthread_cond_timedwait(&scrape->done, &scrape->lock, &ts);
+	}
+	for (size_t i = 0; i < scrape->count; i++) {
+		pcr_job_t *job = &scrape->jobs[i];
+		if (job->submitted && !job->done) {
+			job->abandoned = true;
+			atomic_fetch_add(&job->collector->abandoned, 1);
+		}
+	}
+	pthread_mutex_unlock(&scrape->lock);
+}
+
+/**
+ * @brief PRIVATE Loads the given formatter with the metrics of all collectors
+ *	of the given registry. Uses the registry's workers if available, otherwise
+ *	the same as pmf_load_metrics().
+ * @param deadline	When the export should be complete in ms
+ *	(CLOCK_MONOTONIC), \c 0 for no deadline. Requires workers.
+ * @return The number of errors.
+ */
+static int
+pcr_load_metrics(pcr_t *self, pmf_t *pmf, prom_metric_t *scrape_metric,
+	bool compact, uint64_t deadline)
+{
+	pcr_scrape_t *scrape;
+	prom_map_iter_t iter;
+	size_t i, n;
+	int err = 0;
+
+	n = (self->workers == NULL) ? 0 : prom_map_size(self->collectors);
+	if (n == 0 || (scrape = pcr_scrape_new(self, n)) == NULL)
+		return pmf_load_metrics(pmf, self->collectors, scrape_metric,
+			self->mprefix, compact);
+
+	// Collectors registered meanwhile get exported next time.
+	uint64_t now = pcr_now_ms();
+	prom_map_iter_init(&iter, self->collectors);
+	for (i = 0; i < n && prom_map_iter_next(&iter); i++) {
+		pcr_job_t *job = &scrape->jobs[i];
+		prom_collector_t *c = (prom_collector_t *) iter.value;
+		scrape->count++;
+		if (c == NULL) {
+			PROM_WARN("Collector '%s' not found.", iter.key);
+			err++;
+			continue;
+		}
+		job->scrape = scrape;
+		job->name = iter.key;
+		job->collector = c;
+		job->scrape_metric = scrape_metric;
+		job->prefix = self->mprefix;
+		job->compact = compact;
+		if (c->interval > 0) {
+			job->periodic = true;
+			continue;
+		}
+		job->deadline = deadline;
+		if (c->timeout > 0 && (deadline == 0 || now + c->timeout < deadline))
+			job->deadline = now + c->timeout;
+		pcr_job_submit(self, scrape, job, pmf->format);
+	}
+	pcr_scrape_wait(scrape);
+
+	for (i = 0; i < scrape->count; i++) {
+		pcr_job_t *job = &scrape->jobs[i];
+		if (job->collector == NULL)
+			continue;
+		if (job->periodic) {
+			err += prom_collector_snapshot_load(job->collector, pmf->format,
+				pmf->string_builder);
+			continue;
+		}
+		if (!job->submitted || job->abandoned) {
+			err += prom_collector_snapshot_load(job->collector, pmf->format,
+				pmf->string_builder);
+			// A collector skipped, because it still hangs in an earlier
+			// export, got counted by that one already.
+			if (job->abandoned)
+				pcr_count_timeout(self, job->name);
+			continue;
+		}
+		err += job->err;
+		psb_t *sb = job->metric_formatter->string_builder;
+		if (psb_add_bytes(pmf->string_builder, psb_str(sb), psb_len(sb)))
+			err++;
+		pcr_formatter_put(self, job->metric_formatter);
+		if (job->deadline != 0 && job->end > job->deadline)
+			pcr_count_timeout(self, job->name);
+	}
+
+	pthread_mutex_lock(&scrape->lock);
+	bool last = --scrape->refs == 0;
+	pthread_mutex_unlock(&scrape->lock);
+	if (last)
+		pcr_scrape_free(scrape);
+	return err;
+}
+
 char *
 pcr_bridge(pcr_t *self) {
-	if (self == NULL)
-		return strdup("# pcr_bridge(NULL)");
+	return pcr_export(self, PROM_FORMAT_TEXT, 0, NULL);
+}
+
+char *
+pcr_bridge_timeout(pcr_t *self, unsigned int timeout) {
+	return pcr_export(self, PROM_FORMAT_TEXT, timeout, NULL);
+}
+
+char *
+pcr_export(pcr_t *self, prom_format_t format, unsigned int timeout,
+	size_t *len)
+{
+	if (self == NULL) {
+		if (len != NULL)
+			*len = 0;
+		return (format == PROM_FORMAT_TEXT)
+			? prom_strdup("# pcr_bridge(NULL)")
+			: NULL;
+	}
+	if (format < 0 || format >= PROM_FORMAT_COUNT)
+		return NULL;
 
 	struct timespec start, end;
 	static const char *labels[] = { METRIC_LABEL_SCRAPE };
@@ -291,10 +999,18 @@ pcr_bridge(pcr_t *self) {
 	if (scrape)
 		clock_gettime(CLOCK_MONOTONIC, &start);
 
-	pmf_clear(self->metric_formatter);
-	pmf_load_metrics(self->metric_formatter, self->collectors,
+	// The export usually grows slowly, if at all: reserve a bit more than
+	// last time to avoid reallocs.
+	pcr_snapshot_ages(self);
+	pcr_count_rejections(self);
+	size_t size = atomic_load_explicit(&self->bridge_size[format],
+		memory_order_relaxed);
+	pmf_t *pmf = pcr_formatter_get(self, size + (size >> 3), format);
+	if (pmf == NULL)
+		return NULL;
+	pcr_load_metrics(self, pmf,
 		 (self->features & PROM_SCRAPETIME_ALL) ? self->scrape_duration : NULL,
-		 self->mprefix, compact);
+		 compact, (timeout == 0) ? 0 : pcr_now_ms() + timeout);
 
 	if (scrape) {
 		int r = clock_gettime(CLOCK_MONOTONIC, &end);
@@ -302,8 +1018,128 @@ pcr_bridge(pcr_t *self) {
 		long ns = (r == 0) ? end.tv_nsec - start.tv_nsec : 0;
 		double duration = s + ns*1e-9;
 		prom_gauge_set(self->scrape_duration, duration, labels);
-		pmf_load_metric(self->metric_formatter, self->scrape_duration,
-			self->mprefix, compact);
+		pmf_load_metric(pmf, self->scrape_duration, self->mprefix, compact);
+	}
+	pmf_load_end(pmf);
+	atomic_store_explicit(&self->bridge_size[format],
+		psb_len(pmf->string_builder), memory_order_relaxed);
+	if (len != NULL)
+		*len = psb_len(pmf->string_builder);
+	char *result = pmf_dump(pmf);
+	pcr_formatter_put(self, pmf);
+	return result;
+}
+
+pcr_cursor_t *
+pcr_cursor_new(pcr_t *self) {
+	return pcr_cursor_new_format(self, PROM_FORMAT_TEXT);
+}
+
+pcr_cursor_t *
+pcr_cursor_new_format(pcr_t *self, prom_format_t format) {
+	if (self == NULL || format < 0 || format >= PROM_FORMAT_COUNT)
+		return NULL;
+	pcr_cursor_t *cursor = (pcr_cursor_t *) prom_malloc(sizeof(pcr_cursor_t));
+	if (cursor == NULL)
+		return NULL;
+	memset(cursor, 0, sizeof(pcr_cursor_t));
+
+	// Chunks are small, so there is no need to reserve anything.
+	cursor->metric_formatter = pcr_formatter_get(self, 0, format);
+	if (cursor->metric_formatter == NULL) {
+		prom_free(cursor);
+		return NULL;
 	}
-	return pmf_dump(self->metric_formatter);
+	cursor->registry = self;
+	cursor->scrape = (self->scrape_duration != NULL)
+		&& (self->features & PROM_SCRAPETIME);
+	cursor->parallel = self->workers != NULL;
+	pcr_snapshot_ages(self);
+	pcr_count_rejections(self);
+	pmf_cursor_init(&cursor->cursor, cursor->metric_formatter, self->collectors,
+		(self->features & PROM_SCRAPETIME_ALL) ? self->scrape_duration : NULL,
+		self->mprefix, (self->features & PROM_COMPACT) ? true : false);
+	return cursor;
+}
+
+/**
+ * @brief PRIVATE Render the next chunk of at least the given size into the
+ *	cursor's formatter, if possible.
+ */
+static void
+pcr_cursor_fill(pcr_cursor_t *self, size_t size) {
+	struct timespec start, end;
+	static const char *labels[] = { METRIC_LABEL_SCRAPE };
+	pcr_t *registry = self->registry;
+
+	if (self->scrape)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	bool more = false;
+	if (self->parallel)
+		self->cursor.err += pcr_load_metrics(registry, self->metric_formatter,
+			self->cursor.scrape_metric, self->cursor.compact, self->deadline);
+	else
+		more = pmf_cursor_next(&self->cursor, size);
+	if (self->scrape) {
+		int r = clock_gettime(CLOCK_MONOTONIC, &end);
+		time_t s = (r == 0) ? end.tv_sec - start.tv_sec : 0;
+		long ns = (r == 0) ? end.tv_nsec - start.tv_nsec : 0;
+		self->duration += s + ns*1e-9;
+	}
+	if (more)
+		return;
+
+	if (self->scrape) {
+		prom_gauge_set(registry->scrape_duration, self->duration, labels);
+		pmf_load_metric(self->metric_formatter, registry->scrape_duration,
+			registry->mprefix, self->cursor.compact);
+	}
+	pmf_load_end(self->metric_formatter);
+	self->done = true;
+}
+
+ssize_t
+pcr_cursor_read(pcr_cursor_t *self, char *buf, size_t size) {
+	if (self == NULL || buf == NULL)
+		return -1;
+
+	psb_t *sb = self->metric_formatter->string_builder;
+	size_t n = 0;
+	while (n < size) {
+		size_t len = psb_len(sb);
+		if (self->pos < len) {
+			size_t k = len - self->pos;
+			if (k > size - n)
+				k = size - n;
+			memcpy(buf + n, psb_str(sb) + self->pos, k);
+			self->pos += k;
+			n += k;
+			continue;
+		}
+		if (self->done)
+			break;
+		// Keep the buffer, it has about the right size for the next chunk.
+		psb_truncate(sb, 0);
+		self->pos = 0;
+		pcr_cursor_fill(self, size - n);
+	}
+	return n;
+}
+
+int
+pcr_cursor_set_timeout(pcr_cursor_t *self, unsigned int timeout) {
+	if (self == NULL)
+		return 1;
+	self->deadline = (timeout == 0) ? 0 : pcr_now_ms() + timeout;
+	return 0;
+}
+
+int
+pcr_cursor_destroy(pcr_cursor_t *self) {
+	if (self == NULL)
+		return 0;
+	pcr_formatter_put(self->registry, self->metric_formatter);
+	self->metric_formatter = NULL;
+	prom_free(self);
+	return 0;
 }
@@ -19,7 +19,9 @@
 #define PROM_REGISTRY_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // Public
 #include "prom_collector_registry.h"
@@ -28,6 +30,20 @@
 #include "prom_map_t.h"
 #include "prom_metric_formatter_t.h"
 #include "prom_string_builder.h"
+#include "prom_worker_pool_t.h"
+
+/** @brief PRIVATE Max. number of idle formatters a registry keeps. */
+#define PCR_FORMATTER_POOL_SIZE 4
+
+/**
+ * @brief PRIVATE Refreshes the periodic collectors of a registry.
+ */
+typedef struct pcr_scheduler {
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup;		/**< signaled on new collectors and on stop */
+	pthread_t thread;
+	bool stop;					/**< the thread should exit */
+} pcr_scheduler_t;
 
 struct pcr {
 	const char *name;				/**< name of the registry. Do not modify! */
@@ -36,8 +52,75 @@ struct pcr {
 	prom_metric_t *scrape_duration;	/**< scrape duration metric to use */
 	prom_map_t *collectors;			/**< Map of collectors keyed by name */
 	psb_t *string_builder;			/**< string building */
-	pmf_t *metric_formatter;		/**< export metric(s) */
 	pthread_rwlock_t *lock;		/**< mutex to guard concurrent modfications */
+	/** Idle formatters. Each export uses its own, so that concurrent scrapes
+		do not interfere. They keep their buffers between uses. */
+	pmf_t *formatter_pool[PCR_FORMATTER_POOL_SIZE];
+	unsigned int formatter_count;	/**< number of idle formatters */
+	/** size of the last pcr_export() by format */
+	_Atomic size_t bridge_size[PROM_FORMAT_COUNT];
+	pwp_t *workers;				/**< runs collectors concurrently or NULL */
+	/** Counts missed deadlines by collector. Created on the first miss. */
+	prom_metric_t *_Atomic timeouts;
+	pcr_scheduler_t *scheduler;	/**< started by the first periodic collector */
+	/** Age of the snapshots of periodic collectors. Created on start of the
+		scheduler. */
+	prom_metric_t *_Atomic snapshot_age;
+	size_t capacity;			/**< max. series per metric, 0 = unlimited */
+	size_t label_bytes;			/**< label storage per metric */
+	size_t max_series;			/**< series limit per metric, 0 = unlimited */
+	/** Counts new series rejected or folded by metric. Created on the first
+		rejection. */
+	prom_metric_t *_Atomic rejected;
+};
+
+typedef struct pcr_scrape pcr_scrape_t;
+
+/**
+ * @brief PRIVATE Renders a single collector on behalf of a worker.
+ */
+typedef struct pcr_job {
+	pwp_job_t job;
+	pcr_scrape_t *scrape;			/**< the export this job belongs to */
+	const char *name;				/**< name of the collector */
+	prom_collector_t *collector;
+	pmf_t *metric_formatter;		/**< where to render to */
+	prom_metric_t *scrape_metric;	/**< per collector durations or NULL */
+	const char *prefix;
+	bool compact;
+	uint64_t deadline;				/**< in ms (CLOCK_MONOTONIC), 0 = none */
+	uint64_t end;					/**< when the job finished */
+	bool submitted;					/**< queued for a worker */
+	bool periodic;					/**< export the snapshot, only */
+	bool done;						/**< finished */
+	bool abandoned;					/**< the export did not wait for it */
+	int err;						/**< number of errors */
+} pcr_job_t;
+
+/**
+ * @brief PRIVATE The jobs of a single export. Freed by the export or the last
+ *	job finished, whatever comes last.
+ */
+struct pcr_scrape {
+	pthread_mutex_t lock;
+	pthread_cond_t done;			/**< signaled whenever a job finished */
+	pcr_t *registry;
+	size_t remaining;				/**< number of jobs not yet finished */
+	unsigned int refs;				/**< export + jobs not yet finished */
+	size_t count;
+	pcr_job_t jobs[];
+};
+
+struct pcr_cursor {
+	pcr_t *registry;			/**< registry to export */
+	pmf_t *metric_formatter;	/**< buffers the current chunk */
+	pmf_cursor_t cursor;		/**< position within the collectors */
+	size_t pos;					/**< bytes of the current chunk already read */
+	double duration;			/**< time spent on rendering so far */
+	uint64_t deadline;			/**< in ms (CLOCK_MONOTONIC), 0 = none */
+	bool scrape;				/**< whether to append the scrape duration */
+	bool parallel;				/**< render all collectors at once using workers */
+	bool done;					/**< rendering is complete */
 };
 
 #endif  // PROM_REGISTRY_T_H
@@ -18,10 +18,24 @@
 #ifndef PROM_COLLECTOR_T_H
 #define PROM_COLLECTOR_T_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include "prom_collector.h"
+#include "prom_metric.h"
 #include "prom_map_t.h"
 #include "prom_string_builder.h"
 
+/**
+ * @brief PRIVATE An immutable export of the metrics of a collector.
+ */
+typedef struct prom_collector_snapshot {
+	size_t len;
+	char data[];
+} prom_collector_snapshot_t;
+
 struct prom_collector {
 	const char *name;
 	prom_map_t *metrics;
@@ -29,6 +43,16 @@ struct prom_collector {
 	psb_t *string_builder;
 	void *data;
 	prom_collector_free_data_fn *free_data_fn;
+	unsigned int timeout;		/**< time budget per scrape in ms, 0 = none */
+	/** Jobs still running for exports, which did not wait for them */
+	atomic_uint abandoned;
+	/** Last export by format, used if the collector misses a deadline or
+		gets refreshed periodically. Readers must be within a prom_epoch
+		section. */
+	prom_collector_snapshot_t *_Atomic snapshot[PROM_FORMAT_COUNT];
+	unsigned int interval;		/**< refresh interval in ms, 0 = on scrape */
+	_Atomic uint64_t refreshed;	/**< when the snapshot got taken, in ms */
+	uint64_t next;				/**< next refresh due, scheduler only */
 };
 
 #endif  // PROM_COLLECTOR_T_H
@@ -81,3 +81,30 @@ prom_counter_reset(prom_counter_t *self, double r_value, const char **label_vals
 	pms_t *s = pms_from_labels(self, label_vals);
 	return (s == NULL) ? 1 : pms_set(s, r_value);	// pms_set handles vals < 0
 }
+
+prom_counter_handle_t *
+prom_counter_bind(prom_counter_t *self, const char **label_vals) {
+	if (self == NULL)
+		return NULL;
+	if (self->type != PROM_COUNTER) {
+		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s",
+			self->type, self->name);
+		return NULL;
+	}
+	return pms_from_labels(self, label_vals);
+}
+
+int
+prom_counter_handle_inc(prom_counter_handle_t *h) {
+	return (h == NULL) ? 1 : pms_add(h, 1.0);
+}
+
+int
+prom_counter_handle_add(prom_counter_handle_t *h, double r_value) {
+	return (h == NULL) ? 1 : pms_add(h, r_value);
+}
+
+int
+prom_counter_handle_reset(prom_counter_handle_t *h, double r_value) {
+	return (h == NULL) ? 1 : pms_set(h, r_value);
+}
@@ -0,0 +1,362 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Grisu2 as described in "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers" by Florian Loitsch (PLDI 2010).
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Private
+#include "prom_dtoa_i.h"
+
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+
+/** @brief PRIVATE A "do it yourself" floating point number f * 2^e. */
+typedef struct diyfp {
+	uint64_t f;
+	int e;
+} diyfp_t;
+
+/** @brief PRIVATE Normalized 10^k for k = -348, -340, ..., 340. */
+static const uint64_t cached_powers_f[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+	0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+	0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+	0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+	0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+	0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+	0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+	0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+	0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+	0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+	0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+	0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+	0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+	0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+	0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+	0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+	0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+	0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+	0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+	0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+	0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+	0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+/** @brief PRIVATE The binary exponents of cached_powers_f. */
+static const int16_t cached_powers_e[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint64_t pow10_u64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static const char digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static inline diyfp_t
+diyfp_from_double(double d) {
+	uint64_t u;
+	memcpy(&u, &d, sizeof(u));
+	int biased_e = (int) ((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+	uint64_t significand = u & DP_SIGNIFICAND_MASK;
+	diyfp_t r;
+	if (biased_e != 0) {
+		r.f = significand + DP_HIDDEN_BIT;
+		r.e = biased_e - DP_EXPONENT_BIAS;
+	} else {
+		r.f = significand;
+		r.e = 1 - DP_EXPONENT_BIAS;
+	}
+	return r;
+}
+
+static inline diyfp_t
+diyfp_mul(diyfp_t a, diyfp_t b) {
+	unsigned __int128 p = (unsigned __int128) a.f * b.f;
+	uint64_t h = (uint64_t) (p >> 64);
+	uint64_t l = (uint64_t) p;
+	diyfp_t r = { h + (l >> 63), a.e + b.e + 64 };	// round
+	return r;
+}
+
+static inline diyfp_t
+diyfp_normalize(diyfp_t x) {
+	int s = __builtin_clzll(x.f);
+	diyfp_t r = { x.f << s, x.e - s };
+	return r;
+}
+
+/**
+ * @brief PRIVATE Get the normalized boundaries m- and m+ of the given value,
+ *	i.e. the midpoints to its neighbours, using the same exponent.
+ */
+static inline void
+diyfp_boundaries(diyfp_t v, diyfp_t *minus, diyfp_t *plus) {
+	diyfp_t pl = { (v.f << 1) + 1, v.e - 1 };
+	pl = diyfp_normalize(pl);
+	// The lower neighbour is closer, if v is a power of 2.
+	diyfp_t mi = (v.f == DP_HIDDEN_BIT)
+		? (diyfp_t) { (v.f << 2) - 1, v.e - 2 }
+		: (diyfp_t) { (v.f << 1) - 1, v.e - 1 };
+	mi.f <<= mi.e - pl.e;
+	mi.e = pl.e;
+	*plus = pl;
+	*minus = mi;
+}
+
+/**
+ * @brief PRIVATE Get the cached power c = 10^-K, such that the binary
+ *	exponent of c * 2^e is within [-60, -32].
+ */
+static inline diyfp_t
+cached_power(int e, int *K) {
+	double dk = (-61 - e) * 0.30102999566398114 + 347;	// 1/log2(10)
+	int k = (int) dk;
+	if (dk - k > 0.0)
+		k++;
+	unsigned int idx = (unsigned int) ((k >> 3) + 1);
+	*K = -(-348 + (int) idx * 8);
+	diyfp_t r = { cached_powers_f[idx], cached_powers_e[idx] };
+	return r;
+}
+
+static inline void
+grisu_round(char *buf, int len, uint64_t delta, uint64_t rest,
+	uint64_t ten_kappa, uint64_t wp_w)
+{
+	// Move the last digit towards w as long as we stay within the range.
+	while (rest < wp_w && delta - rest >= ten_kappa
+		&& (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+	{
+		buf[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+static inline int
+count_digits32(uint32_t n) {
+	int d = 1;
+	while (d < 10 && n >= pow10_u64[d])
+		d++;
+	return d;
+}
+
+/**
+ * @brief PRIVATE Generate the shortest digits of a number within
+ *	[Mp - delta, Mp], closest to W.
+ */
+static void
+digit_gen(diyfp_t W, diyfp_t Mp, uint64_t delta, char *buf, int *len, int *K)
+{
+	const diyfp_t one = { 1ULL << -Mp.e, Mp.e };
+	const uint64_t wp_w = Mp.f - W.f;
+	uint32_t p1 = (uint32_t) (Mp.f >> -one.e);
+	uint64_t p2 = Mp.f & (one.f - 1);
+	int kappa = count_digits32(p1);
+
+	*len = 0;
+	while (kappa > 0) {
+		uint32_t d = p1 / (uint32_t) pow10_u64[kappa - 1];
+		p1 %= (uint32_t) pow10_u64[kappa - 1];
+		if (d != 0 || *len != 0)
+			buf[(*len)++] = (char) ('0' + d);
+		kappa--;
+		uint64_t tmp = ((uint64_t) p1 << -one.e) + p2;
+		if (tmp <= delta) {
+			*K += kappa;
+			grisu_round(buf, *len, delta, tmp, pow10_u64[kappa] << -one.e, wp_w);
+			return;
+		}
+	}
+	for (;;) {
+		p2 *= 10;
+		delta *= 10;
+		char d = (char) (p2 >> -one.e);
+		if (d != 0 || *len != 0)
+			buf[(*len)++] = (char) ('0' + d);
+		p2 &= one.f - 1;
+		kappa--;
+		if (p2 < delta) {
+			*K += kappa;
+			grisu_round(buf, *len, delta, p2, one.f,
+				(-kappa < 20) ? wp_w * pow10_u64[-kappa] : 0);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief PRIVATE Get the digits of the given positive, finite value, such
+ *	that value = digits * 10^K.
+ */
+static void
+grisu2(double value, char *buf, int *len, int *K) {
+	diyfp_t v = diyfp_from_double(value);
+	diyfp_t w_m, w_p;
+	diyfp_boundaries(v, &w_m, &w_p);
+
+	diyfp_t c_mk = cached_power(w_p.e, K);
+	diyfp_t W = diyfp_mul(diyfp_normalize(v), c_mk);
+	diyfp_t Wp = diyfp_mul(w_p, c_mk);
+	diyfp_t Wm = diyfp_mul(w_m, c_mk);
+	// Stay inside the boundaries despite the rounding errors of diyfp_mul().
+	Wm.f++;
+	Wp.f--;
+	digit_gen(W, Wp, Wp.f - Wm.f, buf, len, K);
+}
+
+static inline char *
+write_exponent(int k, char *s) {
+	*s++ = 'e';
+	if (k < 0) {
+		*s++ = '-';
+		k = -k;
+	} else {
+		*s++ = '+';
+	}
+	// At least 2 digits like printf()
+	if (k >= 100) {
+		*s++ = (char) ('0' + k / 100);
+		k %= 100;
+	}
+	memcpy(s, digit_pairs + 2 * k, 2);
+	return s + 2;
+}
+
+/**
+ * @brief PRIVATE Format the given digits, which represent digits * 10^k.
+ * @return The end of the string.
+ */
+static char *
+prettify(char *buf, int len, int k) {
+	const int kk = len + k;	// 10^(kk-1) <= v < 10^kk
+
+	if (len <= kk && kk <= 21) {
+		// 1234e7 -> 12340000000
+		memset(buf + len, '0', (size_t) k);
+		return buf + kk;
+	}
+	if (0 < kk && kk <= 21) {
+		// 1234e-2 -> 12.34
+		memmove(buf + kk + 1, buf + kk, (size_t) (len - kk));
+		buf[kk] = '.';
+		return buf + len + 1;
+	}
+	if (-6 < kk && kk <= 0) {
+		// 1234e-6 -> 0.001234
+		int offset = 2 - kk;
+		memmove(buf + offset, buf, (size_t) len);
+		buf[0] = '0';
+		buf[1] = '.';
+		memset(buf + 2, '0', (size_t) -kk);
+		return buf + len + offset;
+	}
+	if (len == 1) {
+		// 1e30
+		return write_exponent(kk - 1, buf + 1);
+	}
+	// 1234e30 -> 1.234e+33
+	memmove(buf + 2, buf + 1, (size_t) (len - 1));
+	buf[1] = '.';
+	return write_exponent(kk - 1, buf + len + 1);
+}
+
+size_t
+prom_u64toa(uint64_t value, char *buf) {
+	char tmp[PROM_DTOA_BUFSZ];
+	char *s = tmp + sizeof(tmp);
+
+	// two digits at a time from the end
+	while (value >= 100) {
+		unsigned int i = (unsigned int) (value % 100) * 2;
+		value /= 100;
+		s -= 2;
+		memcpy(s, digit_pairs + i, 2);
+	}
+	if (value >= 10) {
+		s -= 2;
+		memcpy(s, digit_pairs + value * 2, 2);
+	} else {
+		*--s = (char) ('0' + value);
+	}
+	size_t len = tmp + sizeof(tmp) - s;
+	memcpy(buf, s, len);
+	buf[len] = '\0';
+	return len;
+}
+
+size_t
+prom_dtoa(double value, char *buf) {
+	char *s = buf;
+
+	if (isnan(value)) {
+		memcpy(buf, "NaN", 4);
+		return 3;
+	}
+	if (signbit(value)) {
+		*s++ = '-';
+		value = -value;
+	}
+	if (isinf(value)) {
+		if (s == buf)
+			*s++ = '+';
+		memcpy(s, "Inf", 4);
+		return 4;
+	}
+	if (value == 0) {
+		// -0 is fine for Prometheus, but let us keep it simple.
+		memcpy(buf, "0", 2);
+		return 1;
+	}
+	// Integer fast path: exact and cheap for all counter like values.
+	if (value < 9007199254740992.0 && value == (double) (uint64_t) value)
+		return (s - buf) + prom_u64toa((uint64_t) value, s);
+
+	int len, K;
+	grisu2(value, s, &len, &K);
+	s = prettify(s, len, K);
+	*s = '\0';
+	return s - buf;
+}
@@ -0,0 +1,55 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_DTOA_I_H
+#define PROM_DTOA_I_H
+
+/**
+ * @file prom_dtoa_i.h
+ * @brief PRIVATE Locale independent number to string conversion for the
+ *	exposition format.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief PRIVATE Min. size of the buffer passed to prom_dtoa() and
+ *	prom_u64toa(), incl. the terminating \c '\0'.
+ */
+#define PROM_DTOA_BUFSZ 32
+
+/**
+ * @brief PRIVATE Write the shortest string, which reads back as the given
+ *	value, to the given buffer. Uses Grisu2, which yields the shortest
+ *	representation for almost all values and a correctly round-tripping one
+ *	for all. Whole numbers below 2^53 take an integer fast path.
+ *
+ * The output is independent of the locale: \c "-12", \c "0.25", \c "1e+21",
+ * \c "1.5e-07", \c "+Inf", \c "-Inf" or \c "NaN".
+ * @param buf	Where to store the string. Must have room for at least
+ *	\c PROM_DTOA_BUFSZ characters.
+ * @return The length of the string.
+ */
+size_t prom_dtoa(double value, char *buf);
+
+/**
+ * @brief PRIVATE Write the given value as decimal string to the given buffer.
+ * @param buf	Where to store the string. Must have room for at least
+ *	\c PROM_DTOA_BUFSZ characters.
+ * @return The length of the string.
+ */
+size_t prom_u64toa(uint64_t value, char *buf);
+
+#endif  // PROM_DTOA_I_H
@@ -0,0 +1,209 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_epoch_i.h"
+#include "prom_epoch_t.h"
+#include "prom_log.h"
+
+// Objects retired at epoch e get freed once the global epoch is e + 2.
+#define PROM_EPOCH_GRACE 2
+
+static _Atomic uint64_t global_epoch = ATOMIC_VAR_INIT(1);
+static prom_epoch_record_t *_Atomic records = ATOMIC_VAR_INIT(NULL);
+static _Thread_local prom_epoch_record_t *own_record = NULL;
+
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t record_key;
+
+static pthread_mutex_t retired_lock = PTHREAD_MUTEX_INITIALIZER;
+static prom_epoch_retired_t *retired = NULL;
+static size_t retired_count = 0;
+
+static void
+release_record(void *data) {
+	prom_epoch_record_t *r = (prom_epoch_record_t *) data;
+	r->depth = 0;
+	atomic_store_explicit(&r->epoch, 0, memory_order_release);
+	atomic_store_explicit(&r->used, false, memory_order_release);
+}
+
+static void
+make_record_key(void) {
+	if (pthread_key_create(&record_key, release_record))
+		PROM_WARN("Unable to create the epoch record key.", NULL);
+}
+
+/**
+ * @brief PRIVATE Allocate a new record and add it to the list of records.
+ */
+static prom_epoch_record_t *
+new_record(bool used) {
+	prom_epoch_record_t *r = (prom_epoch_record_t *)
+		prom_malloc(sizeof(prom_epoch_record_t));
+	if (r == NULL)
+		return NULL;
+	atomic_init(&r->epoch, 0);
+	atomic_init(&r->used, used);
+	r->depth = 0;
+	r->next = atomic_load(&records);
+	while (!atomic_compare_exchange_weak(&records, &r->next, r))
+		;
+	return r;
+}
+
+static prom_epoch_record_t *
+acquire_record(void) {
+	prom_epoch_record_t *r;
+
+	pthread_once(&record_key_once, make_record_key);
+	// Reuse the record of an exited thread if possible.
+	for (r = atomic_load(&records); r != NULL; r = r->next) {
+		bool expected = false;
+		if (!atomic_load_explicit(&r->used, memory_order_relaxed)
+			&& atomic_compare_exchange_strong(&r->used, &expected, true))
+		{
+			goto found;
+		}
+	}
+	if ((r = new_record(true)) == NULL)
+		return NULL;
+
+found:
+	pthread_setspecific(record_key, r);
+	own_record = r;
+	return r;
+}
+
+int
+prom_epoch_reserve(unsigned int count) {
+	unsigned int unused = 0;
+	for (prom_epoch_record_t *r = atomic_load(&records); r != NULL;
+		r = r->next)
+	{
+		if (!atomic_load_explicit(&r->used, memory_order_relaxed))
+			unused++;
+	}
+	for (; unused < count; unused++) {
+		if (new_record(false) == NULL)
+			return 1;
+	}
+	return 0;
+}
+
+void
+prom_epoch_enter(void) {
+	prom_epoch_record_t *r = own_record;
+	if (r == NULL && (r = acquire_record()) == NULL) {
+		PROM_WARN("Unable to allocate an epoch record.", NULL);
+		return;
+	}
+	if (r->depth++ > 0)
+		return;
+	atomic_store(&r->epoch, atomic_load(&global_epoch));
+	// Make the record visible before any protected pointer gets loaded.
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+void
+prom_epoch_exit(void) {
+	prom_epoch_record_t *r = own_record;
+	if (r == NULL || r->depth == 0)
+		return;
+	if (--r->depth == 0)
+		atomic_store_explicit(&r->epoch, 0, memory_order_release);
+}
+
+/**
+ * @brief PRIVATE Advance the global epoch, if all active readers have seen
+ *	the current one.
+ * @return The (new) global epoch.
+ */
+static uint64_t
+try_advance(void) {
+	uint64_t e = atomic_load(&global_epoch);
+	for (prom_epoch_record_t *r = atomic_load(&records); r != NULL;
+		r = r->next)
+	{
+		uint64_t v = atomic_load(&r->epoch);
+		if (v != 0 && v != e)
+			return e;
+	}
+	if (atomic_compare_exchange_strong(&global_epoch, &e, e + 1))
+		return e + 1;
+	return e;	// updated to the current value by the failed CAS
+}
+
+int
+prom_epoch_retire(void *ptr, prom_epoch_free_fn *free_fn) {
+	if (ptr == NULL)
+		return 0;
+	prom_epoch_retired_t *item = (prom_epoch_retired_t *)
+		prom_malloc(sizeof(prom_epoch_retired_t));
+	if (item == NULL)
+		return 1;
+	item->ptr = ptr;
+	item->free_fn = free_fn;
+
+	pthread_mutex_lock(&retired_lock);
+	atomic_thread_fence(memory_order_seq_cst);
+	item->epoch = atomic_load(&global_epoch);
+	item->next = retired;
+	retired = item;
+	retired_count++;
+	pthread_mutex_unlock(&retired_lock);
+
+	prom_epoch_reclaim();
+	return 0;
+}
+
+size_t
+prom_epoch_reclaim(void) {
+	prom_epoch_retired_t *done = NULL;
+	size_t left;
+
+	pthread_mutex_lock(&retired_lock);
+	uint64_t e = try_advance();
+	prom_epoch_retired_t **prev = &retired;
+	while (*prev != NULL) {
+		prom_epoch_retired_t *item = *prev;
+		if (item->epoch + PROM_EPOCH_GRACE <= e) {
+			*prev = item->next;
+			item->next = done;
+			done = item;
+			retired_count--;
+		} else {
+			prev = &item->next;
+		}
+	}
+	left = retired_count;
+	pthread_mutex_unlock(&retired_lock);
+
+	// Free functions may retire objects themselves.
+	while (done != NULL) {
+		prom_epoch_retired_t *item = done;
+		done = item->next;
+		item->free_fn(item->ptr);
+		prom_free(item);
+	}
+	return left;
+}
@@ -0,0 +1,68 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_EPOCH_I_H
+#define PROM_EPOCH_I_H
+
+/**
+ * @file prom_epoch_i.h
+ * @brief PRIVATE Epoch based reclamation of memory, which may still be read
+ *	by lock-free readers.
+ *
+ * Readers wrap their accesses into prom_epoch_enter() and prom_epoch_exit().
+ * Writers unlink an object first, and hand it over to prom_epoch_retire()
+ * instead of freeing it. It gets freed as soon as no reader, which might
+ * have seen it, is active anymore, i.e. when the global epoch got advanced
+ * twice since the object got retired.
+ */
+
+/**
+ * @brief PRIVATE The function to call to free a retired object.
+ */
+typedef void prom_epoch_free_fn(void *ptr);
+
+/**
+ * @brief PRIVATE Make sure, that the given number of unused per thread
+ *	records exist, so that as many threads can enter their first read-side
+ *	critical section without allocating anything.
+ * @return A non-zero value on error, \c 0 otherwise.
+ */
+int prom_epoch_reserve(unsigned int count);
+
+/**
+ * @brief PRIVATE Enter a read-side critical section. May be nested.
+ */
+void prom_epoch_enter(void);
+
+/**
+ * @brief PRIVATE Leave a read-side critical section.
+ */
+void prom_epoch_exit(void);
+
+/**
+ * @brief PRIVATE Free the given object using the given function as soon as
+ *	no reader can access it anymore.
+ * @return Non-zero integer value upon failure, \c 0 otherwise. On failure
+ *	the object did not get retired and thus is still owned by the caller.
+ */
+int prom_epoch_retire(void *ptr, prom_epoch_free_fn *free_fn);
+
+/**
+ * @brief PRIVATE Try to advance the global epoch and free all retired objects,
+ *	which are safe to free now.
+ * @return The number of objects still waiting to be freed.
+ */
+size_t prom_epoch_reclaim(void);
+
+#endif  // PROM_EPOCH_I_H
@@ -0,0 +1,46 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_EPOCH_T_H
+#define PROM_EPOCH_T_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Private
+#include "prom_epoch_i.h"
+
+/**
+ * @brief PRIVATE Per thread state. Records are never freed, but reused by
+ *	other threads after the owning thread exited.
+ */
+typedef struct prom_epoch_record {
+	_Atomic uint64_t epoch;		/**< epoch seen on enter, 0 if not active */
+	atomic_bool used;			/**< owned by a thread */
+	unsigned int depth;			/**< nesting level of the owner */
+	struct prom_epoch_record *next;
+} prom_epoch_record_t;
+
+/**
+ * @brief PRIVATE An object waiting to be freed.
+ */
+typedef struct prom_epoch_retired {
+	void *ptr;
+	prom_epoch_free_fn *free_fn;
+	uint64_t epoch;				/**< global epoch when retired */
+	struct prom_epoch_retired *next;
+} prom_epoch_retired_t;
+
+#endif  // PROM_EPOCH_T_H
@@ -22,5 +22,8 @@
 #define PROM_PTHREAD_RWLOCK_INIT_ERROR "failed to initialize the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_LOCK_ERROR "failed to lock the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_UNLOCK_ERROR "failed to unlock the pthread_rwlock_t*"
+#define PROM_PTHREAD_MUTEX_INIT_ERROR "failed to initialize the pthread_mutex_t*"
+#define PROM_PTHREAD_MUTEX_LOCK_ERROR "failed to lock the pthread_mutex_t*"
+#define PROM_PTHREAD_MUTEX_UNLOCK_ERROR "failed to unlock the pthread_mutex_t*"
 #define PROM_REGEX_REGCOMP_ERROR "failed to compile the regular expression"
 #define PROM_REGEX_REGEXEC_ERROR "failed to execute the regular expression"
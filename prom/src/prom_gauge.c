@@ -106,3 +106,40 @@ prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_vals) {
 	pms_t *s = pms_from_labels(self, label_vals);
 	return (s == NULL) ? 1 : pms_set(s, r_value);
 }
+
+prom_gauge_handle_t *
+prom_gauge_bind(prom_gauge_t *self, const char **label_vals) {
+	if (self == NULL)
+		return NULL;
+	if (self->type != PROM_GAUGE) {
+		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s",
+			self->type, self->name);
+		return NULL;
+	}
+	return pms_from_labels(self, label_vals);
+}
+
+int
+prom_gauge_handle_inc(prom_gauge_handle_t *h) {
+	return (h == NULL) ? 1 : pms_add(h, 1.0);
+}
+
+int
+prom_gauge_handle_dec(prom_gauge_handle_t *h) {
+	return (h == NULL) ? 1 : pms_sub(h, 1.0);
+}
+
+int
+prom_gauge_handle_add(prom_gauge_handle_t *h, double r_value) {
+	return (h == NULL) ? 1 : pms_add(h, r_value);
+}
+
+int
+prom_gauge_handle_sub(prom_gauge_handle_t *h, double r_value) {
+	return (h == NULL) ? 1 : pms_sub(h, r_value);
+}
+
+int
+prom_gauge_handle_set(prom_gauge_handle_t *h, double r_value) {
+	return (h == NULL) ? 1 : pms_set(h, r_value);
+}
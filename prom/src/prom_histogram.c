@@ -30,6 +30,10 @@
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_histogram_t.h"
 #include "prom_metric_t.h"
+#include "prom_pool_i.h"
+
+// Max. number of samples of a histogram, which share one allocation.
+#define PROM_HISTOGRAM_SAMPLES_PER_SLAB 64
 
 prom_histogram_t *
 prom_histogram_new(const char *name, const char *help, phb_t *buckets,
@@ -37,6 +41,8 @@ prom_histogram_new(const char *name, const char *help, phb_t *buckets,
 {
 	prom_histogram_t *self = (prom_histogram_t *)
 		prom_metric_new(PROM_HISTOGRAM,name, help, label_key_count, label_keys);
+	if (self == NULL)
+		return NULL;
 	if (buckets == NULL) {
 		if (prom_histogram_default_buckets == NULL) {
 			prom_histogram_default_buckets = phb_new(11, 0.005, 0.01, 0.025,
@@ -54,6 +60,20 @@ prom_histogram_new(const char *name, const char *help, phb_t *buckets,
 		}
 		self->buckets = buckets;
 	}
+	// Samples have the same size, so get them from the pool of the metric.
+	if (prom_pool_init(&self->pool, pms_histogram_size(self->buckets),
+		PROM_HISTOGRAM_SAMPLES_PER_SLAB))
+	{
+		prom_metric_destroy(self);
+		return NULL;
+	}
+	if (label_key_count == 0) {
+		self->unlabeled = pms_histogram_from_labels(self, NULL);
+		if (self->unlabeled == NULL) {
+			prom_metric_destroy(self);
+			return NULL;
+		}
+	}
 	return self;
 }
 
@@ -76,3 +96,20 @@ prom_histogram_observe(prom_histogram_t *self, double val,
 	pms_histogram_t *s = pms_histogram_from_labels(self, label_vals);
 	return (s == NULL) ? 1 : pms_histogram_observe(s, val);
 }
+
+prom_histogram_handle_t *
+prom_histogram_bind(prom_histogram_t *self, const char **label_vals) {
+	if (self == NULL)
+		return NULL;
+	if (self->type != PROM_HISTOGRAM) {
+		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s",
+			self->type, self->name);
+		return NULL;
+	}
+	return pms_histogram_from_labels(self, label_vals);
+}
+
+int
+prom_histogram_handle_observe(prom_histogram_handle_t *h, double val) {
+	return (h == NULL) ? 1 : pms_histogram_observe(h, val);
+}
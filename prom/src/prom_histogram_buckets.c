@@ -15,8 +15,18 @@
  * limitations under the License.
  */
 
+#include <math.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PHB_X86
+#endif
 
 // Public
 #include "prom_alloc.h"
@@ -24,18 +34,28 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_dtoa_i.h"
+#include "prom_histogram_buckets_i.h"
 #include "prom_log.h"
 
+// Up to this number of upper bounds a simple scan is the fastest, above
+// PHB_SIMD_MAX a binary search (see bench/prom_histogram_bench).
+#define PHB_SCAN_MAX 2
+#define PHB_SIMD_MAX 32
+
 phb_t *prom_histogram_default_buckets = NULL;
 
 static char *
 double_to_str(double value) {
-	char buf[32];
-	int len = sprintf(buf, "%.17g", value);
-	if (!strchr(buf, '.') && len < 30) {
-		buf[len] = '.'; buf[len+1] = '0'; len += 2; buf[len] = '\0';
+	char buf[PROM_DTOA_BUFSZ + 2];
+	size_t len = prom_dtoa(value, buf);
+	// whole numbers get rendered as e.g. "5.0" like the other client libs
+	if (strspn(buf, "-0123456789") == len) {
+		buf[len++] = '.';
+		buf[len++] = '0';
+		buf[len] = '\0';
 	}
-	return strdup(buf);
+	return prom_strdup(buf);
 }
 
 phb_t *
@@ -47,6 +67,9 @@ phb_new(size_t count, double bucket, ...) {
 	self->count = count;
 	self->upper_bound = NULL;
 	self->key = NULL;
+	self->layout = PHB_ARBITRARY;
+	self->start = bucket;
+	self->step = 0;
 	double *upper_bounds = (double *) prom_malloc(sizeof(double) * count);
 	const char **keys = (const char **) prom_malloc(sizeof(char *) * count);
 	if (upper_bounds == NULL || keys == NULL) {
@@ -82,8 +105,10 @@ phb_linear(double start, double width, size_t count) {
 	phb_t *self = (phb_t *) prom_malloc(sizeof(phb_t));
 	if (self == NULL)
 		return NULL;
+	self->count = 0;
 	self->upper_bound = NULL;
 	self->key = NULL;
+	self->layout = PHB_ARBITRARY;
 	double *upper_bounds = (double *) prom_malloc(sizeof(double) * count);
 	const char **keys = (const char **) prom_malloc(sizeof(char *) * count);
 	if (upper_bounds == NULL || keys == NULL) {
@@ -99,6 +124,10 @@ phb_linear(double start, double width, size_t count) {
 	self->upper_bound = upper_bounds;
 	self->key = keys;
 	self->count = count;
+	self->start = start;
+	// a non-positive width gives no ascending bounds, so just search
+	self->layout = width > 0 ? PHB_LINEAR : PHB_ARBITRARY;
+	self->step = width > 0 ? 1 / width : 0;
 	return self;
 }
 
@@ -120,8 +149,10 @@ phb_exponential(double start, double factor, size_t count) {
 	phb_t *self = (phb_t *) prom_malloc(sizeof(phb_t));
 	if (self == NULL)
 		return NULL;
+	self->count = 0;
 	self->upper_bound = NULL;
 	self->key = NULL;
+	self->layout = PHB_ARBITRARY;
 	double *upper_bounds = (double *) prom_malloc(sizeof(double) * count);
 	const char **keys = (const char **) prom_malloc(sizeof(char *) * count);
 	if (upper_bounds == NULL || keys == NULL) {
@@ -137,6 +168,9 @@ phb_exponential(double start, double factor, size_t count) {
 	self->upper_bound = upper_bounds;
 	self->key = keys;
 	self->count = count;
+	self->start = start;
+	self->layout = PHB_EXPONENTIAL;
+	self->step = 1 / log2(factor);
 	return self;
 }
 
@@ -144,8 +178,8 @@ int
 phb_destroy(phb_t *self) {
 	if (self == NULL)
 		return 0;
-	for (int i=0; i < self->count; i++)
-		free((char *) self->key[i]);
+	for (int i=0; self->key != NULL && i < self->count; i++)
+		prom_free((char *) self->key[i]);
 	prom_free((double *) self->upper_bound);
 	prom_free((char **) self->key);
 	prom_free(self);
@@ -157,3 +191,145 @@ phb_count(phb_t *self) {
 	PROM_ASSERT(self != NULL);
 	return self->count;
 }
+
+size_t
+phb_search_scan(const double *upper_bound, size_t count, double value) {
+	size_t i = 0;
+	while (i < count && !(value <= upper_bound[i]))
+		i++;
+	return i;
+}
+
+size_t
+phb_search_branchless(const double *upper_bound, size_t count, double value) {
+	if (count == 0)
+		return 0;
+	const double *base = upper_bound;
+	while (count > 1) {
+		size_t half = count / 2;
+		base = !(value <= base[half - 1]) ? base + half : base;
+		count -= half;
+	}
+	return (base - upper_bound) + !(value <= *base);
+}
+
+#ifdef PHB_X86
+// Count all bounds below the value instead of stopping at the first one
+// above it: no data dependent branches to mispredict. A true comparison
+// yields all bits set, i.e. -1, so subtracting it counts. NLE is true for NaN.
+__attribute__((target("sse2"))) size_t
+phb_search_sse2(const double *upper_bound, size_t count, double value) {
+	__m128d v = _mm_set1_pd(value);
+	__m128i r = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+		r = _mm_sub_epi64(r, _mm_castpd_si128(
+			_mm_cmpnle_pd(v, _mm_loadu_pd(upper_bound + i))));
+	uint64_t lane[2];
+	_mm_storeu_si128((__m128i *) lane, r);
+	size_t n = lane[0] + lane[1];
+	if (i < count)
+		n += !(value <= upper_bound[i]);
+	return n;
+}
+
+__attribute__((target("avx2"))) size_t
+phb_search_avx2(const double *upper_bound, size_t count, double value) {
+	__m256d v = _mm256_set1_pd(value);
+	__m256i r = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		r = _mm256_sub_epi64(r, _mm256_castpd_si256(_mm256_cmp_pd(v,
+			_mm256_loadu_pd(upper_bound + i), _CMP_NLE_UQ)));
+	uint64_t lane[4];
+	_mm256_storeu_si256((__m256i *) lane, r);
+	size_t n = lane[0] + lane[1] + lane[2] + lane[3];
+	for (; i < count; i++)
+		n += !(value <= upper_bound[i]);
+	return n;
+}
+#else
+size_t
+phb_search_sse2(const double *upper_bound, size_t count, double value) {
+	return (size_t) -1;
+}
+
+size_t
+phb_search_avx2(const double *upper_bound, size_t count, double value) {
+	return (size_t) -1;
+}
+#endif
+
+bool
+phb_search_supported(phb_search_fn *fn) {
+#ifdef PHB_X86
+	if (fn == phb_search_sse2)
+		return __builtin_cpu_supports("sse2");
+	if (fn == phb_search_avx2)
+		return __builtin_cpu_supports("avx2");
+	return true;
+#else
+	return fn != phb_search_sse2 && fn != phb_search_avx2;
+#endif
+}
+
+phb_search_fn *
+phb_search_select(size_t count) {
+	static phb_search_fn *_Atomic simd = NULL;
+
+	if (count <= PHB_SCAN_MAX)
+		return phb_search_scan;
+	if (count > PHB_SIMD_MAX)
+		return phb_search_branchless;
+
+	phb_search_fn *fn = atomic_load_explicit(&simd, memory_order_relaxed);
+	if (fn == NULL) {
+		fn = phb_search_supported(phb_search_avx2) ? phb_search_avx2
+			: phb_search_supported(phb_search_sse2) ? phb_search_sse2
+			: phb_search_branchless;
+		atomic_store_explicit(&simd, fn, memory_order_relaxed);
+	}
+	return fn;
+}
+
+// log2(x) for normal x > 0 with an absolute error < 0.09: the exponent plus
+// the mantissa as linear approximation of log2(1 + m).
+static inline double
+fast_log2(double x) {
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int64_t e = (int64_t) ((bits >> 52) & 0x7ff) - 1023;
+	bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+	memcpy(&x, &bits, sizeof(x));
+	return e + (x - 1.0);
+}
+
+size_t
+phb_index(phb_t *self, double value) {
+	PROM_ASSERT(self != NULL);
+	size_t n = self->count;
+	const double *ub = self->upper_bound;
+
+	if (self->layout == PHB_ARBITRARY || n == 0)
+		return phb_search_select(n)(ub, n, value);
+
+	// Handles NaN, too.
+	if (value <= self->start)
+		return 0;
+	if (!(value < ub[n - 1]))
+		return (value <= ub[n - 1]) ? n - 1 : n;
+
+	// start < value < ub[n - 1], so the estimate is in (0, n - 1) and the
+	// loops below just fix rounding errors (bounds got computed iteratively).
+	double d = (self->layout == PHB_LINEAR)
+		? (value - self->start) * self->step
+		: fast_log2(value / self->start) * self->step;
+	size_t i = (size_t) ceil(d);
+	if (i > n - 1)
+		i = n - 1;
+	while (i > 0 && value <= ub[i - 1])
+		i--;
+	while (!(value <= ub[i]))
+		i++;
+	return i;
+}
@@ -0,0 +1,64 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_HISTOGRAM_BUCKETS_I_H
+#define PROM_HISTOGRAM_BUCKETS_I_H
+
+#include <stdbool.h>
+
+// Public
+#include "prom_histogram_buckets.h"
+
+/**
+ * @brief PRIVATE A search kernel: get the number of ascending upper bounds,
+ *	which are not greater than or equal to the given value. So \c NaN yields
+ *	\c count .
+ */
+typedef size_t phb_search_fn(const double *upper_bound, size_t count, double value);
+
+/**
+ * @brief PRIVATE Scan the upper bounds from the lowest one, stop on match.
+ */
+size_t phb_search_scan(const double *upper_bound, size_t count, double value);
+
+/**
+ * @brief PRIVATE Branchless binary search.
+ */
+size_t phb_search_branchless(const double *upper_bound, size_t count, double value);
+
+/**
+ * @brief PRIVATE Compare 2 upper bounds at once using SSE2. Returns
+ *	\c (size_t) -1 if not available on this platform.
+ */
+size_t phb_search_sse2(const double *upper_bound, size_t count, double value);
+
+/**
+ * @brief PRIVATE Compare 4 upper bounds at once using AVX2. Returns
+ *	\c (size_t) -1 if not available on this platform.
+ */
+size_t phb_search_avx2(const double *upper_bound, size_t count, double value);
+
+/**
+ * @brief PRIVATE Check, whether the given search kernel can be used on this
+ *	CPU.
+ */
+bool phb_search_supported(phb_search_fn *fn);
+
+/**
+ * @brief PRIVATE Get the search kernel used for arbitrary buckets with the
+ *	given number of upper bounds on this CPU.
+ */
+phb_search_fn *phb_search_select(size_t count);
+
+#endif  // PROM_HISTOGRAM_BUCKETS_I_H
@@ -0,0 +1,148 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_errors.h"
+#include "prom_intern_i.h"
+#include "prom_intern_t.h"
+#include "prom_log.h"
+#include "prom_map_i.h"
+
+/** @brief PRIVATE Initial number of buckets of the intern pool. */
+#define PROM_INTERN_BUCKETS 64
+
+// The pool is shared by all registries and metrics: label keys and values
+// like "method" or "GET" repeat across all of them. It gets consulted only,
+// when a metric or series gets created, so a single lock is good enough.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static prom_intern_entry_t **buckets = NULL;
+static size_t bucket_count = 0;		/**< always a power of 2 */
+static size_t count = 0;			/**< number of entries */
+
+/**
+ * @brief PRIVATE Double the number of buckets of the pool. The caller must
+ *	hold the lock.
+ */
+static int
+prom_intern_grow(void) {
+	size_t n = (bucket_count == 0) ? PROM_INTERN_BUCKETS : bucket_count * 2;
+	prom_intern_entry_t **b = (prom_intern_entry_t **)
+		prom_calloc(n, sizeof(prom_intern_entry_t *));
+	if (b == NULL)
+		return 1;
+	for (size_t i = 0; i < bucket_count; i++) {
+		prom_intern_entry_t *e = buckets[i];
+		while (e != NULL) {
+			prom_intern_entry_t *next = e->next;
+			e->next = b[e->hash & (n - 1)];
+			b[e->hash & (n - 1)] = e;
+			e = next;
+		}
+	}
+	prom_free(buckets);
+	buckets = b;
+	bucket_count = n;
+	return 0;
+}
+
+const char *
+prom_intern(const char *str) {
+	if (str == NULL)
+		return NULL;
+	size_t len = strlen(str);
+	uint64_t hash = prom_map_hash(str, len);
+	const char *res = NULL;
+
+	if (pthread_mutex_lock(&lock)) {
+		PROM_WARN(PROM_PTHREAD_MUTEX_LOCK_ERROR, NULL);
+		return NULL;
+	}
+	prom_intern_entry_t *e = (bucket_count == 0)
+		? NULL
+		: buckets[hash & (bucket_count - 1)];
+	for (; e != NULL; e = e->next) {
+		if (e->hash == hash && strcmp(e->str, str) == 0) {
+			e->refs++;
+			res = e->str;
+			goto end;
+		}
+	}
+	if (count >= bucket_count && prom_intern_grow())
+		goto end;
+	e = (prom_intern_entry_t *) prom_malloc(sizeof(prom_intern_entry_t)
+		+ len + 1);
+	if (e == NULL)
+		goto end;
+	memcpy(e->str, str, len + 1);
+	e->hash = hash;
+	e->refs = 1;
+	e->next = buckets[hash & (bucket_count - 1)];
+	buckets[hash & (bucket_count - 1)] = e;
+	count++;
+	res = e->str;
+
+end:
+	if (pthread_mutex_unlock(&lock))
+		PROM_WARN(PROM_PTHREAD_MUTEX_UNLOCK_ERROR, NULL);
+	return res;
+}
+
+void
+prom_intern_release(const char *str) {
+	if (str == NULL)
+		return;
+	prom_intern_entry_t *e = (prom_intern_entry_t *)
+		(str - offsetof(prom_intern_entry_t, str));
+
+	if (pthread_mutex_lock(&lock)) {
+		PROM_WARN(PROM_PTHREAD_MUTEX_LOCK_ERROR, NULL);
+		return;
+	}
+	if (--e->refs > 0)
+		goto end;
+	prom_intern_entry_t **p = &buckets[e->hash & (bucket_count - 1)];
+	while (*p != e)
+		p = &(*p)->next;
+	*p = e->next;
+	prom_free(e);
+	// Leave nothing behind, when the last metric is gone.
+	if (--count == 0) {
+		prom_free(buckets);
+		buckets = NULL;
+		bucket_count = 0;
+	}
+
+end:
+	if (pthread_mutex_unlock(&lock))
+		PROM_WARN(PROM_PTHREAD_MUTEX_UNLOCK_ERROR, NULL);
+}
+
+size_t
+prom_intern_count(void) {
+	if (pthread_mutex_lock(&lock)) {
+		PROM_WARN(PROM_PTHREAD_MUTEX_LOCK_ERROR, NULL);
+		return 0;
+	}
+	size_t n = count;
+	if (pthread_mutex_unlock(&lock))
+		PROM_WARN(PROM_PTHREAD_MUTEX_UNLOCK_ERROR, NULL);
+	return n;
+}
@@ -0,0 +1,40 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_INTERN_I_H
+#define PROM_INTERN_I_H
+
+#include <stddef.h>
+
+/**
+ * @brief PRIVATE Get the shared copy of the given string from the process
+ *	wide intern pool, creating it if needed. Equal strings yield the same
+ *	pointer, so they can be compared by address. Each call needs to be
+ *	balanced by a call of prom_intern_release(). Thread-safe.
+ * @return \c NULL on error.
+ */
+const char *prom_intern(const char *str);
+
+/**
+ * @brief PRIVATE Drop a reference obtained by prom_intern(). The copy gets
+ *	freed together with its last reference. A \c NULL string gets ignored.
+ */
+void prom_intern_release(const char *str);
+
+/**
+ * @brief PRIVATE Get the number of distinct strings in the intern pool.
+ */
+size_t prom_intern_count(void);
+
+#endif  // PROM_INTERN_I_H
@@ -0,0 +1,35 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_INTERN_T_H
+#define PROM_INTERN_T_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Private
+#include "prom_intern_i.h"
+
+/**
+ * @brief PRIVATE A string of the intern pool. prom_intern() hands out the
+ *	address of \c str, so the entry can be found from it without a lookup.
+ */
+typedef struct prom_intern_entry {
+	struct prom_intern_entry *next;	/**< next entry of the same bucket */
+	uint64_t hash;					/**< prom_map_hash() of the string */
+	size_t refs;					/**< number of references handed out */
+	char str[];
+} prom_intern_entry_t;
+
+#endif  // PROM_INTERN_T_H
@@ -23,6 +23,13 @@
 #include "prom_linked_list_i.h"
 #include "prom_linked_list_t.h"
 #include "prom_log.h"
+#include "prom_pool_i.h"
+#include "prom_pool_t.h"
+
+// All lists share a pool of nodes.
+#define PLL_NODES_PER_SLAB 256
+static prom_pool_t node_pool =
+	PROM_POOL_INITIALIZER(sizeof(pll_node_t), PLL_NODES_PER_SLAB);
 
 pll_t *
 pll_new(void) {
@@ -52,8 +59,7 @@ pll_purge(pll_t *self) {
 				prom_free(node->item);
 			}
 		}
-		prom_free(node);
-		node = NULL;
+		prom_pool_free(&node_pool, node);
 		node = next;
 	}
 	self->head = NULL;
@@ -86,7 +92,7 @@ int
 pll_append(pll_t *self, void *item) {
 	if (self == NULL)
 		return 1;
-	pll_node_t *node = (pll_node_t *) prom_malloc(sizeof(pll_node_t));
+	pll_node_t *node = (pll_node_t *) prom_pool_alloc(&node_pool);
 	if (node == NULL)
 		return 2;
 
@@ -106,7 +112,7 @@ int
 pll_push(pll_t *self, void *item) {
 	if (self == NULL)
 		return 1;
-	pll_node_t *node = (pll_node_t *) prom_malloc(sizeof(pll_node_t));
+	pll_node_t *node = (pll_node_t *) prom_pool_alloc(&node_pool);
 	if (node == NULL)
 		return 2;
 
@@ -138,8 +144,7 @@ pll_pop(pll_t *self) {
 			prom_free(node->item);
 		}
 	}
-	node->item = NULL;
-	node = NULL;
+	prom_pool_free(&node_pool, node);
 	self->size--;
 	return item;
 }
@@ -181,9 +186,7 @@ pll_remove(pll_t *self, void *item) {
 		}
 	}
 
-	node->item = NULL;
-	prom_free(node);
-	node = NULL;
+	prom_pool_free(&node_pool, node);
 	self->size--;
 	return 0;
 }
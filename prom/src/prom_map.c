@@ -16,127 +16,141 @@
  */
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
 
 // Private
 #include "prom_assert.h"
+#include "prom_epoch_i.h"
 #include "prom_errors.h"
-#include "prom_linked_list_i.h"
-#include "prom_linked_list_t.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_map_t.h"
 
 #define PROM_MAP_INITIAL_SIZE 32
+#define PROM_MAP_NOT_FOUND ((size_t) -1)
 
 static void
 destroy_map_node_value_no_op(void *value) {
 	// no op
 }
 
-//////////////////////////////////////////////////////////////////////////////
-// prom_map_node
-//////////////////////////////////////////////////////////////////////////////
-
-prom_map_node_t *
-prom_map_node_new(const char *key, void *value,
-	prom_map_node_free_value_fn free_value_fn)
-{
-	prom_map_node_t *self = prom_malloc(sizeof(prom_map_node_t));
-	if (self == NULL)
-		return NULL;
-	self->key = prom_strdup(key);
-	self->value = value;
-	self->free_value_fn = free_value_fn;
-	return self;
-}
-
-int
-prom_map_node_destroy(prom_map_node_t *self) {
-	if (self == NULL)
-		return 0;
-	prom_free((void *)self->key);
-	self->key = NULL;
-	if (self->value != NULL)
-		(*self->free_value_fn)(self->value);
-	self->value = NULL;
-	prom_free(self);
-	return 0;
-}
-
-void
-prom_map_node_free(void *item) {
-	prom_map_node_destroy((prom_map_node_t *) item);
+/**
+ * @brief PRIVATE 64-bit hash of the given key.
+ *
+ * This is MurmurHash64A by Austin Appleby (public domain). It consumes 8
+ * bytes per round, which is considerable faster than a per character hash
+ * for the typical l_value sized keys, and disperses well even for keys,
+ * which differ in a single character only.
+ */
+uint64_t
+prom_map_hash(const char *key, size_t len) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	const unsigned char *data = (const unsigned char *) key;
+	const unsigned char *end = data + (len & ~((size_t) 7));
+	uint64_t h = 0x9747b28cULL ^ (len * m);
+
+	for (; data != end; data += 8) {
+		uint64_t k;
+		memcpy(&k, data, sizeof(k));
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+	switch (len & 7) {
+		case 7: h ^= (uint64_t) data[6] << 48;	/* fall through */
+		case 6: h ^= (uint64_t) data[5] << 40;	/* fall through */
+		case 5: h ^= (uint64_t) data[4] << 32;	/* fall through */
+		case 4: h ^= (uint64_t) data[3] << 24;	/* fall through */
+		case 3: h ^= (uint64_t) data[2] << 16;	/* fall through */
+		case 2: h ^= (uint64_t) data[1] << 8;	/* fall through */
+		case 1: h ^= (uint64_t) data[0];
+			h *= m;
+	}
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
 }
 
-pll_compare_t
-prom_map_node_compare(void *item_a, void *item_b) {
-	prom_map_node_t *a = (prom_map_node_t *) item_a;
-	prom_map_node_t *b = (prom_map_node_t *) item_b;
-	if (a == b)
-		return 0;
-	if (a == NULL)
-		return -1;
-	if (b == NULL)
-		return 1;
+uint64_t
+prom_map_hash_strings(const char **strs, size_t count) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	uint64_t h = count * m;
 
-	if (a->key == b->key)
-		return 0;
-	if (a->key == NULL)
-		return -1;
-	if (b ->key == NULL)
-		return 1;
-	return strcmp(a->key, b->key);
+	// prom_map_hash() seeds with the length, so {"ab","c"} != {"a","bc"}
+	for (size_t i = 0; i < count; i++) {
+		h ^= prom_map_hash(strs[i], strlen(strs[i]));
+		h *= m;
+		h ^= h >> 47;
+	}
+	return h;
 }
 
 //////////////////////////////////////////////////////////////////////////////
 // prom_map
 //////////////////////////////////////////////////////////////////////////////
 
+static void
+free_generic(void *ptr) {
+	prom_free(ptr);
+}
+
+/**
+ * @brief PRIVATE Get the entry with the given index.
+ */
+static inline prom_map_node_t *
+prom_map_node(prom_map_t *self, size_t idx) {
+	// segment n starts at index (2^n - 1) * PROM_MAP_SEGMENT_SIZE
+	size_t v = idx / PROM_MAP_SEGMENT_SIZE + 1;
+	unsigned int n = (sizeof(long long) * 8 - 1) - __builtin_clzll(v);
+	return &self->segment[n][idx - ((1UL << n) - 1) * PROM_MAP_SEGMENT_SIZE];
+}
+
+/**
+ * @brief PRIVATE Allocate a new, empty table with the given number of slots.
+ */
+static prom_map_table_t *
+prom_map_table_new(size_t max_size) {
+	// Large blocks get mmap()ed, so zeroing costs nothing here.
+	prom_map_table_t *t = (prom_map_table_t *) prom_calloc(1,
+		sizeof(prom_map_table_t) + sizeof(prom_map_slot_t) * max_size);
+	if (t == NULL)
+		return NULL;
+	t->max_size = max_size;
+	atomic_init(&t->prev, NULL);
+	return t;
+}
+
 prom_map_t *
 prom_map_new() {
 	prom_map_t *self = (prom_map_t *) prom_malloc(sizeof(prom_map_t));
 	if (self == NULL)
 		return NULL;
+	memset(self, 0, sizeof(prom_map_t));
 
-	self->size = 0;
 	self->max_size = PROM_MAP_INITIAL_SIZE;
 	self->free_value_fn = destroy_map_node_value_no_op;
-	self->addrs = NULL;
-	self->rwlock = NULL;
-
-	self->keys = pll_new();
-	if (self->keys == NULL) {
-		prom_free(self);
-		return NULL;
-	}
-
-	// These each key will be allocated once by prom_map_node_new and used here
-	// as well to save memory. With that said we will only have to deallocate
-	// each key once. That will happen on prom_map_node_destroy.
-	if (pll_set_free_fn(self->keys, pll_no_op_free))
-		goto fail;
-
-	self->addrs = prom_malloc(sizeof(pll_t) * self->max_size);
-	if (self->addrs == NULL)
+	atomic_init(&self->node_count, 0);
+	atomic_init(&self->table, prom_map_table_new(self->max_size));
+	if (atomic_load(&self->table) == NULL)
 		goto fail;
 
-	for (int i = 0; i < self->max_size; i++) {
-		self->addrs[i] = pll_new();
-		if (pll_set_free_fn(self->addrs[i], prom_map_node_free))
-			goto fail;
-		if (pll_set_compare_fn(self->addrs[i], prom_map_node_compare))
-			goto fail;
-	}
-
 	self->rwlock = (pthread_rwlock_t *) prom_malloc(sizeof(pthread_rwlock_t));
 	if (self->rwlock == NULL)
 		goto fail;
 	if (pthread_rwlock_init(self->rwlock, NULL)) {
 		PROM_WARN(PROM_PTHREAD_RWLOCK_INIT_ERROR, NULL);
+		prom_free(self->rwlock);
+		self->rwlock = NULL;
 		goto fail;
 	}
 
@@ -152,282 +166,436 @@ prom_map_destroy(prom_map_t *self) {
 	if (self == NULL)
 		return 0;
 
-	pll_destroy(self->keys);
-	self->keys = NULL;
-	for (size_t i = 0; i < self->max_size; i++) {
-		pll_destroy(self->addrs[i]);
-		self->addrs[i] = NULL;
+	size_t count = atomic_load(&self->node_count);
+	for (size_t i = 0; i < count; i++) {
+		prom_map_node_t *node = prom_map_node(self, i);
+		const char *key = atomic_load_explicit(&node->key,
+			memory_order_relaxed);
+		if (key == NULL)
+			continue;
+		if (!self->borrow_keys)
+			prom_free((char *) key);
+		void *value = atomic_load_explicit(&node->value, memory_order_relaxed);
+		if (value != NULL)
+			self->free_value_fn(value);
+	}
+	for (unsigned int i = 0; i < self->segment_count; i++) {
+		prom_free(self->segment[i]);
+		self->segment[i] = NULL;
+	}
+	prom_map_table_t *t = atomic_load(&self->table);
+	if (t != NULL) {
+		prom_free(atomic_load(&t->prev));
+		prom_free(t);
+	}
+	if (self->rwlock != NULL) {
+		pthread_rwlock_destroy(self->rwlock);
+		prom_free(self->rwlock);
+		self->rwlock = NULL;
 	}
-	prom_free(self->addrs);
-	self->addrs = NULL;
-	pthread_rwlock_destroy(self->rwlock);
-	prom_free(self->rwlock);
-	self->rwlock = NULL;
 	prom_free(self);
+	// the chance to free what got retired by this map
+	prom_epoch_reclaim();
 	return 0;
 }
 
-static size_t
-prom_map_get_index_internal(const char *key, size_t *size, size_t *max_size) {
-	PROM_ASSERT(key != NULL);
-	size_t index;
-	size_t a = 31415, b = 27183;
-	for (index = 0; *key != '\0'; key++, a = a * b % (*max_size - 1)) {
-		index = (a * index + *key) % *max_size;
+/**
+ * @brief PRIVATE Check, whether the given entry is the one looked up.
+ * @param key	The key to compare, if \c match is \c NULL.
+ * @param match	If not \c NULL, the function to compare the entry's value.
+ */
+static inline bool
+prom_map_node_matches(prom_map_node_t *node, const char *key,
+	prom_map_match_fn *match, const void *arg)
+{
+	if (match == NULL) {
+		const char *k = atomic_load_explicit(&node->key, memory_order_acquire);
+		return k != NULL && strcmp(k, key) == 0;
 	}
-	return index;
+	void *value = atomic_load_explicit(&node->value, memory_order_acquire);
+	return value != NULL && match(value, arg);
 }
 
 /**
- * @brief PRIVATE hash function that returns an array index from the given
- *	key and prom_map.
- *
- * The algorithm is based off of Horner's method. In a simpler version, you set
- * the return value to 0. Next, for each character in the string, you add the
- * integer value of the current character to the product of the prime number and
- * the current return value, set the result to the return value, then finally
- * return the return value.
- *
- * In this version of the algorithm, we attempt to achieve a probabily of key
- * to index conversion collisions to 1/M (with M being the max_size of the map).
- * This optimizes dispersion and consequently, evens out the performance for
- * gets and sets for each item. Instead of using a fixed prime number, we
- * generate a coefficient for each iteration through the loop.
- *
- * Reference:
- *   * Algorithms in C: Third Edition by Robert Sedgewick, p579
+ * @brief PRIVATE Get the position of the slot in the given table referencing
+ *	the entry looked up (see prom_map_node_matches()). Safe to use without
+ *	holding the lock.
+ * @return \c PROM_MAP_NOT_FOUND if there is no such entry.
  */
-size_t
-prom_map_get_index(prom_map_t *self, const char *key) {
-  return prom_map_get_index_internal(key, &self->size, &self->max_size);
-}
-
-static void *
-prom_map_get_internal(const char *key, size_t *size, size_t *max_size,
-	pll_t *keys, pll_t **addrs, prom_map_node_free_value_fn free_value_fn)
+static size_t
+prom_map_find(prom_map_t *self, prom_map_table_t *t, uint64_t hash,
+	const char *key, prom_map_match_fn *match, const void *arg)
 {
-	if (key == NULL)
-		return NULL;
-
-	size_t index = prom_map_get_index_internal(key, size, max_size);
-	pll_t *list = addrs[index];
-	prom_map_node_t *temp_map_node = prom_map_node_new(key, NULL,free_value_fn);
-
-	for (pll_node_t *current_node = list->head;
-		current_node != NULL; current_node = current_node->next)
-	{
-		prom_map_node_t *current_map_node = (prom_map_node_t *)
-			current_node->item;
-		pll_compare_t result =
-			pll_compare(list, current_map_node, temp_map_node);
-		if (result == PROM_EQUAL) {
-			prom_map_node_destroy(temp_map_node);
-			temp_map_node = NULL;
-			return current_map_node->value;
+	size_t mask = t->max_size - 1;
+	size_t pos = hash & mask;
+
+	// The load factor is <= 0.5, so there is always an empty slot.
+	for (;; pos = (pos + 1) & mask) {
+		prom_map_slot_t *slot = &t->slots[pos];
+		uint32_t n = atomic_load_explicit(&slot->node, memory_order_acquire);
+		if (n == 0)
+			return PROM_MAP_NOT_FOUND;
+		if (n == PROM_MAP_SLOT_DELETED
+			|| atomic_load_explicit(&slot->hash, memory_order_relaxed) != hash)
+		{
+			continue;
 		}
+		if (prom_map_node_matches(prom_map_node(self, n - 1), key, match, arg))
+			return pos;
 	}
-	prom_map_node_destroy(temp_map_node);
-	return NULL;
 }
 
-void *
-prom_map_get(prom_map_t *self, const char *key) {
-	if (key == NULL)
-		return NULL;
-
-	if (pthread_rwlock_wrlock(self->rwlock)) {
-		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+/**
+ * @brief PRIVATE Get the entry looked up (see prom_map_find()). Checks the current table
+ *	first and the one being migrated second. Safe to use without holding the
+ *	lock, but in this case the caller must be within an epoch.
+ * @param pos	If not \c NULL, where to store the position of the slot in the
+ *	current table or \c PROM_MAP_NOT_FOUND if it is not (yet) in there.
+ * @return \c NULL if there is no such entry.
+ */
+static prom_map_node_t *
+prom_map_lookup(prom_map_t *self, uint64_t hash, const char *key,
+	prom_map_match_fn *match, const void *arg, size_t *pos)
+{
+	prom_map_table_t *t = atomic_load_explicit(&self->table,
+		memory_order_acquire);
+	// Load prev before searching: if it is NULL, all slots got migrated.
+	prom_map_table_t *prev = atomic_load_explicit(&t->prev,
+		memory_order_acquire);
+
+	size_t p = prom_map_find(self, t, hash, key, match, arg);
+	if (pos != NULL)
+		*pos = p;
+	if (p != PROM_MAP_NOT_FOUND)
+		return prom_map_node(self, atomic_load_explicit(&t->slots[p].node,
+			memory_order_relaxed) - 1);
+	if (prev == NULL)
 		return NULL;
-	}
-
-	void *value = prom_map_get_internal(key, &self->size, &self->max_size,
-		self->keys, self->addrs, self->free_value_fn);
+	p = prom_map_find(self, prev, hash, key, match, arg);
+	return (p == PROM_MAP_NOT_FOUND)
+		? NULL
+		: prom_map_node(self, atomic_load_explicit(&prev->slots[p].node,
+			memory_order_relaxed) - 1);
+}
 
-	if (pthread_rwlock_unlock(self->rwlock))
-		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+/**
+ * @brief PRIVATE Insert the given slot into the given table: the first empty
+ *	slot of the probe sequence gets filled. Existing slots never move.
+ */
+static void
+prom_map_insert_slot(prom_map_table_t *t, uint64_t hash, uint32_t node) {
+	size_t mask = t->max_size - 1;
+	size_t pos = hash & mask;
+
+	while (atomic_load_explicit(&t->slots[pos].node, memory_order_relaxed) != 0)
+		pos = (pos + 1) & mask;
+	atomic_store_explicit(&t->slots[pos].hash, hash, memory_order_relaxed);
+	atomic_store_explicit(&t->slots[pos].node, node, memory_order_release);
+}
 
-	return value;
+/**
+ * @brief PRIVATE Migrate up to the given number of slots from the previous
+ *	to the current table. Old slots are left as they are, so lookups still
+ *	work.
+ */
+static void
+prom_map_migrate(prom_map_t *self, size_t count) {
+	prom_map_table_t *t = atomic_load_explicit(&self->table,
+		memory_order_relaxed);
+	prom_map_table_t *prev = atomic_load_explicit(&t->prev,
+		memory_order_relaxed);
+	if (prev == NULL)
+		return;
+
+	size_t end = self->migrated + count;
+	if (end > prev->max_size)
+		end = prev->max_size;
+	self->moved += end - self->migrated;
+	for (; self->migrated < end; self->migrated++) {
+		prom_map_slot_t *slot = &prev->slots[self->migrated];
+		uint32_t n = atomic_load_explicit(&slot->node, memory_order_relaxed);
+		if (n != 0 && n != PROM_MAP_SLOT_DELETED)
+			prom_map_insert_slot(t,
+				atomic_load_explicit(&slot->hash, memory_order_relaxed), n);
+	}
+	if (self->migrated == prev->max_size) {
+		atomic_store_explicit(&t->prev, NULL, memory_order_release);
+		self->migrated = 0;
+		if (prom_epoch_retire(prev, free_generic))
+			PROM_WARN("Unable to retire old map table - leaking it.", NULL);
+	}
 }
 
+/**
+ * @brief PRIVATE Allocate the next segment of entries.
+ */
 static int
-prom_map_set_internal(const char *key, void *value, size_t *size,
-	size_t *max_size, pll_t *keys, pll_t **addrs,
-	prom_map_node_free_value_fn free_value_fn, bool destroy_current_value)
-{
-	prom_map_node_t *map_node = prom_map_node_new(key, value, free_value_fn);
-	if (map_node == NULL)
+prom_map_add_segment(prom_map_t *self) {
+	unsigned int n = self->segment_count;
+	if (n == PROM_MAP_SEGMENTS)
 		return 1;
+	self->segment[n] = (prom_map_node_t *)
+		prom_malloc(sizeof(prom_map_node_t) * (PROM_MAP_SEGMENT_SIZE << n));
+	if (self->segment[n] == NULL)
+		return 2;
+	self->node_max += PROM_MAP_SEGMENT_SIZE << n;
+	self->segment_count++;
+	return 0;
+}
 
-	size_t index = prom_map_get_index_internal(key, size, max_size);
-	pll_t *list = addrs[index];
-	for (pll_node_t *current_node = list->head;
-		current_node != NULL; current_node = current_node->next)
-	{
-		prom_map_node_t *current_map_node = (prom_map_node_t *)
-			current_node->item;
-		pll_compare_t result =
-			pll_compare(list, current_map_node, map_node);
-		if (result != PROM_EQUAL)
-			continue;
+/**
+ * @brief PRIVATE Make sure, that there is space for another entry.
+ */
+static int
+prom_map_ensure_space(prom_map_t *self) {
+	PROM_ASSERT(self != NULL);
 
-		if (destroy_current_value) {
-			free_value_fn(current_map_node->value);
-			current_map_node->value = NULL;
-		}
-		prom_free((char *) current_map_node->key);
-		current_map_node->key = NULL;
-		prom_free(current_map_node);
-		current_map_node = NULL;
-		current_node->item = map_node;
+	// Keep the load factor <= 0.5 to have short probe sequences. If the
+	// table is mostly filled with tombstones, rehashing is sufficient.
+	if (self->used > self->max_size >> 1) {
+		prom_map_table_t *t = atomic_load_explicit(&self->table,
+			memory_order_relaxed);
+		// Usually done long before - at least 2 slots get migrated per insert.
+		prom_map_table_t *prev = atomic_load_explicit(&t->prev,
+			memory_order_relaxed);
+		if (prev != NULL)
+			prom_map_migrate(self, prev->max_size);
+		size_t max_size = (self->size > self->max_size >> 2)
+			? self->max_size << 1 : self->max_size;
+		prom_map_table_t *n = prom_map_table_new(max_size);
+		if (n == NULL)
+			return 1;
+		atomic_init(&n->prev, t);
+		self->migrated = 0;
+		self->max_size = max_size;
+		self->used = self->size;
+		self->resizes++;
+		atomic_store_explicit(&self->table, n, memory_order_release);
+	}
+	if (atomic_load_explicit(&self->node_count, memory_order_relaxed)
+		< self->node_max)
+	{
 		return 0;
 	}
-	pll_append(list, map_node);
-	pll_append(keys, (char *) map_node->key);
-	(*size)++;
-	return 0;
+	return prom_map_add_segment(self) ? 3 : 0;
 }
 
 int
-prom_map_ensure_space(prom_map_t *self) {
+prom_map_reserve(prom_map_t *self, size_t count) {
 	PROM_ASSERT(self != NULL);
+	if (pthread_rwlock_wrlock(self->rwlock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return 1;
+	}
 
-	if (self->size <= self->max_size >> 1)
-		return 0;
+	int err = 0;
+	size_t max_size = self->max_size;
+	while (max_size >> 1 < count)
+		max_size <<= 1;
+	if (max_size > self->max_size) {
+		// Same as prom_map_ensure_space(), but migrate all at once.
+		prom_map_table_t *t = atomic_load_explicit(&self->table,
+			memory_order_relaxed);
+		prom_map_table_t *prev = atomic_load_explicit(&t->prev,
+			memory_order_relaxed);
+		if (prev != NULL)
+			prom_map_migrate(self, prev->max_size);
+		prom_map_table_t *n = prom_map_table_new(max_size);
+		if (n == NULL) {
+			err = 2;
+			goto end;
+		}
+		atomic_init(&n->prev, t);
+		self->migrated = 0;
+		self->max_size = max_size;
+		self->used = self->size;
+		self->resizes++;
+		atomic_store_explicit(&self->table, n, memory_order_release);
+		prom_map_migrate(self, t->max_size);
+	}
+	while (self->node_max < count) {
+		if (prom_map_add_segment(self)) {
+			err = 3;
+			break;
+		}
+	}
 
-	// Increase the max size
-	size_t new_max = self->max_size << 1;
-	size_t new_size = 0;
+end:
+	if (pthread_rwlock_unlock(self->rwlock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return err;
+}
 
-	// Create a new list of keys
-	pll_t *new_keys = pll_new();
-	if (new_keys == NULL)
+int
+prom_map_borrow_keys(prom_map_t *self) {
+	PROM_ASSERT(self != NULL);
+	if (atomic_load(&self->node_count) > 0)
 		return 1;
+	self->borrow_keys = true;
+	return 0;
+}
 
-	if (pll_set_free_fn(new_keys, pll_no_op_free))
-		return 2;
+/**
+ * @brief PRIVATE Get the value of the entry looked up without locking.
+ */
+static void *
+prom_map_get_internal(prom_map_t *self, uint64_t hash, const char *key,
+	prom_map_match_fn *match, const void *arg)
+{
+	prom_epoch_enter();
+	prom_map_node_t *node = prom_map_lookup(self, hash, key, match, arg, NULL);
+	void *value = (node == NULL)
+		? NULL
+		: atomic_load_explicit(&node->value, memory_order_acquire);
+	prom_epoch_exit();
+	return value;
+}
 
-	// Create a new array of addrs
-	pll_t **new_addrs =
-		prom_malloc(sizeof(pll_t) * new_max);
-
-	// Initialize the new array
-	for (int i = 0; i < new_max; i++) {
-		new_addrs[i] = pll_new();
-		if (pll_set_free_fn(new_addrs[i], prom_map_node_free))
-			return 3;
-		if (pll_set_compare_fn(new_addrs[i],prom_map_node_compare))
-			return 4;
-	}
+void *
+prom_map_get(prom_map_t *self, const char *key) {
+	if (key == NULL)
+		return NULL;
+	return prom_map_get_internal(self, prom_map_hash(key, strlen(key)), key,
+		NULL, NULL);
+}
 
-	// Iterate through each linked-list at each memory region in the map's
-	// backbone
-	for (int i = 0; i < self->max_size; i++) {
-		// Create a new map node for each node in the linked list and insert it
-		// into the new map. Afterwards, deallocate the old map node
-		pll_t *list = self->addrs[i];
-		pll_node_t *current_node = list->head;
-		while (current_node != NULL) {
-			prom_map_node_t *map_node = (prom_map_node_t *) current_node->item;
-			if (prom_map_set_internal(map_node->key, map_node->value,
-				&new_size, &new_max, new_keys, new_addrs, self->free_value_fn,
-				false))
-			{
-				return 5;
-			}
-			pll_node_t *next = current_node->next;
-			prom_free(current_node);
-			current_node = NULL;
-			prom_free((void *) map_node->key);
-			map_node->key = NULL;
-			prom_free(map_node);
-			map_node = NULL;
-			current_node = next;
+void *
+prom_map_get_hashed(prom_map_t *self, uint64_t hash, prom_map_match_fn *match,
+	const void *arg)
+{
+	if (self == NULL || match == NULL)
+		return NULL;
+	return prom_map_get_internal(self, hash, NULL, match, arg);
+}
+
+/**
+ * @brief PRIVATE Set the value of the entry with the given key or the one
+ *	matched by the given function, or add a new one.
+ */
+static int
+prom_map_set_internal(prom_map_t *self, uint64_t hash, const char *key,
+	prom_map_match_fn *match, const void *arg, void *value)
+{
+	prom_map_node_t *node = prom_map_lookup(self, hash, key, match, arg, NULL);
+	if (node != NULL) {
+		void *old = atomic_exchange(&node->value, value);
+		if (old != NULL && old != value
+			&& prom_epoch_retire(old, self->free_value_fn))
+		{
+			PROM_WARN("Unable to retire the old value of '%s'.", key);
 		}
-		// We're done deallocating each map node in the linked list, so
-		// deallocate the linked-list object
-		prom_free(self->addrs[i]);
-		self->addrs[i] = NULL;
+		return 0;
 	}
-	// Destroy the collection of keys in the map
-	pll_destroy(self->keys);
-	self->keys = NULL;
-
-	// Deallocate the backbone of the map
-	prom_free(self->addrs);
-	self->addrs = NULL;
-
-	// Update the members of the current map
-	self->size = new_size;
-	self->max_size = new_max;
-	self->keys = new_keys;
-	self->addrs = new_addrs;
+
+	if (prom_map_ensure_space(self))
+		return 1;
+	size_t idx = atomic_load_explicit(&self->node_count, memory_order_relaxed);
+	node = prom_map_node(self, idx);
+	const char *k = self->borrow_keys ? key : prom_strdup(key);
+	if (k == NULL)
+		return 2;
+	atomic_init(&node->key, k);
+	atomic_init(&node->value, value);
+	node->hash = hash;
+	// Publish the entry for iterators first, then for lookups.
+	atomic_store_explicit(&self->node_count, idx + 1, memory_order_release);
+	prom_map_insert_slot(atomic_load_explicit(&self->table,
+		memory_order_relaxed), hash, idx + 1);
+	self->used++;
+	self->size++;
 	return 0;
 }
 
-int
-prom_map_set(prom_map_t *self, const char *key, void *value) {
-	PROM_ASSERT(self != NULL);
+/**
+ * @brief PRIVATE Lock the given map and call prom_map_set_internal().
+ */
+static int
+prom_map_set_locked(prom_map_t *self, uint64_t hash, const char *key,
+	prom_map_match_fn *match, const void *arg, void *value)
+{
 	if (pthread_rwlock_wrlock(self->rwlock)) {
 		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
 		return 1;
 	}
 
-	if (prom_map_ensure_space(self)) {
-		if (pthread_rwlock_unlock(self->rwlock))
-			PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
-		return 2;
-	}
-	if (prom_map_set_internal(key, value, &self->size, &self->max_size,
-		self->keys, self->addrs, self->free_value_fn, true))
-	{
-		if (pthread_rwlock_unlock(self->rwlock))
-			PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
-		return 3;
-	}
+	self->moved = 0;
+	prom_map_migrate(self, PROM_MAP_MIGRATE_STEP);
+	int err = prom_map_set_internal(self, hash, key, match, arg, value)
+		? 3 : 0;
+	if (self->moved > self->moved_max)
+		self->moved_max = self->moved;
+
 	if (pthread_rwlock_unlock(self->rwlock))
 		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
-	return 0;
+	return err;
 }
 
-static int
-prom_map_delete_internal(const char *key, size_t *size, size_t *max_size,
-	pll_t *keys, pll_t **addrs, prom_map_node_free_value_fn free_value_fn)
-{
-	PROM_ASSERT(key != NULL);
-	size_t index = prom_map_get_index_internal(key, size, max_size);
-	pll_t *list = addrs[index];
-	prom_map_node_t *temp_map_node =
-		prom_map_node_new(key, NULL, free_value_fn);
+int
+prom_map_set(prom_map_t *self, const char *key, void *value) {
+	PROM_ASSERT(self != NULL);
+	if (key == NULL)
+		return 4;
+	return prom_map_set_locked(self, prom_map_hash(key, strlen(key)), key,
+		NULL, NULL, value);
+}
 
-	for (pll_node_t *current_node = list->head;
-		current_node != NULL; current_node = current_node->next)
-	{
-		prom_map_node_t *current_map_node = (prom_map_node_t *)
-			current_node->item;
-		pll_compare_t result =
-			pll_compare(list, current_map_node, temp_map_node);
-		if (result != PROM_EQUAL)
-			continue;
+int
+prom_map_set_hashed(prom_map_t *self, uint64_t hash, prom_map_match_fn *match,
+	const void *arg, const char *key, void *value)
+{
+	PROM_ASSERT(self != NULL);
+	if (key == NULL || match == NULL)
+		return 4;
+	return prom_map_set_locked(self, hash, key, match, arg, value);
+}
 
-		if (pll_remove(list, current_node))
-			return 1;
-		if (pll_remove(keys, (char *)current_map_node->key))
-			return 2;
-		(*size)--;
-		break;
+static void
+prom_map_delete_internal(prom_map_t *self, const char *key) {
+	PROM_ASSERT(key != NULL);
+	uint64_t hash = prom_map_hash(key, strlen(key));
+	size_t pos;
+	prom_map_node_t *node = prom_map_lookup(self, hash, key, NULL, NULL,
+		&pos);
+	if (node == NULL)
+		return;
+
+	// Slots must not move, so leave tombstones in both tables.
+	prom_map_table_t *t = atomic_load_explicit(&self->table,
+		memory_order_relaxed);
+	if (pos != PROM_MAP_NOT_FOUND)
+		atomic_store(&t->slots[pos].node, PROM_MAP_SLOT_DELETED);
+	prom_map_table_t *prev = atomic_load_explicit(&t->prev,
+		memory_order_relaxed);
+	if (prev != NULL) {
+		pos = prom_map_find(self, prev, hash, key, NULL, NULL);
+		if (pos != PROM_MAP_NOT_FOUND)
+			atomic_store(&prev->slots[pos].node, PROM_MAP_SLOT_DELETED);
 	}
-	return prom_map_node_destroy(temp_map_node);
+
+	// Lock-free readers may still use the key and value.
+	const char *k = atomic_exchange(&node->key, NULL);
+	if (!self->borrow_keys && prom_epoch_retire((void *) k, free_generic))
+		PROM_WARN("Unable to retire key '%s' - leaking it.", k);
+	void *value = atomic_exchange(&node->value, NULL);
+	if (value != NULL && prom_epoch_retire(value, self->free_value_fn))
+		PROM_WARN("Unable to retire the value of '%s' - leaking it.", key);
+	self->size--;
 }
 
 int
 prom_map_delete(prom_map_t *self, const char *key) {
 	PROM_ASSERT(self != NULL);
+	if (key == NULL)
+		return 0;
 	if (pthread_rwlock_wrlock(self->rwlock)) {
 		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
 		return 1;
 	}
-	prom_map_delete_internal(key, &self->size, &self->max_size, self->keys,
-		self->addrs, self->free_value_fn);
+	self->moved = 0;
+	prom_map_migrate(self, PROM_MAP_MIGRATE_STEP);
+	prom_map_delete_internal(self, key);
+	if (self->moved > self->moved_max)
+		self->moved_max = self->moved;
 	if (pthread_rwlock_unlock(self->rwlock))
 		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
 	return 0;
@@ -447,3 +615,34 @@ prom_map_size(prom_map_t *self) {
 	PROM_ASSERT(self != NULL);
 	return self->size;
 }
+
+void
+prom_map_iter_init(prom_map_iter_t *iter, prom_map_t *map) {
+	PROM_ASSERT(iter != NULL);
+	iter->map = map;
+	iter->pos = 0;
+	iter->key = NULL;
+	iter->value = NULL;
+}
+
+bool
+prom_map_iter_next(prom_map_iter_t *iter) {
+	prom_map_t *map = iter->map;
+	if (map == NULL)
+		return false;
+	size_t count = atomic_load_explicit(&map->node_count, memory_order_acquire);
+	while (iter->pos < count) {
+		prom_map_node_t *node = prom_map_node(map, iter->pos++);
+		const char *key = atomic_load_explicit(&node->key,
+			memory_order_acquire);
+		if (key != NULL) {
+			iter->key = key;
+			iter->value = atomic_load_explicit(&node->value,
+				memory_order_acquire);
+			return true;
+		}
+	}
+	iter->key = NULL;
+	iter->value = NULL;
+	return false;
+}
@@ -17,6 +17,8 @@
 #ifndef PROM_MAP_I_INCLUDED
 #define PROM_MAP_I_INCLUDED
 
+#include <stdbool.h>
+
 #include "prom_map_t.h"
 
 prom_map_t *prom_map_new(void);
@@ -27,12 +29,65 @@ void *prom_map_get(prom_map_t *self, const char *key);
 
 int prom_map_set(prom_map_t *self, const char *key, void *value);
 
+/**
+ * @brief PRIVATE Get the value of the entry with the given hash, which
+ *	gets accepted by the given match function. Lets callers use their own
+ *	fingerprint instead of hashing a rendered key. Does not lock.
+ * @return \c NULL if there is no such entry.
+ */
+void *prom_map_get_hashed(prom_map_t *self, uint64_t hash, prom_map_match_fn *match, const void *arg);
+
+/**
+ * @brief PRIVATE Set the value of the entry with the given hash, which gets
+ *	accepted by the given match function, or add a new entry with the given
+ *	key. Entries added this way can only be found via prom_map_get_hashed().
+ * @return A non-zero value on error, \c 0 otherwise.
+ */
+int prom_map_set_hashed(prom_map_t *self, uint64_t hash, prom_map_match_fn *match, const void *arg, const char *key, void *value);
+
 int prom_map_delete(prom_map_t *self, const char *key);
 
 int prom_map_destroy(prom_map_t *self);
 
 size_t prom_map_size(prom_map_t *self);
 
-prom_map_node_t *prom_map_node_new(const char *key, void *value, prom_map_node_free_value_fn free_value_fn);
+/**
+ * @brief PRIVATE Allocate everything needed to hold the given number of
+ *	entries, so that adding entries up to this number doesn't allocate
+ *	anything except copies of the keys.
+ * @return A non-zero value on error, \c 0 otherwise.
+ */
+int prom_map_reserve(prom_map_t *self, size_t count);
+
+/**
+ * @brief PRIVATE Use the keys of added entries as they are instead of
+ *	copies. So they need to live as long as the map. Only
+ *	possible as long as the map is empty.
+ * @return A non-zero value on error, \c 0 otherwise.
+ */
+int prom_map_borrow_keys(prom_map_t *self);
+
+/**
+ * @brief PRIVATE Get the 64-bit hash of the given key with the given length.
+ */
+uint64_t prom_map_hash(const char *key, size_t len);
+
+/**
+ * @brief PRIVATE Get the 64-bit hash of the given array of strings. The
+ *	result depends on the order of the strings and where each one ends.
+ */
+uint64_t prom_map_hash_strings(const char **strs, size_t count);
+
+/**
+ * @brief PRIVATE Prepare the given iterator to iterate over all entries of
+ *	the given map.
+ */
+void prom_map_iter_init(prom_map_iter_t *iter, prom_map_t *map);
+
+/**
+ * @brief PRIVATE Advance the given iterator to the next entry.
+ * @return \c false if there are no more entries, \c true otherwise.
+ */
+bool prom_map_iter_next(prom_map_iter_t *iter);
 
 #endif  // PROM_MAP_I_INCLUDED
@@ -19,28 +19,110 @@
 #define PROM_MAP_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 // Public
 #include "prom_map.h"
 
-// Private
-#include "prom_linked_list_t.h"
+/**
+ * @brief Entries are stored in segments, which never move. Segment \c n has
+ * room for \c PROM_MAP_SEGMENT_SIZE << n entries.
+ */
+#define PROM_MAP_SEGMENT_SIZE 16
+#define PROM_MAP_SEGMENTS 28
+
+/**
+ * @brief Number of old slots to migrate per modification while growing. Must
+ * be >= 2 to finish before the next resize.
+ */
+#define PROM_MAP_MIGRATE_STEP 16
+
+/**
+ * @brief Marks a slot, whose entry got deleted (tombstone).
+ */
+#define PROM_MAP_SLOT_DELETED UINT32_MAX
 
 typedef void (*prom_map_node_free_value_fn) (void *);
 
+/**
+ * @brief Check, whether the given value is the one looked up via
+ *	prom_map_get_hashed().
+ * @param arg	The argument passed to prom_map_get_hashed().
+ */
+typedef bool prom_map_match_fn(const void *value, const void *arg);
+
+/**
+ * @brief An entry of the map. Entries are stored in insertion order, deleted
+ * entries have a \c NULL key. Entries never move, so lock-free readers can
+ * use them as long as they are within an epoch (see prom_epoch_i.h).
+ */
 struct prom_map_node {
-	const char *key;
-	void *value;
-	prom_map_node_free_value_fn free_value_fn;
+	const char *_Atomic key;
+	void *_Atomic value;
+	uint64_t hash;		/**< cached prom_map_hash() of the key */
 };
 
+/**
+ * @brief A slot of the open addressing table. It caches the hash of the key,
+ * so that probing needs to look at the entry only if the hashes are equal.
+ * A slot gets filled once (hash first, node last), and may become a
+ * tombstone later, but it never moves. So lock-free readers never miss an
+ * existing entry.
+ */
+typedef struct prom_map_slot {
+	_Atomic uint64_t hash;	/**< hash of the key of the referenced entry */
+	_Atomic uint32_t node;	/**< index of the entry + 1, \c 0 if empty */
+} prom_map_slot_t;
+
+/**
+ * @brief A table of slots. When the map needs to grow, a new table gets
+ * published, which references the old one as \c prev. The slots of the old
+ * table get migrated a few per modification, so that no single insert has
+ * to pay for the whole resize. Until the migration is done, lookups check
+ * both tables. Afterwards \c prev gets cleared and the old table retired.
+ */
+typedef struct prom_map_table {
+	size_t max_size;	/**< number of slots, always a power of 2 */
+	struct prom_map_table *_Atomic prev;	/**< table being migrated */
+	prom_map_slot_t slots[];
+} prom_map_table_t;
+
+/**
+ * @brief Lookups (prom_map_get()) are lock-free, modifications are
+ * serialized by the rwlock. Deleted keys, values and replaced tables get
+ * freed via prom_epoch_retire().
+ */
 struct prom_map {
 	size_t size;		/**< contains the size of the map */
-	size_t max_size;	/**< stores the current max_size */
-	pll_t *keys;		/**< linked list containing all keys present */
-	pll_t **addrs;		/**< Sequence of linked lists. Each list contains nodes with the same index */
+	size_t max_size;	/**< number of slots of the current table */
+	size_t used;		/**< slots used in the current table incl. tombstones */
+	prom_map_table_t *_Atomic table;	/**< the current table */
+	size_t migrated;	/**< number of slots of table->prev migrated so far */
+	prom_map_node_t *segment[PROM_MAP_SEGMENTS];	/**< the entries */
+	unsigned int segment_count;	/**< number of allocated segments */
+	_Atomic size_t node_count;	/**< number of entries incl. deleted ones */
+	size_t node_max;	/**< number of allocated entries */
 	pthread_rwlock_t *rwlock;
 	prom_map_node_free_value_fn free_value_fn;
+	bool borrow_keys;	/**< keys are neither copied nor freed */
+	size_t resizes;		/**< number of tables replaced by a new one */
+	size_t moved;		/**< slots migrated by the current modification */
+	/** Most slots migrated by a single prom_map_set() or prom_map_delete(). */
+	size_t moved_max;
 };
 
+/**
+ * @brief Iterator over all entries of a map in insertion order. Use
+ *	prom_map_iter_init() to initialize and prom_map_iter_next() to advance it.
+ * Entries added while iterating may or may not be visited.
+ */
+typedef struct prom_map_iter {
+	prom_map_t *map;
+	size_t pos;
+	const char *key;	/**< the key of the current entry */
+	void *value;		/**< the value of the current entry */
+} prom_map_iter_t;
+
 #endif  // PROM_MAP_T_H
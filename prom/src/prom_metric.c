@@ -16,20 +16,27 @@
  */
 
 #include <pthread.h>
+#include <string.h>
+#include <unistd.h>
 
 // Public
 #include "prom_alloc.h"
 #include "prom_histogram_buckets.h"
 
 // Private
+#include "prom_arena_i.h"
+#include "prom_arena_t.h"
 #include "prom_assert.h"
 #include "prom_errors.h"
+#include "prom_intern_i.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
+#include "prom_pool_i.h"
+#include "prom_pool_t.h"
 
 const char *prom_metric_type_map[5] =
 	{ "counter", "gauge", "histogram", "summary", "untyped" };
@@ -46,9 +53,26 @@ prom_metric_new(prom_metric_type_t metric_type, const char *name,
 	self->help = help;
 	self->buckets = NULL;
 	self->formatter = NULL;
+	self->unlabeled = NULL;
+	self->stripes = 0;
+	pmf_line_init(&self->meta);
+	memset(&self->store, 0, sizeof(pms_store_t));
+	memset(&self->pool, 0, sizeof(prom_pool_t));
+	memset(&self->labels, 0, sizeof(prom_arena_t));
+	self->capacity = 0;
+	atomic_init(&self->max_series, 0);
+	self->overflow = NULL;
+	atomic_init(&self->folding, false);
+	atomic_init(&self->dropped, 0);
+	atomic_init(&self->store.count, 0);
+	self->samples = NULL;
+	self->rwlock = NULL;
+	self->label_key_count = 0;
 
 	const char **k = (const char **)
 		prom_malloc(sizeof(const char *) * label_key_count);
+	if ((self->label_keys = k) == NULL && label_key_count > 0)
+		goto fail;
 
 	for (int i = 0; i < label_key_count; i++) {
 		if (strcmp(label_keys[i], "le") == 0) {
@@ -59,19 +83,23 @@ prom_metric_new(prom_metric_type_t metric_type, const char *name,
 			PROM_WARN(PROM_METRIC_INVALID_LABEL_NAME "(%s)", "quantile");
 			goto fail;
 		}
-		k[i] = prom_strdup(label_keys[i]);
+		// Usually the same keys get used by many metrics.
+		if ((k[i] = prom_intern(label_keys[i])) == NULL)
+			goto fail;
+		self->label_key_count++;
+	}
+	// Samples get looked up by the hash of their label values, so the map
+	// doesn't need a key of its own for each of them.
+	if ((self->samples = prom_map_new()) == NULL
+		|| prom_map_borrow_keys(self->samples))
+	{
+		goto fail;
 	}
-	self->label_keys = k;
-	self->label_key_count = label_key_count;
-	self->samples = prom_map_new();
 
-	if (metric_type == PROM_HISTOGRAM) {
-		if (prom_map_set_free_value_fn(self->samples,
-			&pms_histogram_free_generic))
-		{
-			goto fail;
-		}
-	} else if (prom_map_set_free_value_fn(self->samples, &pms_free_generic)) {
+	// Other samples belong to the store.
+	if (metric_type == PROM_HISTOGRAM && prom_map_set_free_value_fn(
+		self->samples, &pms_histogram_free_generic))
+	{
 		goto fail;
 	}
 
@@ -83,6 +111,13 @@ prom_metric_new(prom_metric_type_t metric_type, const char *name,
 		PROM_WARN(PROM_PTHREAD_RWLOCK_INIT_ERROR, NULL);
 		return NULL;
 	}
+
+	// Unlabeled metrics have exactly one sample, so bind it right away. The
+	// histogram one needs the buckets and gets bound by prom_histogram_new().
+	if (label_key_count == 0 && metric_type != PROM_HISTOGRAM) {
+		if ((self->unlabeled = pms_from_labels(self, NULL)) == NULL)
+			goto fail;
+	}
 	return self;
 
 fail:
@@ -90,6 +125,28 @@ fail:
 	return NULL;
 }
 
+/**
+ * @brief PRIVATE If labels of the given metric are stored in its arena,
+ *	unlink them from its samples, so that destroying them doesn't try to free
+ *	them on their own.
+ */
+static void
+prom_metric_disown_labels(prom_metric_t *self) {
+	if (!prom_arena_active(&self->labels))
+		return;
+	if (self->type == PROM_HISTOGRAM) {
+		prom_map_iter_t iter;
+		prom_map_iter_init(&iter, self->samples);
+		while (prom_map_iter_next(&iter))
+			((pms_histogram_t *) iter.value)->label_values = NULL;
+		return;
+	}
+	size_t count = pms_store_count(&self->store);
+	for (size_t id = 0; id < count; id++) {
+		pms_store_get(&self->store, id)->label_values = NULL;
+	}
+}
+
 int
 prom_metric_destroy(prom_metric_t *self) {
 	if (self == NULL)
@@ -98,24 +155,29 @@ prom_metric_destroy(prom_metric_t *self) {
 	phb_destroy(self->buckets);
 	self->buckets = NULL;
 
+	prom_metric_disown_labels(self);
 	prom_map_destroy(self->samples);
 	self->samples = NULL;
+	pms_store_destroy(&self->store);
+	prom_pool_destroy(&self->pool);
 
 	pmf_destroy(self->formatter);
 	self->formatter = NULL;
 
-	if (pthread_rwlock_destroy(self->rwlock))
+	if (self->rwlock != NULL && pthread_rwlock_destroy(self->rwlock))
 		PROM_WARN(PROM_PTHREAD_RWLOCK_DESTROY_ERROR, NULL);
 
 	prom_free(self->rwlock);
 	self->rwlock = NULL;
 
 	for (int i = 0; i < self->label_key_count; i++) {
-		prom_free((void *) self->label_keys[i]);
+		prom_intern_release(self->label_keys[i]);
 		self->label_keys[i] = NULL;
 	}
 	prom_free(self->label_keys);
 	self->label_keys = NULL;
+	pmf_line_destroy(&self->meta);
+	prom_arena_destroy(&self->labels);
 
 	prom_free(self);
 	return 0;
@@ -131,80 +193,389 @@ prom_metric_free_generic(void *item) {
 	prom_metric_destroy((prom_metric_t *) item);
 }
 
-pms_t *
-pms_from_labels(prom_metric_t *self, const char **label_values) {
-	PROM_ASSERT(self != NULL);
-	if (pthread_rwlock_wrlock(self->rwlock)) {
-		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
-		return NULL;
+/**
+ * @brief PRIVATE The label values a sample gets looked up with.
+ */
+typedef struct prom_metric_labels {
+	const char **values;
+	size_t count;
+	uint64_t fingerprint;	/**< prom_map_hash_strings() of the values */
+} prom_metric_labels_t;
+
+/**
+ * @brief PRIVATE Prepare the lookup of the sample with the given label values.
+ * @return A non-zero value if the label values are incomplete.
+ */
+static int
+prom_metric_labels_init(prom_metric_t *self, prom_metric_labels_t *labels,
+	const char **label_values)
+{
+	if (self->label_key_count > 0 && label_values == NULL) {
+		PROM_WARN("Label values for '%s' missing.", self->name);
+		return 1;
+	}
+	for (size_t i = 0; i < self->label_key_count; i++) {
+		if (label_values[i] == NULL) {
+			PROM_WARN("Value of label '%s' of '%s' missing.",
+				self->label_keys[i], self->name);
+			return 2;
+		}
+	}
+	labels->values = label_values;
+	labels->count = self->label_key_count;
+	labels->fingerprint = prom_map_hash_strings(label_values,
+		self->label_key_count);
+	return 0;
+}
+
+/**
+ * @brief PRIVATE A prom_map_match_fn for pms_t samples.
+ */
+static bool
+pms_match(const void *value, const void *arg) {
+	const prom_metric_labels_t *labels = (const prom_metric_labels_t *) arg;
+	return pms_label_values_equal(((const pms_t *) value)->label_values,
+		labels->values, labels->count);
+}
+
+/**
+ * @brief PRIVATE A prom_map_match_fn for pms_histogram_t samples.
+ */
+static bool
+pms_histogram_match(const void *value, const void *arg) {
+	const prom_metric_labels_t *labels = (const prom_metric_labels_t *) arg;
+	return pms_label_values_equal(
+		((const pms_histogram_t *) value)->label_values,
+		labels->values, labels->count);
+}
+
+/**
+ * @brief PRIVATE Get the arena for the labels of new series of the given
+ *	metric, or \c NULL if they get allocated on their own.
+ */
+static inline prom_arena_t *
+prom_metric_arena(prom_metric_t *self) {
+	return prom_arena_active(&self->labels) ? &self->labels : NULL;
+}
+
+/** @brief PRIVATE What happens to a new series of a metric. */
+typedef enum prom_metric_admission {
+	PROM_METRIC_ADD,	/**< add it */
+	PROM_METRIC_FOLD,	/**< use the overflow series instead */
+	PROM_METRIC_DROP	/**< reject it */
+} prom_metric_admission_t;
+
+/**
+ * @brief PRIVATE Count a new series of the given metric, which got folded
+ *	into the overflow series or dropped.
+ */
+static void
+prom_metric_reject(prom_metric_t *self, prom_metric_admission_t how) {
+	if (atomic_fetch_add_explicit(&self->dropped, 1, memory_order_relaxed) > 0)
+		return;
+	if (how == PROM_METRIC_FOLD) {
+		PROM_WARN("Series limit of '%s' reached - new series get folded into "
+			"the " PROM_OVERFLOW_LABEL_VALUE " series.", self->name);
+	} else {
+		PROM_WARN("Capacity of '%s' exhausted - new series get dropped.",
+			self->name);
 	}
+}
+
+/**
+ * @brief PRIVATE Check, whether another series can be added to the given
+ *	metric. If not, the attempt gets counted. The caller must hold the lock.
+ */
+static prom_metric_admission_t
+prom_metric_admit(prom_metric_t *self) {
+	size_t size = prom_map_size(self->samples);
+	size_t max = atomic_load_explicit(&self->max_series, memory_order_relaxed);
+	prom_metric_admission_t how = PROM_METRIC_ADD;
 
-	// Get l_value
-	if (pmf_load_l_value(self->formatter, self->name, NULL,
-		self->label_key_count, self->label_keys, label_values))
+	// The overflow series does not count against the limit.
+	if (max > 0 && size - (self->overflow != NULL) >= max)
+		how = PROM_METRIC_FOLD;
+	// But it needs room within the capacity like any other new series, e.g.
+	// if the limit got set, when the capacity was exhausted already.
+	if (self->capacity > 0 && size >= self->capacity
+		&& (how == PROM_METRIC_ADD || self->overflow == NULL))
 	{
-		goto fail;
+		how = PROM_METRIC_DROP;
 	}
+	if (how != PROM_METRIC_ADD)
+		prom_metric_reject(self, how);
+	return how;
+}
 
-	// This must be freed before returning
-	const char *l_value = pmf_dump(self->formatter);
-	if (l_value == NULL)
-		goto fail;
+/**
+ * @brief PRIVATE Create a new series of the given metric. The caller must
+ *	hold the lock.
+ * @return \c NULL on error.
+ */
+typedef void *prom_metric_add_fn(prom_metric_t *self,
+	prom_metric_labels_t *labels);
 
-	// Get sample
-	pms_t *sample = (pms_t *) prom_map_get(self->samples, l_value);
-	if (sample == NULL) {
-		sample = pms_new(self->type, l_value, 0.0);
-		if (prom_map_set(self->samples, l_value, sample))
-			goto fail;
+/**
+ * @brief PRIVATE A prom_metric_add_fn for counters, gauges and untyped
+ *	metrics.
+ */
+static void *
+pms_add_series(prom_metric_t *self, prom_metric_labels_t *labels) {
+	prom_arena_t *arena = prom_metric_arena(self);
+	size_t mark = (arena == NULL) ? 0 : arena->used;
+	pms_t *sample = pms_store_next(&self->store, self->type);
+	if (sample != NULL && ((labels->count > 0 && (sample->label_values =
+			pms_label_values_new(arena, labels->count, labels->values))
+			== NULL)
+		|| pms_stripe(sample, self->stripes)
+		|| prom_map_set_hashed(self->samples, labels->fingerprint,
+			pms_match, labels, self->name, sample)))
+	{
+		if (arena != NULL)
+			sample->label_values = NULL;
+		pms_clear(sample);
+		sample = NULL;
 	}
-	pthread_rwlock_unlock(self->rwlock);
-	prom_free((void *) l_value);
+	if (sample != NULL)
+		pms_store_commit(&self->store);
+	else if (arena != NULL)
+		arena->used = mark;
 	return sample;
+}
 
-fail:
+/**
+ * @brief PRIVATE A prom_metric_add_fn for histograms.
+ */
+static void *
+pms_histogram_add_series(prom_metric_t *self, prom_metric_labels_t *labels) {
+	prom_arena_t *arena = prom_metric_arena(self);
+	size_t mark = (arena == NULL) ? 0 : arena->used;
+	pms_histogram_t *sample = pms_histogram_new(&self->pool, arena,
+		self->buckets, labels->count, labels->values);
+	if (sample != NULL && prom_map_set_hashed(self->samples,
+		labels->fingerprint, pms_histogram_match, labels, self->name, sample))
+	{
+		if (arena != NULL)
+			sample->label_values = NULL;
+		pms_histogram_destroy(sample);
+		sample = NULL;
+	}
+	if (sample == NULL && arena != NULL)
+		arena->used = mark;
+	return sample;
+}
+
+/**
+ * @brief PRIVATE Get the overflow series of the given metric, and create it
+ *	on first use. The caller must hold the lock.
+ * @return \c NULL on error.
+ */
+static void *
+prom_metric_overflow(prom_metric_t *self, prom_map_match_fn *match,
+	prom_metric_add_fn *add)
+{
+	if (self->overflow != NULL)
+		return self->overflow;
+
+	const char *values[self->label_key_count];
+	for (size_t i = 0; i < self->label_key_count; i++)
+		values[i] = PROM_OVERFLOW_LABEL_VALUE;
+	prom_metric_labels_t labels;
+	prom_metric_labels_init(self, &labels, values);
+	// Possibly a caller used the reserved value already.
+	void *sample = prom_map_get_hashed(self->samples, labels.fingerprint,
+		match, &labels);
+	if (sample == NULL)
+		sample = add(self, &labels);
+	if ((self->overflow = sample) != NULL)
+		atomic_store_explicit(&self->folding, true, memory_order_release);
+	return sample;
+}
+
+/**
+ * @brief PRIVATE Get the series of the given metric with the given label
+ *	values, and create it if needed and allowed.
+ */
+static void *
+prom_metric_series(prom_metric_t *self, const char **label_values,
+	prom_map_match_fn *match, prom_metric_add_fn *add)
+{
+	prom_metric_labels_t labels;
+	if (prom_metric_labels_init(self, &labels, label_values))
+		return NULL;
+
+	// Existing series: no lock needed, nothing to render. Samples get freed
+	// only together with the metric.
+	void *sample = prom_map_get_hashed(self->samples, labels.fingerprint,
+		match, &labels);
+	if (sample != NULL)
+		return sample;
+	// Over the limit already: a runaway label doesn't contend for the lock.
+	if (atomic_load_explicit(&self->folding, memory_order_acquire)) {
+		prom_metric_reject(self, PROM_METRIC_FOLD);
+		return self->overflow;
+	}
+
+	if (pthread_rwlock_wrlock(self->rwlock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return NULL;
+	}
+	// Another thread might have been faster.
+	sample = prom_map_get_hashed(self->samples, labels.fingerprint, match,
+		&labels);
+	if (sample == NULL) {
+		switch (prom_metric_admit(self)) {
+			case PROM_METRIC_ADD:
+				sample = add(self, &labels);
+				break;
+			case PROM_METRIC_FOLD:
+				sample = prom_metric_overflow(self, match, add);
+				break;
+			case PROM_METRIC_DROP:
+				break;
+		}
+	}
 	if (pthread_rwlock_unlock(self->rwlock))
 		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
-	return NULL;
+	return sample;
+}
+
+pms_t *
+pms_from_labels(prom_metric_t *self, const char **label_values) {
+	PROM_ASSERT(self != NULL);
+	if (self->unlabeled != NULL)
+		return (pms_t *) self->unlabeled;
+	return (pms_t *) prom_metric_series(self, label_values, pms_match,
+		pms_add_series);
 }
 
 pms_histogram_t *
 pms_histogram_from_labels(prom_metric_t *self, const char **label_values) {
 	PROM_ASSERT(self != NULL);
+	if (self->unlabeled != NULL)
+		return (pms_histogram_t *) self->unlabeled;
+	return (pms_histogram_t *) prom_metric_series(self, label_values,
+		pms_histogram_match, pms_histogram_add_series);
+}
+
+int
+prom_metric_set_stripes(prom_metric_t *self, unsigned int count) {
+	if (self == NULL)
+		return 1;
+	if (self->type != PROM_COUNTER && self->type != PROM_GAUGE) {
+		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s",
+			self->type, self->name);
+		return 2;
+	}
+	if (count == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		count = (n < 1) ? 1 : n;
+	}
+	if (self->capacity > 0 && count > 1) {
+		PROM_WARN("Striped samples of '%s' need memory per series.",
+			self->name);
+		return 5;
+	}
 	if (pthread_rwlock_wrlock(self->rwlock)) {
 		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
-		return NULL;
+		return 3;
 	}
+	int err = 0;
+	self->stripes = count;
+	prom_map_iter_t iter;
+	prom_map_iter_init(&iter, self->samples);
+	while (prom_map_iter_next(&iter)) {
+		if (iter.value != NULL && pms_stripe(iter.value, count))
+			err = 4;
+	}
+	if (pthread_rwlock_unlock(self->rwlock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return err;
+}
 
-	// Load the l_value
-	if (pmf_load_l_value(self->formatter, self->name, NULL,
-		self->label_key_count, self->label_keys, label_values))
+int
+prom_metric_set_capacity(prom_metric_t *self, size_t series,
+	size_t label_bytes)
+{
+	if (self == NULL || series == 0 || label_bytes == 0)
+		return 1;
+	// The only series got allocated with the metric.
+	if (self->label_key_count == 0)
+		return 0;
+	if (self->stripes > 1) {
+		PROM_WARN("Striped samples of '%s' need memory per series.",
+			self->name);
+		return 2;
+	}
+	if (pthread_rwlock_wrlock(self->rwlock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return 3;
+	}
+	int err = 0;
+	if (self->capacity != 0 || prom_map_size(self->samples) > 0) {
+		PROM_WARN("Capacity of '%s' needs to be set before its first series.",
+			self->name);
+		err = 4;
+		goto end;
+	}
+	if (atomic_load_explicit(&self->max_series, memory_order_relaxed)
+		>= series)
 	{
-		goto fail;
+		PROM_WARN("Capacity of '%s' leaves no room for its overflow series.",
+			self->name);
+		err = 6;
+		goto end;
+	}
+	if (prom_map_reserve(self->samples, series)
+		|| ((self->type == PROM_HISTOGRAM)
+			? prom_pool_reserve(&self->pool, series)
+			: pms_store_reserve(&self->store, series))
+		|| prom_arena_init(&self->labels, label_bytes))
+	{
+		prom_arena_destroy(&self->labels);
+		err = 5;
+		goto end;
 	}
+	self->capacity = series;
 
-	// This must be freed before returning
-	const char *l_value = pmf_dump(self->formatter);
-	if (l_value == NULL)
-		goto fail;
+end:
+	if (pthread_rwlock_unlock(self->rwlock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return err;
+}
 
-	// Get sample
-	pms_histogram_t *sample = (pms_histogram_t *)
-		prom_map_get(self->samples, l_value);
-	if (sample == NULL) {
-		sample = pms_histogram_new(self->name, self->buckets,
-			self->label_key_count, self->label_keys, label_values);
-		if (sample == NULL || prom_map_set(self->samples, l_value, sample)) {
-			prom_free((void *) l_value);
-			goto fail;
-		}
+uint64_t
+prom_metric_dropped(prom_metric_t *self) {
+	return (self == NULL)
+		? 0
+		: atomic_load_explicit(&self->dropped, memory_order_relaxed);
+}
+
+int
+prom_metric_set_max_series(prom_metric_t *self, size_t series) {
+	if (self == NULL)
+		return 1;
+	// The only series got allocated with the metric.
+	if (self->label_key_count == 0)
+		return 0;
+	if (pthread_rwlock_wrlock(self->rwlock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return 2;
 	}
-	pthread_rwlock_unlock(self->rwlock);
-	prom_free((void *) l_value);
-	return sample;
+	int err = 0;
+	// Otherwise the overflow series would be allocated on update.
+	if (self->capacity > 0 && series >= self->capacity) {
+		PROM_WARN("Series limit of '%s' leaves no room for its overflow "
+			"series.", self->name);
+		err = 3;
+		goto end;
+	}
+	atomic_store_explicit(&self->max_series, series, memory_order_relaxed);
+	// Room for more series, possibly.
+	atomic_store_explicit(&self->folding, false, memory_order_relaxed);
 
-fail:
+end:
 	if (pthread_rwlock_unlock(self->rwlock))
 		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
-	return NULL;
+	return err;
 }
@@ -15,6 +15,7 @@
  * limitations under the License.
  */
 
+#include <sched.h>
 #include <stdio.h>
 
 // Public
@@ -23,14 +24,18 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_collector_i.h"
 #include "prom_collector_t.h"
-#include "prom_linked_list_t.h"
+#include "prom_dtoa_i.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
-#include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_histogram_i.h"
+#include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
+#include "prom_protobuf_i.h"
 #include "prom_string_builder.h"
 
 pmf_t *
@@ -42,8 +47,12 @@ pmf_new() {
 		self->err_builder = NULL;
 		goto fail;
 	}
+	self->scratch = NULL;
+	self->format = PROM_FORMAT_TEXT;
 	if ((self->err_builder = psb_new()) == NULL)
 		goto fail;
+	if ((self->scratch = psb_new()) == NULL)
+		goto fail;
 	return self;
 
 fail:
@@ -62,10 +71,98 @@ pmf_destroy(pmf_t *self) {
 	psb_destroy(self->err_builder);
 	self->err_builder = NULL;
 
+	psb_destroy(self->scratch);
+	self->scratch = NULL;
+
 	prom_free(self);
 	return 0;
 }
 
+void
+pmf_line_init(pmf_line_t *line) {
+	PROM_ASSERT(line != NULL);
+	atomic_flag_clear(&line->lock);
+	line->format = PROM_FORMAT_TEXT;
+	line->key = 0;
+	line->prefix = NULL;
+	line->head = 0;
+	line->len = line->size = 0;
+	line->data = NULL;
+}
+
+void
+pmf_line_destroy(pmf_line_t *line) {
+	if (line == NULL)
+		return;
+	prom_free(line->data);
+	line->data = NULL;
+	line->head = 0;
+	line->len = line->size = 0;
+}
+
+static inline void
+pmf_line_lock(pmf_line_t *line) {
+	// Contended only by concurrent scrapes of the same series.
+	while (atomic_flag_test_and_set_explicit(&line->lock, memory_order_acquire))
+		sched_yield();
+}
+
+static inline void
+pmf_line_unlock(pmf_line_t *line) {
+	atomic_flag_clear_explicit(&line->lock, memory_order_release);
+}
+
+/**
+ * @brief PRIVATE Append the given locked rendering, if it is what the
+ *	formatter would render for the given key and prefix.
+ * @param err	Where to store, whether appending failed.
+ * @return \c true if appended, \c false if it needs to be rendered again.
+ */
+static bool
+pmf_line_load(pmf_t *self, pmf_line_t *line, uint64_t key, const char *prefix,
+	int *err)
+{
+	if (line->data == NULL || line->key != key || line->prefix != prefix
+		|| line->format != self->format)
+	{
+		return false;
+	}
+	*err = psb_add_bytes(self->string_builder, line->data, line->len);
+	return true;
+}
+
+/**
+ * @brief PRIVATE Store everything the formatter rendered after the given
+ *	position as the locked rendering for the given key and prefix. If out of
+ *	memory or too large, the rendering gets dropped and just renders again
+ *	next time.
+ */
+static void
+pmf_line_store(pmf_t *self, pmf_line_t *line, uint64_t key,
+	const char *prefix, size_t start)
+{
+	size_t len = psb_len(self->string_builder) - start;
+	if (len > UINT32_MAX) {
+		pmf_line_destroy(line);
+		return;
+	}
+	if (len > line->size) {
+		char *data = prom_realloc(line->data, len);
+		if (data == NULL) {
+			pmf_line_destroy(line);
+			return;
+		}
+		line->data = data;
+		line->size = len;
+	}
+	memcpy(line->data, psb_str(self->string_builder) + start, len);
+	line->head = 0;
+	line->len = len;
+	line->key = key;
+	line->prefix = prefix;
+	line->format = self->format;
+}
+
 int
 pmf_load_help(pmf_t *self, const char *prefix, const char *name,
 	const char *help)
@@ -146,25 +243,287 @@ pmf_load_l_value(pmf_t *self, const char *name, const char *suffix,
 	return 0;
 }
 
+/** @brief PRIVATE Suffix OpenMetrics requires for counter samples. */
+#define PMF_OM_TOTAL "_total"
+#define PMF_OM_TOTAL_LEN (sizeof(PMF_OM_TOTAL) - 1)
+
+/**
+ * @brief PRIVATE Loads the l_value of a line of a series of the given metric,
+ *	i.e. the metric name with the given suffix, followed by the given label
+ *	values and the given \c le label, if any.
+ */
+static int
+pmf_load_series_l_value(psb_t *sb, prom_metric_t *metric,
+	const char **label_values, const char *prefix, const char *suffix,
+	const char *le)
+{
+	if ((prefix != NULL && psb_add_str(sb, prefix))
+		|| psb_add_str(sb, metric->name) || psb_add_str(sb, suffix))
+	{
+		return 1;
+	}
+	if (metric->label_key_count == 0 && le == NULL)
+		return 0;
+	if (psb_add_char(sb, '{'))
+		return 2;
+	for (size_t i = 0; i < metric->label_key_count; i++) {
+		if ((i > 0 && psb_add_char(sb, ','))
+			|| psb_add_str(sb, metric->label_keys[i])
+			|| psb_add_str(sb, "=\"")
+			|| psb_add_str(sb, label_values[i])
+			|| psb_add_char(sb, '"'))
+		{
+			return 3;
+		}
+	}
+	if (le != NULL && ((metric->label_key_count > 0 && psb_add_char(sb, ','))
+		|| psb_add_str(sb, "le=\"") || psb_add_str(sb, le)
+		|| psb_add_char(sb, '"')))
+	{
+		return 4;
+	}
+	return psb_add_char(sb, '}') ? 5 : 0;
+}
+
+/**
+ * @brief PRIVATE Loads a metric sample. Gets spliced from its last rendering,
+ *	if its value did not change since then. Otherwise only the value gets
+ *	rendered, if the l_value of the last rendering can be reused.
+ * @param metric	The metric of the sample. Only needed, if the sample has
+ *	no l_value of its own, i.e. unless created by pms_new().
+ * @param total	Where to insert the \c _total suffix of OpenMetrics counters
+ *	into the l_value, i.e. the length of the metric name, \c 0 for none.
+ */
+static int
+pmf_load_line(pmf_t *self, prom_metric_t *metric, pms_t *sample,
+	const char *prefix, size_t total)
+{
+	psb_t *sb = self->string_builder;
+	double v = pms_get(sample);
+	uint64_t key;
+	int err = 0;
+
+	// Compare bits, so that NaN matches as well.
+	memcpy(&key, &v, sizeof(key));
+	pmf_line_t *line = &sample->line;
+	pmf_line_lock(line);
+	if (pmf_line_load(self, line, key, prefix, &err))
+		goto end;
+
+	size_t start = psb_len(sb);
+	if (line->head > 0 && line->prefix == prefix
+		&& line->format == self->format)
+	{
+		if (psb_add_bytes(sb, line->data, line->head)) {
+			err = 2;
+			goto end;
+		}
+	} else if (sample->l_value == NULL) {
+		if (pmf_load_series_l_value(sb, metric, sample->label_values, prefix,
+			(total == 0) ? "" : PMF_OM_TOTAL, NULL))
+		{
+			err = 3;
+			goto end;
+		}
+	} else if ((prefix != NULL && psb_add_str(sb, prefix))
+		|| psb_add_bytes(sb, sample->l_value, total)
+		|| (total > 0 && psb_add_bytes(sb, PMF_OM_TOTAL, PMF_OM_TOTAL_LEN))
+		|| psb_add_str(sb, sample->l_value + total))
+	{
+		err = 4;
+		goto end;
+	}
+	size_t head = psb_len(sb) - start;
+	char buffer[PROM_DTOA_BUFSZ + 2];
+	buffer[0] = ' ';
+	size_t len = prom_dtoa(v, buffer + 1) + 1;
+	buffer[len++] = '\n';
+	if (psb_add_bytes(sb, buffer, len)) {
+		err = 5;
+		goto end;
+	}
+	pmf_line_store(self, line, key, prefix, start);
+	if (line->data != NULL && head <= UINT16_MAX)
+		line->head = head;
+
+end:
+	pmf_line_unlock(line);
+	return err;
+}
+
 int
 pmf_load_sample(pmf_t *self, pms_t *sample, const char *prefix) {
+	if (self == NULL || sample == NULL || sample->l_value == NULL)
+		return 1;
+	return pmf_load_line(self, NULL, sample, prefix, 0);
+}
+
+int
+pmf_load_histogram_sample(pmf_t *self, prom_metric_t *metric,
+	pms_histogram_t *sample, const char *prefix)
+{
 	if (self == NULL)
 		return 1;
-	if (prefix != NULL)
-		psb_add_str(self->string_builder, prefix);
-	if (psb_add_str(self->string_builder, sample->l_value))
+
+	uint64_t count;
+	double sum;
+	size_t n = sample->bucket_count + 1;
+	uint64_t *bucket = (uint64_t *) prom_malloc(n * sizeof(uint64_t));
+	if (bucket == NULL)
 		return 2;
-	char buffer[64];
-	sprintf(buffer, " %.17g", sample->r_value);
-	if (psb_add_str(self->string_builder, buffer))
+	int err = 3;
+	if (pms_histogram_snapshot(sample, bucket, &count, &sum))
+		goto end;
+
+	// No observation since the last rendering: buckets and sum are the same.
+	pmf_line_lock(&sample->line);
+	if (pmf_line_load(self, &sample->line, count, prefix, &err))
+		goto unlock;
+
+	size_t start = psb_len(self->string_builder);
+	char buffer[PROM_DTOA_BUFSZ + 2];
+	buffer[0] = ' ';
+	err = 4;
+	// bucket_count + 1 bucket lines, followed by count and sum
+	for (size_t i = 0; i < n + 2; i++) {
+		if (pmf_load_series_l_value(self->string_builder, metric,
+			sample->label_values, prefix,
+			(i < n) ? "_bucket" : (i == n) ? "_count" : "_sum",
+			(i < n - 1) ? sample->buckets->key[i] : (i == n - 1) ? "+Inf"
+			: NULL))
+		{
+			goto unlock;
+		}
+		size_t len = 1 + ((i < n) ? prom_u64toa(bucket[i], buffer + 1)
+			: (i == n) ? prom_u64toa(count, buffer + 1)
+			: prom_dtoa(sum, buffer + 1));
+		buffer[len++] = '\n';
+		buffer[len] = '\0';
+		if (psb_add_str(self->string_builder, buffer))
+			goto unlock;
+	}
+	pmf_line_store(self, &sample->line, count, prefix, start);
+	err = 0;
+
+unlock:
+	pmf_line_unlock(&sample->line);
+end:
+	prom_free(bucket);
+	return err;
+}
+
+/**
+ * @brief PRIVATE Length of the OpenMetrics family name of the given metric,
+ *	i.e. of its name without the \c _total suffix of counters.
+ * @param total	Where to store, whether the name has the suffix already.
+ */
+static size_t
+pmf_om_family_len(prom_metric_t *metric, bool *total) {
+	size_t len = strlen(metric->name);
+	*total = metric->type == PROM_COUNTER && len > PMF_OM_TOTAL_LEN
+		&& strcmp(metric->name + len - PMF_OM_TOTAL_LEN, PMF_OM_TOTAL) == 0;
+	return *total ? len - PMF_OM_TOTAL_LEN : len;
+}
+
+/**
+ * @brief PRIVATE Loads an OpenMetrics HELP text. Backslash, double quote and
+ *	newline need to be escaped.
+ */
+static int
+pmf_load_om_help(psb_t *sb, const char *help) {
+	const char *s;
+	while ((s = strpbrk(help, "\\\"\n")) != NULL) {
+		if (psb_add_bytes(sb, help, s - help) || psb_add_char(sb, '\\')
+			|| psb_add_char(sb, (*s == '\n') ? 'n' : *s))
+		{
+			return 1;
+		}
+		help = s + 1;
+	}
+	return psb_add_str(sb, help);
+}
+
+/**
+ * @brief PRIVATE Loads the HELP and TYPE lines of the given metric in the
+ *	OpenMetrics format.
+ */
+static int
+pmf_load_om_meta(pmf_t *self, prom_metric_t *metric, const char *prefix,
+	bool compact)
+{
+	psb_t *sb = self->string_builder;
+	bool total;
+	size_t len = pmf_om_family_len(metric, &total);
+
+	if (!compact && metric->help != NULL) {
+		if (psb_add_str(sb, "# HELP ")
+			|| (prefix != NULL && psb_add_str(sb, prefix))
+			|| psb_add_bytes(sb, metric->name, len)
+			|| psb_add_char(sb, ' ')
+			|| pmf_load_om_help(sb, metric->help)
+			|| psb_add_char(sb, '\n'))
+		{
+			return 2;
+		}
+	}
+	if (psb_add_str(sb, "# TYPE ")
+		|| (prefix != NULL && psb_add_str(sb, prefix))
+		|| psb_add_bytes(sb, metric->name, len)
+		|| psb_add_char(sb, ' ')
+		|| psb_add_str(sb, (metric->type == PROM_UNTYPED)
+			? "unknown"
+			: prom_metric_type_map[metric->type])
+		|| psb_add_char(sb, '\n'))
+	{
 		return 3;
-	return psb_add_char(self->string_builder, '\n') ? 4 : 0;
+	}
+	return 0;
+}
+
+int
+pmf_load_meta(pmf_t *self, prom_metric_t *metric, const char *prefix,
+	bool compact)
+{
+	if (self == NULL)
+		return 1;
+	int err = 0;
+
+	// Rendered on first use, when format and prefix are known.
+	pmf_line_lock(&metric->meta);
+	if (pmf_line_load(self, &metric->meta, compact, prefix, &err))
+		goto end;
+	size_t start = psb_len(self->string_builder);
+	if (self->format == PROM_FORMAT_OPENMETRICS) {
+		err = pmf_load_om_meta(self, metric, prefix, compact);
+	} else if (!compact) {
+		if (pmf_load_help(self, prefix, metric->name, metric->help))
+			err = 2;
+		else if (pmf_load_type(self, prefix, metric->name, metric->type))
+			err = 3;
+	}
+	if (err == 0)
+		pmf_line_store(self, &metric->meta, compact, prefix, start);
+
+end:
+	pmf_line_unlock(&metric->meta);
+	return err;
+}
+
+int
+pmf_load_end(pmf_t *self) {
+	if (self == NULL)
+		return 1;
+	if (self->format != PROM_FORMAT_OPENMETRICS)
+		return 0;
+	return psb_add_str(self->string_builder, "# EOF\n") ? 2 : 0;
 }
 
 int
 pmf_clear(pmf_t *self) {
 	PROM_ASSERT(self != NULL);
-	return psb_clear(self->string_builder);
+	psb_reset(self->err_builder);
+	psb_reset(self->scratch);
+	return psb_reset(self->string_builder);
 }
 
 char *
@@ -172,10 +531,276 @@ pmf_dump(pmf_t *self) {
 	if (self == NULL)
 		return NULL;
 	char *data = psb_dump(self->string_builder);
-	psb_clear(self->string_builder);
+	psb_reset(self->string_builder);
 	return data;
 }
 
+/**
+ * @brief PRIVATE Load the samples of the given metric starting at the given
+ *	position, until the formatter contains at least \c limit bytes.
+ * @param pos	Where to start, gets advanced to the next sample to load.
+ *	The series id, or for histograms the position within the samples map.
+ * @param more	Where to store, whether samples are left.
+ * @return A non-zero value on error, \c 0 otherwise.
+ */
+static int
+pmf_load_samples(pmf_t *self, prom_metric_t *metric, size_t *pos,
+	const char *prefix, size_t limit, bool *more)
+{
+	// New samples may get added concurrently, but stripes must not change.
+	if (pthread_rwlock_rdlock(metric->rwlock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		*more = false;
+		return 10;
+	}
+	int err = 0;
+	// OpenMetrics counter samples need the _total suffix.
+	bool total = true;
+	size_t len = (self->format == PROM_FORMAT_OPENMETRICS
+		&& metric->type == PROM_COUNTER)
+		? pmf_om_family_len(metric, &total)
+		: 0;
+	*more = true;
+	if (metric->type == PROM_HISTOGRAM) {
+		prom_map_iter_t iter;
+		prom_map_iter_init(&iter, metric->samples);
+		iter.pos = *pos;
+		while (err == 0 && psb_len(self->string_builder) < limit
+			&& (*more = prom_map_iter_next(&iter)))
+		{
+			if (pmf_load_histogram_sample(self, metric, iter.value, prefix))
+				err = 6;
+		}
+		*pos = iter.pos;
+	} else {
+		// Walk the store: the samples are next to each other.
+		size_t count = pms_store_count(&metric->store);
+		while (err == 0 && psb_len(self->string_builder) < limit
+			&& (*more = *pos < count))
+		{
+			pms_t *sample = pms_store_get(&metric->store, (*pos)++);
+			if (pmf_load_line(self, metric, sample, prefix, total ? 0 : len))
+				err = 7;
+		}
+	}
+	if (pthread_rwlock_unlock(metric->rwlock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	return err;
+}
+
+// Field numbers and enum values of io.prometheus.client.MetricFamily and its
+// embedded messages, see prometheus/client_model metrics.proto.
+#define PMF_PB_FAMILY_NAME 1
+#define PMF_PB_FAMILY_HELP 2
+#define PMF_PB_FAMILY_TYPE 3
+#define PMF_PB_FAMILY_METRIC 4
+#define PMF_PB_LABEL_NAME 1
+#define PMF_PB_LABEL_VALUE 2
+#define PMF_PB_METRIC_LABEL 1
+#define PMF_PB_METRIC_GAUGE 2
+#define PMF_PB_METRIC_COUNTER 3
+#define PMF_PB_METRIC_UNTYPED 5
+#define PMF_PB_METRIC_HISTOGRAM 7
+#define PMF_PB_VALUE 1
+#define PMF_PB_HISTOGRAM_COUNT 1
+#define PMF_PB_HISTOGRAM_SUM 2
+#define PMF_PB_HISTOGRAM_BUCKET 3
+#define PMF_PB_BUCKET_COUNT 1
+#define PMF_PB_BUCKET_BOUND 2
+#define PMF_PB_TYPE_COUNTER 0
+#define PMF_PB_TYPE_GAUGE 1
+#define PMF_PB_TYPE_UNTYPED 3
+#define PMF_PB_TYPE_HISTOGRAM 4
+
+/**
+ * @brief PRIVATE Encoded size of the LabelPair fields of a Metric message.
+ */
+static size_t
+pmf_pb_labels_size(prom_metric_t *metric, const char **values) {
+	size_t size = 0;
+	for (size_t i = 0; i < metric->label_key_count; i++) {
+		size_t pair = ppb_len_size(PMF_PB_LABEL_NAME,
+				strlen(metric->label_keys[i]))
+			+ ppb_len_size(PMF_PB_LABEL_VALUE, strlen(values[i]));
+		size += ppb_len_size(PMF_PB_METRIC_LABEL, pair);
+	}
+	return size;
+}
+
+/**
+ * @brief PRIVATE Write the LabelPair fields of a Metric message.
+ */
+static unsigned char *
+pmf_pb_put_labels(unsigned char *p, prom_metric_t *metric,
+	const char **values)
+{
+	for (size_t i = 0; i < metric->label_key_count; i++) {
+		size_t klen = strlen(metric->label_keys[i]);
+		size_t vlen = strlen(values[i]);
+		p = ppb_put_len(p, PMF_PB_METRIC_LABEL,
+			ppb_len_size(PMF_PB_LABEL_NAME, klen)
+			+ ppb_len_size(PMF_PB_LABEL_VALUE, vlen));
+		p = ppb_put_string(p, PMF_PB_LABEL_NAME, metric->label_keys[i], klen);
+		p = ppb_put_string(p, PMF_PB_LABEL_VALUE, values[i], vlen);
+	}
+	return p;
+}
+
+/**
+ * @brief PRIVATE Size of the stack buffer Metric messages get encoded in.
+ *	Larger ones need a temporary heap buffer.
+ */
+#define PMF_PB_BUF_SIZE 512
+
+/**
+ * @brief PRIVATE Append the given sample as Metric message to the scratch
+ *	buffer of the given formatter. The message gets encoded as a whole and
+ *	appended at once, which is much cheaper than appending field by field.
+ */
+static int
+pmf_pb_add_sample(pmf_t *self, prom_metric_t *metric, pms_t *sample) {
+	unsigned char buf[PMF_PB_BUF_SIZE], *msg = buf, *p;
+	unsigned int field = (metric->type == PROM_COUNTER) ? PMF_PB_METRIC_COUNTER
+		: (metric->type == PROM_GAUGE) ? PMF_PB_METRIC_GAUGE
+		: PMF_PB_METRIC_UNTYPED;
+	size_t value = ppb_double_size(PMF_PB_VALUE);
+	size_t size = pmf_pb_labels_size(metric, sample->label_values)
+		+ ppb_len_size(field, value);
+	size_t total = ppb_len_size(PMF_PB_FAMILY_METRIC, size);
+
+	if (total > sizeof(buf)
+		&& (msg = (unsigned char *) prom_malloc(total)) == NULL)
+	{
+		return 1;
+	}
+	p = ppb_put_len(msg, PMF_PB_FAMILY_METRIC, size);
+	p = pmf_pb_put_labels(p, metric, sample->label_values);
+	p = ppb_put_len(p, field, value);
+	p = ppb_put_double(p, PMF_PB_VALUE, pms_get(sample));
+	int err = psb_add_bytes(self->scratch, msg, p - msg);
+	if (msg != buf)
+		prom_free(msg);
+	return err;
+}
+
+/**
+ * @brief PRIVATE Append the given histogram sample as Metric message to the
+ *	scratch buffer of the given formatter. The +Inf bucket is implied by the
+ *	sample count, so it gets omitted.
+ */
+static int
+pmf_pb_add_histogram_sample(pmf_t *self, prom_metric_t *metric,
+	pms_histogram_t *sample)
+{
+	unsigned char buf[PMF_PB_BUF_SIZE], *msg = NULL, *p;
+	uint64_t count;
+	double sum;
+	size_t n = sample->bucket_count;
+	uint64_t *bucket = (uint64_t *) prom_malloc((n + 1) * sizeof(uint64_t));
+	if (bucket == NULL)
+		return 1;
+	int err = 2;
+	if (pms_histogram_snapshot(sample, bucket, &count, &sum))
+		goto end;
+
+	size_t hist = ppb_uint64_size(PMF_PB_HISTOGRAM_COUNT, count)
+		+ ppb_double_size(PMF_PB_HISTOGRAM_SUM);
+	for (size_t i = 0; i < n; i++)
+		hist += ppb_len_size(PMF_PB_HISTOGRAM_BUCKET,
+			ppb_uint64_size(PMF_PB_BUCKET_COUNT, bucket[i])
+			+ ppb_double_size(PMF_PB_BUCKET_BOUND));
+	size_t size = pmf_pb_labels_size(metric, sample->label_values)
+		+ ppb_len_size(PMF_PB_METRIC_HISTOGRAM, hist);
+	size_t total = ppb_len_size(PMF_PB_FAMILY_METRIC, size);
+
+	err = 3;
+	msg = (total > sizeof(buf)) ? (unsigned char *) prom_malloc(total) : buf;
+	if (msg == NULL)
+		goto end;
+	p = ppb_put_len(msg, PMF_PB_FAMILY_METRIC, size);
+	p = pmf_pb_put_labels(p, metric, sample->label_values);
+	p = ppb_put_len(p, PMF_PB_METRIC_HISTOGRAM, hist);
+	p = ppb_put_uint64(p, PMF_PB_HISTOGRAM_COUNT, count);
+	p = ppb_put_double(p, PMF_PB_HISTOGRAM_SUM, sum);
+	for (size_t i = 0; i < n; i++) {
+		p = ppb_put_len(p, PMF_PB_HISTOGRAM_BUCKET,
+			ppb_uint64_size(PMF_PB_BUCKET_COUNT, bucket[i])
+			+ ppb_double_size(PMF_PB_BUCKET_BOUND));
+		p = ppb_put_uint64(p, PMF_PB_BUCKET_COUNT, bucket[i]);
+		p = ppb_put_double(p, PMF_PB_BUCKET_BOUND,
+			sample->buckets->upper_bound[i]);
+	}
+	err = psb_add_bytes(self->scratch, msg, p - msg) ? 4 : 0;
+
+end:
+	if (msg != buf)
+		prom_free(msg);
+	prom_free(bucket);
+	return err;
+}
+
+/**
+ * @brief PRIVATE Loads a metric as length delimited MetricFamily message.
+ *	Metrics without samples get skipped.
+ */
+static int
+pmf_load_metric_pb(pmf_t *self, prom_metric_t *metric, const char *prefix,
+	bool compact)
+{
+	psb_t *sb = self->scratch;
+	size_t plen = (prefix == NULL) ? 0 : strlen(prefix);
+	size_t nlen = strlen(metric->name);
+	unsigned int type = (metric->type == PROM_COUNTER) ? PMF_PB_TYPE_COUNTER
+		: (metric->type == PROM_GAUGE) ? PMF_PB_TYPE_GAUGE
+		: (metric->type == PROM_HISTOGRAM) ? PMF_PB_TYPE_HISTOGRAM
+		: PMF_PB_TYPE_UNTYPED;
+
+	psb_reset(sb);
+	if (ppb_add_len(sb, PMF_PB_FAMILY_NAME, plen + nlen)
+		|| psb_add_bytes(sb, prefix, plen)
+		|| psb_add_bytes(sb, metric->name, nlen))
+	{
+		return 2;
+	}
+	if (!compact && metric->help != NULL && ppb_add_string(sb,
+		PMF_PB_FAMILY_HELP, metric->help, strlen(metric->help)))
+	{
+		return 3;
+	}
+	if (ppb_add_uint64(sb, PMF_PB_FAMILY_TYPE, type))
+		return 4;
+	size_t header = psb_len(sb);
+
+	if (pthread_rwlock_rdlock(metric->rwlock)) {
+		PROM_WARN(PROM_PTHREAD_RWLOCK_LOCK_ERROR, NULL);
+		return 10;
+	}
+	int err = 0;
+	if (metric->type == PROM_HISTOGRAM) {
+		prom_map_iter_t iter;
+		prom_map_iter_init(&iter, metric->samples);
+		while (err == 0 && prom_map_iter_next(&iter))
+			err = pmf_pb_add_histogram_sample(self, metric, iter.value) ? 6 : 0;
+	} else {
+		size_t count = pms_store_count(&metric->store);
+		for (size_t id = 0; err == 0 && id < count; id++) {
+			err = pmf_pb_add_sample(self, metric,
+				pms_store_get(&metric->store, id)) ? 8 : 0;
+		}
+	}
+	if (pthread_rwlock_unlock(metric->rwlock))
+		PROM_WARN(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR, NULL);
+	if (err || psb_len(sb) == header)
+		return err;
+
+	if (ppb_add_varint(self->string_builder, psb_len(sb))
+		|| psb_add_bytes(self->string_builder, psb_str(sb), psb_len(sb)))
+	{
+		return 9;
+	}
+	return 0;
+}
+
 int
 pmf_load_metric(pmf_t *self, prom_metric_t *metric, const char *prefix,
 	bool compact)
@@ -183,94 +808,195 @@ pmf_load_metric(pmf_t *self, prom_metric_t *metric, const char *prefix,
 	if (self == NULL)
 		return 1;
 	const char *p = (prefix != NULL && strlen(prefix) == 0) ? NULL : prefix;
+	if (self->format == PROM_FORMAT_PROTOBUF)
+		return pmf_load_metric_pb(self, metric, p, compact);
 
-	if (!compact) {
-		if (pmf_load_help(self,p,metric->name,metric->help))
-			return 2;
-		if (pmf_load_type(self,p,metric->name,metric->type))
-			return 3;
-	}
-	for (pll_node_t *current_node = metric->samples->keys->head;
-		current_node != NULL; current_node = current_node->next)
+	if (pmf_load_meta(self, metric, p, compact))
+		return 2;
+	bool more;
+	size_t pos = 0;
+	int err = pmf_load_samples(self, metric, &pos, p, SIZE_MAX, &more);
+	if (err)
+		return err;
+	// OpenMetrics does not allow empty lines.
+	if (self->format == PROM_FORMAT_TEXT
+		&& psb_add_char(self->string_builder, '\n'))
 	{
-		const char *key = (const char *) current_node->item;
-		if (metric->type == PROM_HISTOGRAM) {
-			pms_histogram_t *hist_sample = (pms_histogram_t *)
-				prom_map_get(metric->samples, key);
-			if (hist_sample == NULL)
-				return 4;
-			for (pll_node_t *current_hist_node =
-				hist_sample->l_value_list->head; current_hist_node != NULL;
-				current_hist_node = current_hist_node->next)
+		return 9;
+	}
+	return 0;
+}
+
+void
+pmf_cursor_init(pmf_cursor_t *cursor, pmf_t *self, prom_map_t *collectors,
+	prom_metric_t *scrape_metric, const char *prefix, bool compact)
+{
+	PROM_ASSERT(cursor != NULL);
+	memset(cursor, 0, sizeof(pmf_cursor_t));
+	cursor->formatter = self;
+	cursor->state = (self == NULL || collectors == NULL)
+		? PMF_CURSOR_DONE : PMF_CURSOR_COLLECTOR;
+	prom_map_iter_init(&cursor->citer, collectors);
+	cursor->scrape_metric = scrape_metric;
+	cursor->prefix = (prefix != NULL && strlen(prefix) == 0) ? NULL : prefix;
+	cursor->compact = compact;
+}
+
+/**
+ * @brief PRIVATE Do the next step of the given cursor.
+ */
+static void
+pmf_cursor_step(pmf_cursor_t *cur, size_t limit) {
+	pmf_t *self = cur->formatter;
+	prom_collector_t *c;
+	prom_metric_t *metric;
+	bool more;
+
+	switch (cur->state) {
+		case PMF_CURSOR_COLLECTOR:
+			if (!prom_map_iter_next(&cur->citer)) {
+				cur->state = PMF_CURSOR_DONE;
+				return;
+			}
+			cur->elapsed = 0;
+			c = (prom_collector_t *) cur->citer.value;
+			if (c == NULL) {
+				PROM_WARN("Collector '%s' not found.", cur->citer.key);
+				cur->err++;
+				return;
+			}
+			// Refreshed periodically: the latest snapshot is all we need.
+			if (c->interval > 0) {
+				if (prom_collector_snapshot_load(c, self->format,
+					self->string_builder))
+					cur->err++;
+				return;
+			}
+			prom_map_iter_init(&cur->miter, c->collect_fn(c));
+			cur->state = PMF_CURSOR_METRIC;
+			return;
+		case PMF_CURSOR_METRIC:
+			if (!prom_map_iter_next(&cur->miter)) {
+				cur->state = PMF_CURSOR_COLLECTOR;
+				return;
+			}
+			metric = (prom_metric_t *) cur->miter.value;
+			if (metric == NULL) {
+				PROM_WARN("Collector '%s' has no metric named '%s'.",
+					cur->citer.key, cur->miter.key);
+				cur->err++;
+				return;
+			}
+			// Messages cannot be split: render them as a whole.
+			if (self->format == PROM_FORMAT_PROTOBUF) {
+				if (pmf_load_metric(self, metric, cur->prefix, cur->compact))
+					cur->err++;
+				return;
+			}
+			if (pmf_load_meta(self, metric, cur->prefix, cur->compact)) {
+				cur->err++;
+				return;
+			}
+			cur->sample = 0;
+			cur->state = PMF_CURSOR_SAMPLES;
+			return;
+		case PMF_CURSOR_SAMPLES:
+			metric = (prom_metric_t *) cur->miter.value;
+			if (pmf_load_samples(self, metric, &cur->sample, cur->prefix, limit,
+				&more))
+			{
+				cur->err++;
+				more = false;
+			}
+			if (more)
+				return;
+			if (self->format == PROM_FORMAT_TEXT
+				&& psb_add_char(self->string_builder, '\n'))
 			{
-				const char *hist_key = (const char *) current_hist_node->item;
-				pms_t *sample = (pms_t *)
-					prom_map_get(hist_sample->samples, hist_key);
-				if (sample == NULL)
-					return 5;
-				if (pmf_load_sample(self, sample, p))
-					return 6;
+				cur->err++;
 			}
-		} else {
-			pms_t *sample = (pms_t *) prom_map_get(metric->samples, key);
-			if (sample == NULL)
-				return 7;
-			if (pmf_load_sample(self, sample, p))
-				return 8;
+			cur->state = PMF_CURSOR_METRIC;
+			return;
+		case PMF_CURSOR_DONE:
+			return;
+	}
+}
+
+bool
+pmf_cursor_next(pmf_cursor_t *cur, size_t limit) {
+	PROM_ASSERT(cur != NULL);
+	struct timespec start, end;
+
+	while (cur->state != PMF_CURSOR_DONE
+		&& psb_len(cur->formatter->string_builder) < limit)
+	{
+		if (cur->scrape_metric == NULL) {
+			pmf_cursor_step(cur, limit);
+			continue;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		pmf_cursor_step(cur, limit);
+		int r = clock_gettime(CLOCK_MONOTONIC, &end);
+		time_t s = (r == 0) ? end.tv_sec - start.tv_sec : 0;
+		long ns = (r == 0) ? end.tv_nsec - start.tv_nsec : 0;
+		cur->elapsed += s + ns*1e-9;
+		// Collector done: the next step starts the next one.
+		if (cur->state == PMF_CURSOR_COLLECTOR) {
+			const char *labels[] = { cur->citer.key };
+			prom_gauge_set(cur->scrape_metric, cur->elapsed, labels);
+			cur->elapsed = 0;
 		}
 	}
-	return psb_add_char(self->string_builder, '\n') ? 9 : 0;
+	return cur->state != PMF_CURSOR_DONE;
 }
 
 int
-pmf_load_metrics(pmf_t *self, prom_map_t *collectors,
-	prom_metric_t *scrape_metric, const char *mprefix, bool compact)
+pmf_load_collector(pmf_t *self, const char *name, prom_collector_t *c,
+	prom_metric_t *scrape_metric, const char *prefix, bool compact)
 {
 	PROM_ASSERT(self != NULL);
-	int r = 0;
 	struct timespec start, end;
-	static const char *labels[] = { "" };
+	prom_map_iter_t iter;
+	int err = 0;
 
-	for (pll_node_t *current_node = collectors->keys->head;
-		current_node != NULL; current_node = current_node->next)
-	{
-		if (scrape_metric != NULL)
-			clock_gettime(CLOCK_MONOTONIC, &start);
-
-		const char *cname = (const char *) current_node->item;
-		prom_collector_t *c = (prom_collector_t *)
-			prom_map_get(collectors, cname);
-		if (c == NULL) {
-			PROM_WARN("Collector '%s' not found.", cname);
-			r++;
+	if (c == NULL) {
+		PROM_WARN("Collector '%s' not found.", name);
+		return 1;
+	}
+	if (scrape_metric != NULL)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	prom_map_iter_init(&iter, c->collect_fn(c));
+	while (prom_map_iter_next(&iter)) {
+		prom_metric_t *metric = (prom_metric_t *) iter.value;
+		if (metric == NULL) {
+			PROM_WARN("Collector '%s' has no metric named '%s'.", name,
+				iter.key);
+			err++;
 			continue;
 		}
-
-		prom_map_t *metrics = c->collect_fn(c);
-		if (metrics != NULL) {
-			for (pll_node_t *current_node = metrics->keys->head;
-				current_node != NULL; current_node = current_node->next)
-			{
-				const char *mname = (const char *) current_node->item;
-				prom_metric_t *metric = (prom_metric_t *)
-					prom_map_get(metrics, mname);
-				if (metric == NULL) {
-					PROM_WARN("Collector '%s' has no metric named '%s'.", cname,
-						mname);
-					r++;
-					continue;
-				}
-				r += pmf_load_metric(self,metric,mprefix,compact);
-			}
-		}
-		if (scrape_metric != NULL) {
-			int r = clock_gettime(CLOCK_MONOTONIC, &end);
-			time_t s = (r == 0) ? end.tv_sec - start.tv_sec : 0;
-			long ns = (r == 0) ? end.tv_nsec - start.tv_nsec : 0;
-			double duration = s + ns*1e-9;
-			labels[0] = cname;
-			prom_gauge_set(scrape_metric, duration, labels);
-		}
+		if (pmf_load_metric(self, metric, prefix, compact))
+			err++;
 	}
-	return r;
+	if (scrape_metric != NULL) {
+		int r = clock_gettime(CLOCK_MONOTONIC, &end);
+		time_t s = (r == 0) ? end.tv_sec - start.tv_sec : 0;
+		long ns = (r == 0) ? end.tv_nsec - start.tv_nsec : 0;
+		const char *labels[] = { name };
+		prom_gauge_set(scrape_metric, s + ns*1e-9, labels);
+	}
+	return err;
+}
+
+int
+pmf_load_metrics(pmf_t *self, prom_map_t *collectors,
+	prom_metric_t *scrape_metric, const char *mprefix, bool compact)
+{
+	PROM_ASSERT(self != NULL);
+	pmf_cursor_t cursor;
+
+	pmf_cursor_init(&cursor, self, collectors, scrape_metric, mprefix,
+		compact);
+	while (pmf_cursor_next(&cursor, SIZE_MAX))
+		;
+	return cursor.err;
 }
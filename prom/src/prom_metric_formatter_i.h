@@ -22,6 +22,9 @@
 
 #include <stdbool.h>
 
+// Public
+#include "prom_collector.h"
+
 // Private
 #include "prom_metric_formatter_t.h"
 #include "prom_metric_t.h"
@@ -36,6 +39,16 @@ pmf_t *pmf_new();
  */
 int pmf_destroy(pmf_t *self);
 
+/**
+ * @brief PRIVATE Initialize the given cached rendering as empty.
+ */
+void pmf_line_init(pmf_line_t *line);
+
+/**
+ * @brief PRIVATE Free the data of the given cached rendering.
+ */
+void pmf_line_destroy(pmf_line_t *line);
+
 /**
  * @brief PRIVATE Loads the help text
  */
@@ -59,27 +72,76 @@ int pmf_load_type(pmf_t *self, const char *prefix, const char *name, prom_metric
 int pmf_load_l_value(pmf_t *metric_formatter, const char *name, const char *suffix, size_t label_count, const char **label_keys, const char **label_values);
 
 /**
- * @brief PRIVATE Loads the formatter with a metric sample
+ * @brief PRIVATE Loads the formatter with a metric sample. Its line gets
+ *	rendered only if its value changed since the last time, otherwise the
+ *	previous rendering gets copied.
  */
 int pmf_load_sample(pmf_t *metric_formatter, pms_t *sample, const char *prefix);
 
 /**
- * @brief PRIVATE Loads a metric in the string exposition format
+ * @brief PRIVATE Loads the formatter with all bucket, count and sum samples
+ *	of a histogram sample of the given metric. The lines get generated from
+ *	the metric's name, label keys and bucket keys and the label values of the
+ *	sample. Like samples, they get rendered again only if something got
+ *	observed since the last time.
+ */
+int pmf_load_histogram_sample(pmf_t *metric_formatter, prom_metric_t *metric, pms_histogram_t *sample, const char *prefix);
+
+/**
+ * @brief PRIVATE Loads the HELP and TYPE lines of the given metric as needed
+ *	by the formatter's format. OpenMetrics names the family of a counter
+ *	without its \c _total suffix, and keeps the TYPE line even if compact,
+ *	because otherwise the samples would lose their type. They get rendered
+ *	once and copied afterwards, unless format, prefix or compact change.
+ */
+int pmf_load_meta(pmf_t *self, prom_metric_t *metric, const char *prefix, bool compact);
+
+/**
+ * @brief PRIVATE Loads what terminates an export in the formatter's format,
+ *	i.e. \c "# EOF" for OpenMetrics. Must be called once after all metrics.
+ */
+int pmf_load_end(pmf_t *self);
+
+/**
+ * @brief PRIVATE Loads a metric in the formatter's exposition format.
  */
 int pmf_load_metric(pmf_t *self, prom_metric_t *metric, const char *prefix, bool compact);
 
+/**
+ * @brief PRIVATE Loads all metrics of the given collector.
+ * @param name	Name of the collector.
+ * @param scrape_metric	If not \c NULL, set its sample labeled with \c name to
+ *	the time needed to collect and render the metrics.
+ */
+int pmf_load_collector(pmf_t *self, const char *name, prom_collector_t *collector, prom_metric_t *scrape_metric, const char *prefix, bool compact);
+
 /**
  * @brief PRIVATE Loads the given metrics
  */
 int pmf_load_metrics(pmf_t *self, prom_map_t *collectors, prom_metric_t *scrape_metric, const char *prefix, bool compact);
 
 /**
- * @brief PRIVATE Clear the underlying string_builder
+ * @brief PRIVATE Prepare the given cursor to export all metrics of the given
+ *	collectors piecewise. Arguments are the same as for pmf_load_metrics().
+ */
+void pmf_cursor_init(pmf_cursor_t *cursor, pmf_t *self, prom_map_t *collectors, prom_metric_t *scrape_metric, const char *prefix, bool compact);
+
+/**
+ * @brief PRIVATE Append the next part of the export to the cursor's formatter.
+ *	Stops as soon as the formatter contains at least \c limit bytes, however
+ *	HELP, TYPE and sample lines never get split.
+ * @return \c false if the export is complete, \c true otherwise.
+ */
+bool pmf_cursor_next(pmf_cursor_t *cursor, size_t limit);
+
+/**
+ * @brief PRIVATE Clear the underlying string_builder, but keep its buffer.
  */
 int pmf_clear(pmf_t *self);
 
 /**
- * @brief PRIVATE Returns the string built by prom_metric_formatter
+ * @brief PRIVATE Returns a copy of the string built by prom_metric_formatter
+ *	and clears it.
  */
 char *pmf_dump(pmf_t *metric_formatter);
 
@@ -18,11 +18,71 @@
 #ifndef PROM_METRIC_FORMATTER_T_H
 #define PROM_METRIC_FORMATTER_T_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Public
+#include "prom_metric.h"
 #include "prom_string_builder.h"
 
+// Private
+#include "prom_map_t.h"
+
 typedef struct pmf {
 	psb_t *string_builder;
 	psb_t *err_builder;
+	/** Buffers a protocol buffer message until its size is known. */
+	psb_t *scratch;
+	prom_format_t format;		/**< what to render */
 } pmf_t;
 
+/**
+ * @brief PRIVATE The last rendering of a sample or of the HELP and TYPE lines
+ *	of a metric. Most series do not change between two scrapes, so their
+ *	lines get spliced into the export instead of being rendered again.
+ */
+typedef struct pmf_line {
+	atomic_flag lock;		/**< guards the members below */
+	/** Length of the l_value at the start of data, if it can be reused for
+		another value of the same series, \c 0 otherwise. */
+	uint16_t head;
+	prom_format_t format;	/**< the format data is rendered in */
+	uint64_t key;			/**< the value(s) rendered, e.g. a sample value's
+								bits */
+	/** The metric name prefix rendered, compared by address: it is owned by
+		the registry, which outlives the metrics it exports. */
+	const char *prefix;
+	uint32_t len;			/**< length of data */
+	uint32_t size;			/**< allocated size of data */
+	char *data;				/**< the rendered text or NULL */
+} pmf_line_t;
+
+/** @brief PRIVATE What a pmf_cursor_t renders next. */
+typedef enum pmf_cursor_state {
+	PMF_CURSOR_COLLECTOR,	/**< collect the metrics of the next collector */
+	PMF_CURSOR_METRIC,		/**< HELP and TYPE lines of the next metric */
+	PMF_CURSOR_SAMPLES,		/**< samples of the current metric */
+	PMF_CURSOR_DONE
+} pmf_cursor_state_t;
+
+/**
+ * @brief PRIVATE Position within the export of all metrics of a map of
+ *	collectors. Lets one render the export piecewise, so that it never needs
+ *	to be buffered as a whole.
+ */
+typedef struct pmf_cursor {
+	pmf_t *formatter;			/**< where to render to */
+	pmf_cursor_state_t state;
+	prom_map_iter_t citer;		/**< the collectors */
+	prom_map_iter_t miter;		/**< the metrics of the current collector */
+	size_t sample;				/**< position of the next sample of the
+									current metric, see pmf_load_samples() */
+	prom_metric_t *scrape_metric;	/**< per collector durations or NULL */
+	double elapsed;				/**< time spent on the current collector */
+	const char *prefix;
+	bool compact;
+	int err;					/**< number of errors so far */
+} pmf_cursor_t;
+
 #endif  // PROM_METRIC_FORMATTER_T_H
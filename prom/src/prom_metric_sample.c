@@ -15,35 +15,301 @@
  * limitations under the License.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
 #include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
 
 // Private
+#include "prom_arena_i.h"
 #include "prom_assert.h"
 #include "prom_errors.h"
+#include "prom_intern_i.h"
 #include "prom_log.h"
+#include "prom_metric_formatter_i.h"
 #include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
 
+/**
+ * @brief PRIVATE Initialize the given sample, whose value lives at the given
+ *	location. It takes over the given l_value, if any.
+ */
+static void
+pms_init(pms_t *self, prom_metric_type_t type, char *l_val,
+	_Atomic double *r_value)
+{
+	self->type = type;
+	self->l_value = l_val;
+	self->r_value = r_value;
+	atomic_init(&self->stripes, NULL);
+	self->label_values = NULL;
+	pmf_line_init(&self->line);
+}
+
 pms_t *
 pms_new(prom_metric_type_t type, const char *l_val, double r_val) {
-	pms_t *self = (pms_t *) prom_malloc(sizeof(pms_t));
+	// The value goes right behind the sample.
+	pms_t *self = (pms_t *) prom_malloc(sizeof(pms_t) + sizeof(_Atomic double));
 	if (self == NULL)
 		return NULL;
-	self->type = type;
-	self->l_value = prom_strdup(l_val);
-	self->r_value = ATOMIC_VAR_INIT(r_val);
+	_Atomic double *r_value = (_Atomic double *) (self + 1);
+	atomic_init(r_value, r_val);
+	pms_init(self, type, prom_strdup(l_val), r_value);
+	if (self->l_value == NULL) {
+		pms_destroy(self);
+		return NULL;
+	}
+	return self;
+}
+
+/**
+ * @brief PRIVATE Number of the segment of a pms_store_t holding the given id.
+ */
+static inline unsigned int
+pms_store_segment(size_t id) {
+	// segment n starts at id 2^n - 1
+	return (sizeof(long long) * 8 - 1) - __builtin_clzll(id + 1);
+}
+
+pms_t *
+pms_store_get(pms_store_t *store, size_t id) {
+	PROM_ASSERT(store != NULL);
+	unsigned int n = pms_store_segment(id);
+	return &store->cold[n][id - ((1UL << n) - 1)];
+}
+
+size_t
+pms_store_count(pms_store_t *store) {
+	PROM_ASSERT(store != NULL);
+	return atomic_load_explicit(&store->count, memory_order_acquire);
+}
+
+/**
+ * @brief PRIVATE Allocate the next segment of the given store.
+ */
+static int
+pms_store_add_segment(pms_store_t *store) {
+	unsigned int n = store->segment_count;
+	if (n == PMS_STORE_SEGMENTS)
+		return 1;
+	size_t size = (size_t) 1 << n;
+	void *mem = prom_malloc(size * sizeof(_Atomic double)
+		+ PROM_CACHE_LINE_SIZE - 1);
+	pms_t *cold = (pms_t *) prom_malloc(size * sizeof(pms_t));
+	if (mem == NULL || cold == NULL) {
+		prom_free(mem);
+		prom_free(cold);
+		return 2;
+	}
+	uintptr_t a = ((uintptr_t) mem + PROM_CACHE_LINE_SIZE - 1)
+		& ~((uintptr_t) PROM_CACHE_LINE_SIZE - 1);
+	store->hot_mem[n] = mem;
+	store->hot[n] = (_Atomic double *) a;
+	store->cold[n] = cold;
+	store->segment_count++;
+	return 0;
+}
+
+pms_t *
+pms_store_next(pms_store_t *store, prom_metric_type_t type) {
+	PROM_ASSERT(store != NULL);
+	size_t id = atomic_load_explicit(&store->count, memory_order_relaxed);
+	unsigned int n = pms_store_segment(id);
+
+	if (n == store->segment_count && pms_store_add_segment(store))
+		return NULL;
+	size_t i = id - ((1UL << n) - 1);
+	pms_t *self = &store->cold[n][i];
+	atomic_init(&store->hot[n][i], 0.0);
+	pms_init(self, type, NULL, &store->hot[n][i]);
 	return self;
 }
 
 int
-pms_destroy(pms_t *self) {
-	if (self == NULL)
+pms_store_reserve(pms_store_t *store, size_t count) {
+	PROM_ASSERT(store != NULL);
+	// segment n ends at id 2^(n+1) - 2
+	while (count > 0 && pms_store_segment(count - 1) >= store->segment_count) {
+		if (pms_store_add_segment(store))
+			return 1;
+	}
+	return 0;
+}
+
+void
+pms_store_commit(pms_store_t *store) {
+	PROM_ASSERT(store != NULL);
+	atomic_fetch_add_explicit(&store->count, 1, memory_order_release);
+}
+
+void
+pms_store_destroy(pms_store_t *store) {
+	if (store == NULL)
+		return;
+	size_t count = atomic_load(&store->count);
+	for (size_t id = 0; id < count; id++)
+		pms_clear(pms_store_get(store, id));
+	for (unsigned int n = 0; n < store->segment_count; n++) {
+		prom_free(store->cold[n]);
+		prom_free(store->hot_mem[n]);
+		store->cold[n] = NULL;
+		store->hot[n] = NULL;
+		store->hot_mem[n] = NULL;
+	}
+	store->segment_count = 0;
+	atomic_store(&store->count, 0);
+}
+
+const char **
+pms_label_values_new(prom_arena_t *arena, size_t count, const char **values)
+{
+	if (count == 0 || values == NULL)
+		return NULL;
+	if (arena != NULL) {
+		size_t len = count * sizeof(char *);
+		for (size_t i = 0; i < count; i++)
+			len += strlen(values[i]) + 1;
+		const char **copy = (const char **) prom_arena_alloc(arena, len);
+		if (copy == NULL)
+			return NULL;
+		char *s = (char *) (copy + count);
+		for (size_t i = 0; i < count; i++) {
+			copy[i] = s;
+			s = stpcpy(s, values[i]) + 1;
+		}
+		return copy;
+	}
+
+	// NULL terminated, so that it can be released without the count.
+	const char **copy = (const char **)
+		prom_malloc((count + 1) * sizeof(char *));
+	if (copy == NULL)
+		return NULL;
+	for (size_t i = 0; i < count; i++) {
+		if ((copy[i] = prom_intern(values[i])) == NULL) {
+			pms_label_values_free(copy);
+			return NULL;
+		}
+		copy[i + 1] = NULL;
+	}
+	return copy;
+}
+
+void
+pms_label_values_free(const char **values) {
+	if (values == NULL)
+		return;
+	for (const char **v = values; *v != NULL; v++)
+		prom_intern_release(*v);
+	prom_free(values);
+}
+
+bool
+pms_label_values_equal(const char **a, const char **b, size_t count) {
+	// Interned values of the same series compare by address.
+	for (size_t i = 0; i < count; i++) {
+		if (a[i] != b[i] && strcmp(a[i], b[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
+int
+pms_stripe(pms_t *self, unsigned int cell_count) {
+	PROM_ASSERT(self != NULL);
+	if (atomic_load_explicit(&self->stripes, memory_order_relaxed) != NULL
+		|| cell_count < 2)
+	{
 		return 0;
+	}
+	void *mem = prom_malloc(sizeof(pms_stripes_t)
+		+ cell_count * sizeof(pms_cell_t) + PROM_CACHE_LINE_SIZE - 1);
+	if (mem == NULL)
+		return 1;
+	uintptr_t a = ((uintptr_t) mem + PROM_CACHE_LINE_SIZE - 1)
+		& ~((uintptr_t) PROM_CACHE_LINE_SIZE - 1);
+	pms_stripes_t *stripes = (pms_stripes_t *) a;
+	stripes->mem = mem;
+	stripes->count = cell_count;
+	for (unsigned int i = 0; i < cell_count; i++)
+		atomic_init(&stripes->cells[i].value, 0.0);
+	// Concurrent updates see either no cells or all of them.
+	atomic_store_explicit(&self->stripes, stripes, memory_order_release);
+	return 0;
+}
+
+/**
+ * @brief PRIVATE Get the cells of the given sample or \c NULL, if it is not
+ *	striped.
+ */
+static inline pms_stripes_t *
+pms_stripes(pms_t *self) {
+	return atomic_load_explicit(&self->stripes, memory_order_acquire);
+}
+
+/**
+ * @brief PRIVATE Get the cell of the given stripes the calling thread should
+ *	update. If the CPU the thread is running on can be determined cheaply
+ *	(Linux' sched_getcpu() is served by rseq or the vDSO), use the cell of
+ *	this CPU, otherwise fall back to a per-thread stripe assigned round robin.
+ */
+static inline pms_cell_t *
+pms_cell(pms_stripes_t *stripes) {
+	static atomic_uint next_stripe = ATOMIC_VAR_INIT(0);
+	static _Thread_local unsigned int stripe = UINT32_MAX;
+
+#ifdef __linux__
+	int cpu = sched_getcpu();
+	if (cpu >= 0)
+		return &stripes->cells[(unsigned int) cpu % stripes->count];
+#endif
+	if (stripe == UINT32_MAX)
+		stripe = atomic_fetch_add(&next_stripe, 1);
+	return &stripes->cells[stripe % stripes->count];
+}
+
+/**
+ * @brief PRIVATE Get the value of the given sample, the calling thread should
+ *	add to.
+ */
+static inline _Atomic double *
+pms_value(pms_t *self) {
+	pms_stripes_t *stripes = pms_stripes(self);
+	return (stripes == NULL) ? self->r_value : &pms_cell(stripes)->value;
+}
+
+static inline void
+pms_atomic_add(_Atomic double *v, double r_value) {
+	double old = atomic_load_explicit(v, memory_order_relaxed);
+	while (!atomic_compare_exchange_weak(v, &old, old + r_value))
+		;
+}
+
+void
+pms_clear(pms_t *self) {
+	if (self == NULL)
+		return;
 	prom_free((void *) self->l_value);
 	self->l_value = NULL;
+	pms_label_values_free(self->label_values);
+	self->label_values = NULL;
+	pms_stripes_t *stripes = atomic_exchange(&self->stripes, NULL);
+	if (stripes != NULL)
+		prom_free(stripes->mem);
+	pmf_line_destroy(&self->line);
+}
+
+int
+pms_destroy(pms_t *self) {
+	if (self == NULL)
+		return 0;
+	pms_clear(self);
 	prom_free((void *) self);
 	return 0;
 }
@@ -63,38 +329,49 @@ pms_add(pms_t *self, double r_value) {
 	PROM_ASSERT(self != NULL);
 	if (r_value < 0)
 		return 1;
-	_Atomic double old = atomic_load(&self->r_value);
-	for (;;) {
-		_Atomic double new = ATOMIC_VAR_INIT(old + r_value);
-		if (atomic_compare_exchange_weak(&self->r_value, &old, new))
-			return 0;
-	}
+	pms_atomic_add(pms_value(self), r_value);
+	return 0;
 }
 
 int
 pms_sub(pms_t *self, double r_value) {
 	PROM_ASSERT(self != NULL);
 	if (self->type != PROM_GAUGE) {
-		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s = %s",
-			self->type, self->l_value, self->r_value);
+		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s = %g",
+			self->type, (self->l_value == NULL) ? "" : self->l_value,
+			pms_get(self));
 		return 1;
 	}
-	_Atomic double old = atomic_load(&self->r_value);
-	for (;;) {
-		_Atomic double new = ATOMIC_VAR_INIT(old - r_value);
-		if (atomic_compare_exchange_weak(&self->r_value, &old, new))
-			return 0;
-	}
+	pms_atomic_add(pms_value(self), -r_value);
+	return 0;
 }
 
 int
 pms_set(pms_t *self, double r_value) {
 	if (self->type != PROM_GAUGE && (self->type != PROM_COUNTER || r_value < 0))
 	{
-		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s = %s",
-			self->type, self->l_value, self->r_value);
+		PROM_WARN(PROM_METRIC_INCORRECT_TYPE " (%d) - %s = %g",
+			self->type, (self->l_value == NULL) ? "" : self->l_value,
+			pms_get(self));
 		return 1;
 	}
-	atomic_store(&self->r_value, r_value);
+	// Not atomic wrt. concurrent additions to a striped sample, but a reset
+	// racing with increments has no well defined result anyway.
+	pms_stripes_t *stripes = pms_stripes(self);
+	for (unsigned int i = 0; stripes != NULL && i < stripes->count; i++)
+		atomic_store(&stripes->cells[i].value, 0.0);
+	atomic_store(self->r_value, r_value);
 	return 0;
 }
+
+double
+pms_get(pms_t *self) {
+	PROM_ASSERT(self != NULL);
+	double v = atomic_load(self->r_value);
+	pms_stripes_t *stripes = pms_stripes(self);
+	for (unsigned int i = 0; stripes != NULL && i < stripes->count; i++) {
+		v += atomic_load_explicit(&stripes->cells[i].value,
+			memory_order_relaxed);
+	}
+	return v;
+}
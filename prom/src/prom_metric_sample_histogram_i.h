@@ -18,16 +18,36 @@
 #ifndef PROM_METRIC_HISTOGRAM_SAMPLE_I_H
 #define PROM_METRIC_HISTOGRAM_SAMPLE_I_H
 
+#include <stdint.h>
+
 // Public
 #include "prom_metric_sample_histogram.h"
 
 // Private
 #include "prom_metric_sample_histogram_t.h"
+#include "prom_arena_i.h"
+#include "prom_pool_i.h"
+
+/**
+ * @brief PRIVATE Get the size of a sample of a histogram with the given
+ *	buckets, i.e. the object size of a pool for its samples.
+ */
+size_t pms_histogram_size(phb_t *buckets);
 
 /**
  * @brief PRIVATE Create a pointer to a pms_histogram_t
+ * @param pool	The pool to get the sample from. If \c NULL, it gets
+ *	allocated on its own. Otherwise the pool needs to live as long as the
+ *	sample.
+ * @param arena	If not \c NULL, the arena to copy the label values to. The
+ *	caller needs to clear \c label_values before destroying such a sample.
+ * @param buckets	The buckets of the metric. Not copied, so they need to
+ *	live as long as the sample.
+ * @param label_count	The number of labels of the metric.
+ * @param label_values	The label values of the sample, get interned or copied
+ *	to the arena.
  */
-pms_histogram_t *pms_histogram_new(const char *name, phb_t *buckets, size_t label_count, const char **label_keys, const char **label_vales);
+pms_histogram_t *pms_histogram_new(prom_pool_t *pool, prom_arena_t *arena, phb_t *buckets, size_t label_count, const char **label_values);
 
 /**
  * @brief PRIVATE Destroy a pms_histogram_t
@@ -41,4 +61,15 @@ int pms_histogram_destroy_generic(void *gen);
 
 void pms_histogram_free_generic(void *gen);
 
+/**
+ * @brief PRIVATE Get a consistent snapshot of the given histogram sample.
+ * @param self		The histogram sample to read.
+ * @param bucket	Where to store the \c bucket_count + 1 cumulative bucket
+ *	counts. The last one is the +Inf bucket.
+ * @param count		Where to store the number of observations.
+ * @param sum		Where to store the sum of all observed values.
+ * @return Non-zero integer value upon failure, \c 0 otherwise.
+ */
+int pms_histogram_snapshot(pms_histogram_t *self, uint64_t *bucket, uint64_t *count, double *sum);
+
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_I_H
@@ -16,25 +16,48 @@
  */
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 // Public
 #include "prom_histogram_buckets.h"
 #include "prom_metric_sample_histogram.h"
 
 // Private
-#include "prom_map_t.h"
 #include "prom_metric_formatter_t.h"
+#include "prom_pool_i.h"
 
 #ifndef PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 #define PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 
+/**
+ * @brief One of the two sets of counters of a histogram sample.
+ * All bucket counts are non-cumulative, the last one is the +Inf bucket.
+ */
+typedef struct pms_histogram_counts {
+	_Atomic uint64_t count;		/**< number of completed observations */
+	_Atomic double sum;
+	_Atomic uint64_t *bucket;	/**< bucket_count + 1 counters */
+} pms_histogram_counts_t;
+
+/**
+ * @brief Observers always update the "hot" counts. A scrape flips the hot
+ * index (highest bit of count_and_hot_idx), waits until all observations
+ * started on the now "cold" counts are completed, reads them and finally
+ * merges them into the hot counts. So count, sum and buckets reported
+ * always belong together (same approach as the Go client library).
+ */
 struct pms_histogram {
-	pll_t *l_value_list;
-	prom_map_t *l_values;
-	prom_map_t *samples;
-	pmf_t *metric_formatter;
-	phb_t *buckets;
-	pthread_rwlock_t *rwlock;
+	_Atomic uint64_t count_and_hot_idx;	/**< started observations | hot idx */
+	pms_histogram_counts_t counts[2];
+	phb_t *buckets;					/**< shared by all samples of a metric */
+	size_t bucket_count;			/**< number of buckets without +Inf */
+	const char **label_values;	/**< interned label values or NULL */
+	pthread_mutex_t lock;	/**< serializes snapshots */
+	pmf_line_t line;		/**< the last rendering of all its lines */
+	prom_pool_t *pool;		/**< the pool it came from or NULL */
+	/** storage for both counts' buckets, allocated with the sample */
+	_Atomic uint64_t bucket_mem[];
 };
 
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_T_H
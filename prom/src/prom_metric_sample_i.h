@@ -15,6 +15,9 @@
  * limitations under the License.
  */
 
+#include <stdbool.h>
+
+#include "prom_arena_i.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
 
@@ -31,7 +34,80 @@
 pms_t *pms_new(prom_metric_type_t type, const char *l_value, double r_value);
 
 /**
- * @brief PRIVATE Destroy the pms
+ * @brief PRIVATE Get the sample with the given id, which must be less than
+ *	pms_store_count().
+ */
+pms_t *pms_store_get(pms_store_t *store, size_t id);
+
+/**
+ * @brief PRIVATE Get the number of samples in the given store. Samples with a
+ *	lower id can be used without locking.
+ */
+size_t pms_store_count(pms_store_t *store);
+
+/**
+ * @brief PRIVATE Initialize the next sample of the given store. Needs to be
+ *	serialized with other modifications of the store. The sample gets
+ *	published by pms_store_commit(), or can be dropped using pms_clear().
+ *	It has no l_value: its lines get rendered from the label keys of its
+ *	metric and its label values.
+ * @return \c NULL on error.
+ */
+pms_t *pms_store_next(pms_store_t *store, prom_metric_type_t type);
+
+/**
+ * @brief PRIVATE Allocate the segments needed to hold the given number of
+ *	samples, so that pms_store_next() doesn't allocate anything up to this
+ *	number.
+ * @return A non-zero value on error, \c 0 otherwise.
+ */
+int pms_store_reserve(pms_store_t *store, size_t count);
+
+/**
+ * @brief PRIVATE Publish the sample returned by pms_store_next().
+ */
+void pms_store_commit(pms_store_t *store);
+
+/**
+ * @brief PRIVATE Free all samples of the given store and its memory.
+ */
+void pms_store_destroy(pms_store_t *store);
+
+/**
+ * @brief PRIVATE Stripe the given sample, i.e. spread its additions over the
+ *	given number of cache line sized cells. A no-op if already striped.
+ * @return Non-zero integer value upon failure, \c 0 otherwise.
+ */
+int pms_stripe(pms_t *self, unsigned int cell_count);
+
+/**
+ * @brief PRIVATE Copy the given label values. If \c arena is \c NULL, the
+ *	copy is a \c NULL terminated array of interned strings (see
+ *	prom_intern()), which needs to be freed using pms_label_values_free().
+ *	Otherwise the array and the strings get copied into the arena.
+ * @return \c NULL if \c count is \c 0 or on error.
+ */
+const char **pms_label_values_new(prom_arena_t *arena, size_t count, const char **values);
+
+/**
+ * @brief PRIVATE Free label values returned by pms_label_values_new() without
+ *	an arena.
+ */
+void pms_label_values_free(const char **values);
+
+/**
+ * @brief PRIVATE Check, whether the given label values are equal.
+ */
+bool pms_label_values_equal(const char **a, const char **b, size_t count);
+
+/**
+ * @brief PRIVATE Free everything the given sample refers to, but not the
+ *	sample itself, e.g. because it is part of a pms_store_t.
+ */
+void pms_clear(pms_t *self);
+
+/**
+ * @brief PRIVATE Destroy a pms created by pms_new()
  */
 int pms_destroy(pms_t *self);
 
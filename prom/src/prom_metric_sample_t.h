@@ -21,10 +21,39 @@
 #include "prom_metric_sample.h"
 #include "prom_metric_t.h"
 
+/** @brief PRIVATE Assumed size of a CPU cache line in bytes. */
+#define PROM_CACHE_LINE_SIZE 64
+
+/**
+ * @brief PRIVATE A cache line sized part of a striped sample value. Each
+ *	thread or CPU updates its own cell only, so they do not fight for the same
+ *	cache line.
+ */
+typedef struct pms_cell {
+	_Alignas(PROM_CACHE_LINE_SIZE) _Atomic double value;
+	char pad[PROM_CACHE_LINE_SIZE - sizeof(_Atomic double)];
+} pms_cell_t;
+
+/**
+ * @brief PRIVATE The cells of a striped sample. Samples may get striped while
+ *	they are updated, so the cells and their count get published together.
+ */
+typedef struct pms_stripes {
+	void *mem;					/**< the allocated memory holding it */
+	unsigned int count;			/**< number of cells */
+	pms_cell_t cells[];			/**< cache line aligned value deltas */
+} pms_stripes_t;
+
 struct pms {
 	prom_metric_type_t type;	/**< metric type for the sample */
-	char *l_value;				/**< full metric name and label set as a str */
-	_Atomic double r_value;		/**< value of the metric sample */
+	/** Value of the metric sample. Lives in the hot array of the metric's
+		pms_store_t, or right behind a sample created by pms_new(). */
+	_Atomic double *r_value;
+	/** Full metric name and label set as a str, only set by pms_new(). */
+	char *l_value;
+	const char **label_values;	/**< interned label values or NULL */
+	pms_stripes_t *_Atomic stripes;	/**< the cells or NULL if not striped */
+	pmf_line_t line;			/**< the last rendering of the sample */
 };
 
 #endif  // PROM_METRIC_SAMPLE_T_H
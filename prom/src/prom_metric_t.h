@@ -19,6 +19,8 @@
 #define PROM_METRIC_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 // Public
 #include "prom_histogram_buckets.h"
@@ -27,7 +29,9 @@
 // Private
 #include "prom_map_i.h"
 #include "prom_map_t.h"
+#include "prom_arena_t.h"
 #include "prom_metric_formatter_t.h"
+#include "prom_pool_t.h"
 
 /**
  * @brief PRIVATE Contains metric type constants
@@ -45,6 +49,28 @@ typedef enum prom_metric_type {
  */
 extern const char *prom_metric_type_map[5];
 
+/**
+ * @brief PRIVATE Max. number of segments of a pms_store_t. Segment \c n has
+ *	room for \c 1 << n series.
+ */
+#define PMS_STORE_SEGMENTS 32
+
+/**
+ * @brief PRIVATE The samples of a counter, gauge or untyped metric as a
+ *	structure of arrays indexed by series id. The values the instrumented code
+ *	updates are packed into cache line aligned "hot" arrays. Everything only
+ *	needed to look them up and to render them lives in "cold" arrays of
+ *	pms_t. Segments never move, so samples can be used without locking.
+ */
+typedef struct pms_store {
+	_Atomic size_t count;		/**< number of series, published after the
+									series got initialized */
+	unsigned int segment_count;	/**< number of allocated segments */
+	pms_t *cold[PMS_STORE_SEGMENTS];	/**< the samples */
+	_Atomic double *hot[PMS_STORE_SEGMENTS];	/**< their values */
+	void *hot_mem[PMS_STORE_SEGMENTS];	/**< allocated memory of hot */
+} pms_store_t;
+
 /**
  * @brief PRIVATE An opaque struct to users containing metric metadata; one or
  *	more metric samples; and a metric formatter for locating metric samples
@@ -54,12 +80,30 @@ struct prom_metric {
 	prom_metric_type_t type;	/**< metric type */
 	const char *name;			/**< metric name */
 	const char *help;			/**< metric help */
-	prom_map_t *samples;		/**< collected samples */
+	prom_map_t *samples;		/**< collected samples by label values */
+	pms_store_t store;			/**< the samples unless a histogram */
 	phb_t *buckets;				/**< histogram bucket upper bound values */
 	size_t label_key_count;		/**< number of labels */
 	pmf_t *formatter;			/**< metric formatter  */
 	pthread_rwlock_t *rwlock;	/**< lock support non-atomic ops */
 	const char **label_keys;	/**< labels **/
+	void *unlabeled;			/**< pms_t or pms_histogram_t bound at
+									construction if label_key_count == 0 */
+	unsigned int stripes;		/**< number of cells per sample, 0 if not
+									striped */
+	pmf_line_t meta;			/**< the last rendering of HELP and TYPE */
+	prom_pool_t pool;			/**< the samples of a histogram */
+	size_t capacity;			/**< max. number of series, 0 if unlimited */
+	prom_arena_t labels;		/**< label storage if capacity is set */
+	/** Max. number of series besides the overflow series, 0 if unlimited. */
+	_Atomic size_t max_series;
+	/** The series new label sets get folded into, once max_series is
+		reached. Created on first use. */
+	void *overflow;
+	_Atomic bool folding;		/**< whether new label sets get folded */
+	/** New series folded into the overflow series or rejected due to
+		capacity. */
+	_Atomic uint64_t dropped;
 };
 
 #endif  // PROM_METRIC_T_H
@@ -0,0 +1,132 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_pool_i.h"
+#include "prom_pool_t.h"
+
+int
+prom_pool_init(prom_pool_t *self, size_t size, size_t max) {
+	if (self == NULL || size == 0 || max == 0)
+		return 1;
+	memset(self, 0, sizeof(prom_pool_t));
+	if (pthread_mutex_init(&self->lock, NULL)) {
+		PROM_WARN(PROM_PTHREAD_MUTEX_INIT_ERROR, NULL);
+		return 2;
+	}
+	self->size = (size + PROM_POOL_ALIGN - 1) & ~(PROM_POOL_ALIGN - 1);
+	self->max = max;
+	return 0;
+}
+
+void
+prom_pool_destroy(prom_pool_t *self) {
+	if (self == NULL || self->size == 0)
+		return;
+	while (self->slabs != NULL) {
+		prom_pool_slab_t *slab = self->slabs;
+		self->slabs = slab->next;
+		prom_free(slab);
+	}
+	self->free = NULL;
+	self->slab_count = 0;
+	pthread_mutex_destroy(&self->lock);
+	self->size = 0;
+}
+
+/**
+ * @brief PRIVATE Allocate a slab with the given number of objects and put
+ *	them on the free list. The caller must hold the lock.
+ */
+static int
+prom_pool_add_slab(prom_pool_t *self, size_t n) {
+	prom_pool_slab_t *slab = (prom_pool_slab_t *)
+		prom_malloc(sizeof(prom_pool_slab_t) + n * self->size);
+	if (slab == NULL)
+		return 1;
+	slab->next = self->slabs;
+	self->slabs = slab;
+	self->slab_count++;
+
+	char *obj = (char *) (slab + 1);
+	for (size_t i = 0; i < n; i++, obj += self->size) {
+		*(void **) obj = self->free;
+		self->free = obj;
+	}
+	return 0;
+}
+
+/**
+ * @brief PRIVATE Allocate the next slab. The caller must hold the lock.
+ */
+static int
+prom_pool_grow(prom_pool_t *self) {
+	size_t n = (self->slab_count < 8 * sizeof(size_t) - 1)
+		? (size_t) 1 << self->slab_count
+		: self->max;
+	return prom_pool_add_slab(self, (n > self->max) ? self->max : n);
+}
+
+int
+prom_pool_reserve(prom_pool_t *self, size_t count) {
+	if (count == 0)
+		return 0;
+	if (pthread_mutex_lock(&self->lock)) {
+		PROM_WARN(PROM_PTHREAD_MUTEX_LOCK_ERROR, NULL);
+		return 1;
+	}
+	int err = prom_pool_add_slab(self, count) ? 2 : 0;
+	if (pthread_mutex_unlock(&self->lock))
+		PROM_WARN(PROM_PTHREAD_MUTEX_UNLOCK_ERROR, NULL);
+	return err;
+}
+
+void *
+prom_pool_alloc(prom_pool_t *self) {
+	void *obj = NULL;
+
+	if (pthread_mutex_lock(&self->lock)) {
+		PROM_WARN(PROM_PTHREAD_MUTEX_LOCK_ERROR, NULL);
+		return NULL;
+	}
+	if (self->free != NULL || prom_pool_grow(self) == 0) {
+		obj = self->free;
+		self->free = *(void **) obj;
+	}
+	if (pthread_mutex_unlock(&self->lock))
+		PROM_WARN(PROM_PTHREAD_MUTEX_UNLOCK_ERROR, NULL);
+	return obj;
+}
+
+void
+prom_pool_free(prom_pool_t *self, void *obj) {
+	if (obj == NULL)
+		return;
+	if (pthread_mutex_lock(&self->lock)) {
+		PROM_WARN(PROM_PTHREAD_MUTEX_LOCK_ERROR, NULL);
+		return;
+	}
+	*(void **) obj = self->free;
+	self->free = obj;
+	if (pthread_mutex_unlock(&self->lock))
+		PROM_WARN(PROM_PTHREAD_MUTEX_UNLOCK_ERROR, NULL);
+}
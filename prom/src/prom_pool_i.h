@@ -0,0 +1,60 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_POOL_I_H
+#define PROM_POOL_I_H
+
+#include <stddef.h>
+
+/**
+ * @brief PRIVATE A pool of fixed size objects (see prom_pool_t.h).
+ */
+typedef struct prom_pool prom_pool_t;
+
+/**
+ * @brief PRIVATE Initialize the given pool.
+ * @param self	The pool to initialize.
+ * @param size	The size of the objects to get from the pool.
+ * @param max	The max. number of objects per slab.
+ * @return \c 0 on success, a non-zero value otherwise.
+ */
+int prom_pool_init(prom_pool_t *self, size_t size, size_t max);
+
+/**
+ * @brief PRIVATE Release all slabs of the given pool. All objects obtained
+ *	from the pool become invalid. A zeroed pool, which never got initialized
+ *	gets ignored.
+ */
+void prom_pool_destroy(prom_pool_t *self);
+
+/**
+ * @brief PRIVATE Add a slab for the given number of objects to the given
+ *	pool, so that as many objects can be obtained without growing the pool.
+ * @return \c 0 on success, a non-zero value otherwise.
+ */
+int prom_pool_reserve(prom_pool_t *self, size_t count);
+
+/**
+ * @brief PRIVATE Get an uninitialized object from the given pool.
+ * @return \c NULL if out of memory.
+ */
+void *prom_pool_alloc(prom_pool_t *self);
+
+/**
+ * @brief PRIVATE Return the given object to the given pool it was obtained
+ *	from. \c NULL is ignored.
+ */
+void prom_pool_free(prom_pool_t *self, void *obj);
+
+#endif  // PROM_POOL_I_H
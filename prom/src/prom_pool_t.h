@@ -0,0 +1,62 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_POOL_T_H
+#define PROM_POOL_T_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Private
+#include "prom_pool_i.h"
+
+/**
+ * @brief PRIVATE Objects of a pool are aligned like any object returned by
+ *	\c malloc(3).
+ */
+#define PROM_POOL_ALIGN _Alignof(max_align_t)
+
+/**
+ * @brief PRIVATE Header of a block, which contains the objects of a pool.
+ */
+typedef union prom_pool_slab {
+	union prom_pool_slab *next;
+	max_align_t align;
+} prom_pool_slab_t;
+
+/**
+ * @brief PRIVATE A free list of fixed size objects, which get carved from
+ * slabs. Slab \c n holds \c 1 << n objects, but not more than \c max. So a
+ * pool with a few objects wastes only a little memory, and one with many
+ * objects needs only a few allocations. Released objects get reused, slabs
+ * get freed when the pool gets destroyed.
+ */
+struct prom_pool {
+	pthread_mutex_t lock;
+	size_t size;		/**< object size, a multiple of PROM_POOL_ALIGN */
+	size_t max;			/**< max. number of objects per slab */
+	unsigned int slab_count;	/**< number of allocated slabs */
+	void *free;			/**< list of free objects, linked via first word */
+	prom_pool_slab_t *slabs;	/**< all allocated slabs */
+};
+
+/**
+ * @brief PRIVATE Static initializer of a pool for objects of the given size
+ *	with at most \c max objects per slab.
+ */
+#define PROM_POOL_INITIALIZER(size, max) { PTHREAD_MUTEX_INITIALIZER, \
+	((size) + PROM_POOL_ALIGN - 1) & ~(PROM_POOL_ALIGN - 1), (max), 0, NULL, \
+	NULL }
+
+#endif  // PROM_POOL_T_H
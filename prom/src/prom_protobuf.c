@@ -0,0 +1,127 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+// Public
+#include "prom_string_builder.h"
+
+// Private
+#include "prom_protobuf_i.h"
+
+/** @brief PRIVATE The key of a field: its number and wire type. */
+#define PPB_KEY(field, wire) ((((uint64_t) (field)) << 3) | (wire))
+
+size_t
+ppb_varint_size(uint64_t value) {
+	size_t n = 1;
+	while (value >= 0x80) {
+		value >>= 7;
+		n++;
+	}
+	return n;
+}
+
+size_t
+ppb_len_size(unsigned int field, size_t len) {
+	return ppb_varint_size(PPB_KEY(field, PPB_WIRE_LEN))
+		+ ppb_varint_size(len) + len;
+}
+
+size_t
+ppb_uint64_size(unsigned int field, uint64_t value) {
+	return ppb_varint_size(PPB_KEY(field, PPB_WIRE_VARINT))
+		+ ppb_varint_size(value);
+}
+
+size_t
+ppb_double_size(unsigned int field) {
+	return ppb_varint_size(PPB_KEY(field, PPB_WIRE_FIXED64)) + 8;
+}
+
+unsigned char *
+ppb_put_varint(unsigned char *p, uint64_t value) {
+	while (value >= 0x80) {
+		*p++ = (unsigned char) (value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (unsigned char) value;
+	return p;
+}
+
+unsigned char *
+ppb_put_len(unsigned char *p, unsigned int field, size_t len) {
+	p = ppb_put_varint(p, PPB_KEY(field, PPB_WIRE_LEN));
+	return ppb_put_varint(p, len);
+}
+
+unsigned char *
+ppb_put_string(unsigned char *p, unsigned int field, const char *str,
+	size_t len)
+{
+	p = ppb_put_len(p, field, len);
+	if (len > 0)
+		memcpy(p, str, len);
+	return p + len;
+}
+
+unsigned char *
+ppb_put_uint64(unsigned char *p, unsigned int field, uint64_t value) {
+	p = ppb_put_varint(p, PPB_KEY(field, PPB_WIRE_VARINT));
+	return ppb_put_varint(p, value);
+}
+
+unsigned char *
+ppb_put_double(unsigned char *p, unsigned int field, double value) {
+	uint64_t bits;
+
+	// Always little endian on the wire.
+	memcpy(&bits, &value, sizeof(bits));
+	p = ppb_put_varint(p, PPB_KEY(field, PPB_WIRE_FIXED64));
+	for (int i = 0; i < 8; i++)
+		*p++ = (unsigned char) (bits >> (8 * i));
+	return p;
+}
+
+int
+ppb_add_varint(psb_t *sb, uint64_t value) {
+	unsigned char buf[PPB_VARINT_MAX];
+	return psb_add_bytes(sb, buf, ppb_put_varint(buf, value) - buf);
+}
+
+int
+ppb_add_len(psb_t *sb, unsigned int field, size_t len) {
+	unsigned char buf[2 * PPB_VARINT_MAX];
+	return psb_add_bytes(sb, buf, ppb_put_len(buf, field, len) - buf);
+}
+
+int
+ppb_add_string(psb_t *sb, unsigned int field, const char *str, size_t len) {
+	if (ppb_add_len(sb, field, len))
+		return 1;
+	return psb_add_bytes(sb, str, len) ? 2 : 0;
+}
+
+int
+ppb_add_uint64(psb_t *sb, unsigned int field, uint64_t value) {
+	unsigned char buf[2 * PPB_VARINT_MAX];
+	return psb_add_bytes(sb, buf, ppb_put_uint64(buf, field, value) - buf);
+}
+
+int
+ppb_add_double(psb_t *sb, unsigned int field, double value) {
+	unsigned char buf[PPB_VARINT_MAX + 8];
+	return psb_add_bytes(sb, buf, ppb_put_double(buf, field, value) - buf);
+}
@@ -0,0 +1,131 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_PROTOBUF_I_H
+#define PROM_PROTOBUF_I_H
+
+/**
+ * @file prom_protobuf_i.h
+ * @brief PRIVATE Minimal protocol buffers encoder, just enough to write
+ *	io.prometheus.client.MetricFamily messages without the protobuf runtime.
+ *
+ * Messages get written front to back, so the size of an embedded message
+ * must be known before its content gets appended. The ppb_*_size()
+ * functions compute the encoded size of the related field.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_string_builder.h"
+
+/** @brief PRIVATE Wire type of varint fields (int32, uint64, enum, ...). */
+#define PPB_WIRE_VARINT 0
+/** @brief PRIVATE Wire type of 64-bit fields (double, fixed64, ...). */
+#define PPB_WIRE_FIXED64 1
+/** @brief PRIVATE Wire type of length delimited fields (string, message). */
+#define PPB_WIRE_LEN 2
+
+/**
+ * @brief PRIVATE Number of bytes needed to encode the given value as varint.
+ */
+size_t ppb_varint_size(uint64_t value);
+
+/**
+ * @brief PRIVATE Encoded size of a length delimited field with a payload of
+ *	the given size.
+ */
+size_t ppb_len_size(unsigned int field, size_t len);
+
+/**
+ * @brief PRIVATE Encoded size of a varint field with the given value.
+ */
+size_t ppb_uint64_size(unsigned int field, uint64_t value);
+
+/**
+ * @brief PRIVATE Encoded size of a double field.
+ */
+size_t ppb_double_size(unsigned int field);
+
+/**
+ * @brief PRIVATE Maximum encoded size of a varint.
+ */
+#define PPB_VARINT_MAX 10
+
+/**
+ * @brief PRIVATE Write the given value as varint without any key to the
+ *	given buffer, which must have room for at least \c PPB_VARINT_MAX bytes.
+ *	The ppb_put_*() functions return the position right after the bytes
+ *	written, so that calls can be chained without any bounds or error checks
+ *	once the size of the whole message is known.
+ */
+unsigned char *ppb_put_varint(unsigned char *p, uint64_t value);
+
+/**
+ * @brief PRIVATE Write the key and length of a length delimited field.
+ */
+unsigned char *ppb_put_len(unsigned char *p, unsigned int field, size_t len);
+
+/**
+ * @brief PRIVATE Write a string field.
+ */
+unsigned char *ppb_put_string(unsigned char *p, unsigned int field,
+	const char *str, size_t len);
+
+/**
+ * @brief PRIVATE Write a varint field.
+ */
+unsigned char *ppb_put_uint64(unsigned char *p, unsigned int field,
+	uint64_t value);
+
+/**
+ * @brief PRIVATE Write a double field.
+ */
+unsigned char *ppb_put_double(unsigned char *p, unsigned int field,
+	double value);
+
+/**
+ * @brief PRIVATE Append the given value as varint without any key.
+ * @return \c 0 on success, a number > 0 otherwise.
+ */
+int ppb_add_varint(psb_t *sb, uint64_t value);
+
+/**
+ * @brief PRIVATE Append the key and length of a length delimited field. The
+ *	caller appends the payload of the given length afterwards.
+ * @return \c 0 on success, a number > 0 otherwise.
+ */
+int ppb_add_len(psb_t *sb, unsigned int field, size_t len);
+
+/**
+ * @brief PRIVATE Append a string field. \c str may be \c NULL if \c len is
+ *	\c 0 .
+ * @return \c 0 on success, a number > 0 otherwise.
+ */
+int ppb_add_string(psb_t *sb, unsigned int field, const char *str, size_t len);
+
+/**
+ * @brief PRIVATE Append a varint field.
+ * @return \c 0 on success, a number > 0 otherwise.
+ */
+int ppb_add_uint64(psb_t *sb, unsigned int field, uint64_t value);
+
+/**
+ * @brief PRIVATE Append a double field.
+ * @return \c 0 on success, a number > 0 otherwise.
+ */
+int ppb_add_double(psb_t *sb, unsigned int field, double value);
+
+#endif  // PROM_PROTOBUF_I_H
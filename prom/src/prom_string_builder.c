@@ -111,9 +111,24 @@ psb_ensure_space(psb_t *self, size_t add_len) {
 	if (str == NULL)
 		return 1;
 	self->str = str;
+	self->allocated = sz;
 	return 0;
 }
 
+int
+psb_reset(psb_t *self) {
+	PROM_ASSERT(self != NULL);
+	self->len = 0;
+	*self->str = '\0';
+	return 0;
+}
+
+int
+psb_reserve(psb_t *self, size_t size) {
+	PROM_ASSERT(self != NULL);
+	return (size > self->len) ? psb_ensure_space(self, size - self->len) : 0;
+}
+
 int
 psb_add_str(psb_t *self, const char *str) {
 	PROM_ASSERT(self != NULL);
@@ -142,6 +157,20 @@ psb_add_char(psb_t *self, char c) {
 	return 0;
 }
 
+int
+psb_add_bytes(psb_t *self, const void *buf, size_t len) {
+	PROM_ASSERT(self != NULL);
+	if (len == 0)
+		return 0;
+	if (psb_ensure_space(self, len))
+		return 1;
+
+	memcpy(self->str + self->len, buf, len);
+	self->len += len;
+	self->str[self->len] = '\0';
+	return 0;
+}
+
 size_t
 psb_len(psb_t *self) {
 	PROM_ASSERT(self != NULL);
@@ -0,0 +1,137 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_log.h"
+#include "prom_worker_pool_i.h"
+#include "prom_worker_pool_t.h"
+
+/**
+ * @brief PRIVATE Main loop of a worker thread.
+ */
+static void *
+pwp_worker(void *arg) {
+	pwp_t *self = (pwp_t *) arg;
+	pwp_job_t *job;
+
+	pthread_mutex_lock(&self->lock);
+	for (;;) {
+		while (self->head == NULL && !self->stop)
+			pthread_cond_wait(&self->ready, &self->lock);
+		if (self->head == NULL)
+			break;
+		job = self->head;
+		self->head = job->next;
+		if (self->head == NULL)
+			self->tail = NULL;
+		pthread_mutex_unlock(&self->lock);
+
+		job->fn(job->arg);
+
+		pthread_mutex_lock(&self->lock);
+	}
+	pthread_mutex_unlock(&self->lock);
+	return NULL;
+}
+
+pwp_t *
+pwp_new(unsigned int threads) {
+	if (threads == 0)
+		return NULL;
+
+	pwp_t *self = (pwp_t *) prom_malloc(sizeof(pwp_t));
+	if (self == NULL)
+		return NULL;
+	memset(self, 0, sizeof(pwp_t));
+	self->threads = (pthread_t *) prom_calloc(threads, sizeof(pthread_t));
+	if (self->threads == NULL)
+		goto fail;
+	if (pthread_mutex_init(&self->lock, NULL))
+		goto fail;
+	if (pthread_cond_init(&self->ready, NULL)) {
+		pthread_mutex_destroy(&self->lock);
+		goto fail;
+	}
+	for (; self->count < threads; self->count++) {
+		if (pthread_create(&self->threads[self->count], NULL, &pwp_worker,
+			self))
+		{
+			PROM_WARN("Failed to start worker %u.", self->count);
+			pwp_destroy(self);
+			return NULL;
+		}
+	}
+	return self;
+
+fail:
+	prom_free(self->threads);
+	prom_free(self);
+	return NULL;
+}
+
+int
+pwp_destroy(pwp_t *self) {
+	int err = 0;
+
+	if (self == NULL)
+		return 0;
+
+	pthread_mutex_lock(&self->lock);
+	self->stop = true;
+	pthread_cond_broadcast(&self->ready);
+	pthread_mutex_unlock(&self->lock);
+	for (unsigned int i = 0; i < self->count; i++)
+		err += pthread_join(self->threads[i], NULL) ? 1 : 0;
+
+	err += pthread_cond_destroy(&self->ready) ? 1 : 0;
+	err += pthread_mutex_destroy(&self->lock) ? 1 : 0;
+	prom_free(self->threads);
+	prom_free(self);
+	return err;
+}
+
+void
+pwp_job_init(pwp_job_t *job, pwp_job_fn *fn, void *arg) {
+	job->fn = fn;
+	job->arg = arg;
+	job->next = NULL;
+}
+
+int
+pwp_submit(pwp_t *self, pwp_job_t *job) {
+	if (self == NULL || job == NULL)
+		return 1;
+
+	job->next = NULL;
+	pthread_mutex_lock(&self->lock);
+	if (self->stop) {
+		pthread_mutex_unlock(&self->lock);
+		return 1;
+	}
+	if (self->tail == NULL)
+		self->head = job;
+	else
+		self->tail->next = job;
+	self->tail = job;
+	pthread_cond_signal(&self->ready);
+	pthread_mutex_unlock(&self->lock);
+	return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_WORKER_POOL_I_H
+#define PROM_WORKER_POOL_I_H
+
+#include <stddef.h>
+
+/**
+ * @file prom_worker_pool_i.h
+ * @brief PRIVATE A fixed set of threads, which run queued jobs in order.
+ */
+
+/** @brief PRIVATE A pool of worker threads. */
+typedef struct pwp pwp_t;
+
+/** @brief PRIVATE A job to be run by a worker. */
+typedef struct pwp_job pwp_job_t;
+
+/**
+ * @brief PRIVATE The function to call to run a job.
+ */
+typedef void pwp_job_fn(void *arg);
+
+/**
+ * @brief PRIVATE Start a new pool with the given number of threads.
+ * @return \c NULL on error.
+ */
+pwp_t *pwp_new(unsigned int threads);
+
+/**
+ * @brief PRIVATE Stop all threads of the given pool and free it. Jobs already
+ *	queued get run before.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int pwp_destroy(pwp_t *self);
+
+/**
+ * @brief PRIVATE Prepare the given job to run the given function.
+ */
+void pwp_job_init(pwp_job_t *job, pwp_job_fn *fn, void *arg);
+
+/**
+ * @brief PRIVATE Queue the given job. It is owned by the caller and must stay
+ *	valid until its function got called. The function is responsible for
+ *	reporting completion to whoever waits for it.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int pwp_submit(pwp_t *self, pwp_job_t *job);
+
+#endif  // PROM_WORKER_POOL_I_H
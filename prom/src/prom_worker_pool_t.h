@@ -0,0 +1,40 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_WORKER_POOL_T_H
+#define PROM_WORKER_POOL_T_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// Private
+#include "prom_worker_pool_i.h"
+
+struct pwp_job {
+	pwp_job_fn *fn;
+	void *arg;
+	struct pwp_job *next;		/**< next job in the queue */
+};
+
+struct pwp {
+	pthread_mutex_t lock;		/**< guards the queue */
+	pthread_cond_t ready;		/**< signaled when jobs got queued */
+	pwp_job_t *head;			/**< the next job to run */
+	pwp_job_t *tail;
+	bool stop;					/**< threads should exit */
+	unsigned int count;			/**< number of threads */
+	pthread_t *threads;
+};
+
+#endif  // PROM_WORKER_POOL_T_H
@@ -0,0 +1,291 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "prom_test_helpers.h"
+#include "prom_epoch_i.h"
+#include "prom_pool_i.h"
+#include "prom_pool_t.h"
+
+typedef struct counting_allocator {
+	size_t mallocs;
+	size_t reallocs;
+	size_t frees;
+} counting_allocator_t;
+
+static counting_allocator_t counts;
+
+static void *
+counting_malloc(size_t size, void *ctx) {
+	((counting_allocator_t *) ctx)->mallocs++;
+	return malloc(size);
+}
+
+static void *
+counting_realloc(void *ptr, size_t size, void *ctx) {
+	((counting_allocator_t *) ctx)->reallocs++;
+	if (ptr == NULL)
+		((counting_allocator_t *) ctx)->mallocs++;
+	return realloc(ptr, size);
+}
+
+static void
+counting_free(void *ptr, void *ctx) {
+	((counting_allocator_t *) ctx)->frees++;
+	free(ptr);
+}
+
+// Must run first, i.e. before the library allocated anything.
+void
+test_prom_set_allocator(void) {
+	const char *keys[] = { "path" };
+	char path[32];
+
+	TEST_ASSERT_NOT_EQUAL(0, prom_set_allocator(counting_malloc, NULL,
+		counting_free, &counts));
+	TEST_ASSERT_EQUAL_INT(0, prom_set_allocator(counting_malloc,
+		counting_realloc, counting_free, &counts));
+
+	prom_histogram_t *h = prom_histogram_new("test_histogram", "test",
+		phb_linear(1.0, 1.0, 5), 1, keys);
+	TEST_ASSERT_NOT_NULL(h);
+	for (int i = 0; i < 100; i++) {
+		sprintf(path, "/%d", i);
+		const char *values[] = { path };
+		TEST_ASSERT_EQUAL_INT(0, prom_histogram_observe(h, i % 7, values));
+	}
+	pmf_t *mf = pmf_new();
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(mf, h, NULL, false));
+	char *result = pmf_dump(mf);
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		"test_histogram_bucket{path=\"/99\",le=\"+Inf\"} 1\n"));
+	prom_free(result);
+	pmf_destroy(mf);
+
+	// The 100 samples came from 7 slabs (1 + 2 + 4 + ... + 64).
+	TEST_ASSERT_EQUAL_UINT(7, h->pool.slab_count);
+	prom_histogram_destroy(h);
+
+	// Everything went through the hooks and got released, except the epoch
+	// record of this thread, which is kept for reuse.
+	TEST_ASSERT_TRUE(counts.mallocs > 0);
+	TEST_ASSERT_TRUE(counts.reallocs > 0);
+	TEST_ASSERT_EQUAL_UINT(counts.mallocs - 1, counts.frees);
+
+	// Too late to switch the allocator now.
+	TEST_ASSERT_NOT_EQUAL(0, prom_set_allocator(counting_malloc,
+		counting_realloc, counting_free, &counts));
+}
+
+#define FIXED_SERIES 16
+
+static const char *fixed_keys[] = { "path" };
+
+/**
+ * @brief Update the series of the given metrics as the hot path would do.
+ * @return The number of failed updates.
+ */
+static int
+update_series(prom_counter_t *c, prom_histogram_t *h, int first, int last) {
+	char path[32];
+	int failed = 0;
+
+	for (int i = first; i < last; i++) {
+		sprintf(path, "/%d", i);
+		const char *values[] = { path };
+		failed += prom_counter_inc(c, values) != 0;
+		failed += prom_histogram_observe(h, i, values) != 0;
+	}
+	return failed;
+}
+
+static void *
+update_thread(void *arg) {
+	prom_metric_t **m = (prom_metric_t **) arg;
+	update_series(m[0], m[1], 0, FIXED_SERIES);
+	return NULL;
+}
+
+void
+test_prom_fixed_capacity(void) {
+	TEST_ASSERT_EQUAL_INT(0, pcr_init(PROM_NONE, NULL));
+	prom_counter_t *c = prom_counter_new("test_counter", "test", 1,
+		fixed_keys);
+	prom_histogram_t *h = prom_histogram_new("test_histogram", "test",
+		phb_linear(1.0, 1.0, 5), 1, fixed_keys);
+	// before and after the budget got set
+	TEST_ASSERT_EQUAL_INT(0, pcr_register_metric(c));
+	TEST_ASSERT_EQUAL_INT(0, pcr_set_capacity(PROM_COLLECTOR_REGISTRY,
+		FIXED_SERIES, 1024, 2));
+	TEST_ASSERT_EQUAL_INT(0, pcr_register_metric(h));
+
+	// Nothing gets allocated anymore - neither for new series nor for a
+	// thread, which updates metrics the first time.
+	size_t allocs = counts.mallocs + counts.reallocs;
+	pthread_t thread;
+	prom_metric_t *m[] = { c, h };
+	TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, update_thread, m));
+	TEST_ASSERT_EQUAL_INT(0, update_series(c, h, 0, FIXED_SERIES));
+	TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, NULL));
+	TEST_ASSERT_EQUAL_INT(0, update_series(c, h, 0, FIXED_SERIES));
+	// Exceeding the capacity fails and gets counted.
+	TEST_ASSERT_EQUAL_INT(6, update_series(c, h, FIXED_SERIES,
+		FIXED_SERIES + 3));
+	TEST_ASSERT_EQUAL_UINT(allocs, counts.mallocs + counts.reallocs);
+	TEST_ASSERT_EQUAL_UINT64(3, prom_metric_dropped(c));
+	TEST_ASSERT_EQUAL_UINT64(3, prom_metric_dropped(h));
+
+	// Once a metric has series, its capacity can't be changed anymore.
+	TEST_ASSERT_NOT_EQUAL(0, prom_metric_set_capacity(c, 32, 2048));
+
+	const char *result = pcr_bridge(PROM_COLLECTOR_REGISTRY);
+	TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{path=\"/15\"} 3\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		"test_histogram_count{path=\"/15\"} 3\n"));
+	TEST_ASSERT_NULL(strstr(result, "/16"));
+	prom_free((char *) result);
+	pcr_destroy(PROM_COLLECTOR_REGISTRY);
+}
+
+void
+test_prom_fixed_capacity_max_series(void) {
+	prom_counter_t *c = prom_counter_new("test_counter", "test", 1,
+		fixed_keys);
+	prom_histogram_t *h = prom_histogram_new("test_histogram", "test",
+		phb_linear(1.0, 1.0, 5), 1, fixed_keys);
+	prom_counter_t *full = prom_counter_new("test_full", "test", 1,
+		fixed_keys);
+	const char *known[] = { "/0" };
+	const char *fresh[] = { "/new" };
+
+	// The overflow series needs room within the capacity - no matter, which
+	// one gets set first.
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_max_series(c, FIXED_SERIES));
+	TEST_ASSERT_NOT_EQUAL(0, prom_metric_set_capacity(c, FIXED_SERIES, 1024));
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_max_series(c,
+		FIXED_SERIES - 1));
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_capacity(c, FIXED_SERIES, 1024));
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_capacity(h, FIXED_SERIES, 1024));
+	TEST_ASSERT_NOT_EQUAL(0, prom_metric_set_max_series(h, FIXED_SERIES));
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_max_series(h,
+		FIXED_SERIES - 1));
+
+	// New series beyond the limit get folded without allocating anything.
+	size_t allocs = counts.mallocs + counts.reallocs;
+	TEST_ASSERT_EQUAL_INT(0, update_series(c, h, 0, FIXED_SERIES + 3));
+	TEST_ASSERT_EQUAL_UINT(allocs, counts.mallocs + counts.reallocs);
+	TEST_ASSERT_EQUAL_UINT(FIXED_SERIES, prom_map_size(c->samples));
+	TEST_ASSERT_EQUAL_UINT(FIXED_SERIES, prom_map_size(h->samples));
+	TEST_ASSERT_EQUAL_UINT64(4, prom_metric_dropped(c));
+	TEST_ASSERT_EQUAL_UINT64(4, prom_metric_dropped(h));
+
+	// A limit set after the capacity got exhausted drops new series.
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_capacity(full, FIXED_SERIES,
+		1024));
+	TEST_ASSERT_EQUAL_INT(0, update_series(full, h, 0, FIXED_SERIES));
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_max_series(full, 4));
+	allocs = counts.mallocs + counts.reallocs;
+	TEST_ASSERT_NOT_EQUAL(0, prom_counter_inc(full, fresh));
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(full, known));
+	TEST_ASSERT_EQUAL_UINT(allocs, counts.mallocs + counts.reallocs);
+	TEST_ASSERT_EQUAL_UINT(FIXED_SERIES, prom_map_size(full->samples));
+	TEST_ASSERT_EQUAL_UINT64(1, prom_metric_dropped(full));
+
+	prom_counter_destroy(full);
+	prom_histogram_destroy(h);
+	prom_counter_destroy(c);
+}
+
+void
+test_prom_periodic_collector(void) {
+	const char *values[] = { "/" };
+	int refreshes = 0;
+	uint64_t refreshed = 0;
+
+	// The scheduler thread shall reuse a record instead of allocating one.
+	TEST_ASSERT_EQUAL_INT(0, prom_epoch_reserve(1));
+	size_t live = counts.mallocs - counts.frees;
+
+	pcr_t *r = pcr_new("periodic");
+	prom_collector_t *c = prom_collector_new("periodic");
+	prom_counter_t *counter = prom_counter_new("periodic_total", "test", 1,
+		fixed_keys);
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(counter, values));
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_add_metric(c, counter));
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_set_interval(c, 10));
+	TEST_ASSERT_EQUAL_INT(0, pcr_register_collector(r, c));
+
+	// Each refresh but the first one retires the previous snapshots.
+	for (int i = 0; i < 500 && refreshes < 3; i++) {
+		uint64_t t = atomic_load(&c->refreshed);
+		if (t != refreshed) {
+			refreshed = t;
+			refreshes++;
+		}
+		usleep(2000);
+	}
+	TEST_ASSERT_EQUAL_INT(3, refreshes);
+	pcr_destroy(r);
+
+	// No reader is left, so all retired snapshots can be freed - and must
+	// have gone through the hooks as well.
+	while (prom_epoch_reclaim() > 0)
+		;
+	TEST_ASSERT_EQUAL_UINT(live, counts.mallocs - counts.frees);
+}
+
+void
+test_prom_pool(void) {
+	prom_pool_t pool;
+	void *obj[10];
+
+	TEST_ASSERT_EQUAL_INT(0, prom_pool_init(&pool, 24, 4));
+	TEST_ASSERT_EQUAL_UINT(32, pool.size);
+	for (int i = 0; i < 10; i++) {
+		obj[i] = prom_pool_alloc(&pool);
+		TEST_ASSERT_NOT_NULL(obj[i]);
+		TEST_ASSERT_EQUAL_UINT(0, (uintptr_t) obj[i] % PROM_POOL_ALIGN);
+		memset(obj[i], i, 24);
+		for (int k = 0; k < i; k++)
+			TEST_ASSERT_TRUE(obj[k] != obj[i]);
+	}
+	// 1 + 2 + 4 + 4 objects
+	TEST_ASSERT_EQUAL_UINT(4, pool.slab_count);
+
+	// Released objects get reused before the pool grows.
+	prom_pool_free(&pool, obj[3]);
+	prom_pool_free(&pool, obj[7]);
+	TEST_ASSERT_EQUAL_PTR(obj[7], prom_pool_alloc(&pool));
+	TEST_ASSERT_EQUAL_PTR(obj[3], prom_pool_alloc(&pool));
+	TEST_ASSERT_NOT_NULL(prom_pool_alloc(&pool));
+	TEST_ASSERT_EQUAL_UINT(4, pool.slab_count);
+	TEST_ASSERT_NOT_NULL(prom_pool_alloc(&pool));
+	TEST_ASSERT_EQUAL_UINT(5, pool.slab_count);
+
+	prom_pool_destroy(&pool);
+	TEST_ASSERT_EQUAL_UINT(0, pool.slab_count);
+}
+
+int
+main(int argc, const char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_prom_set_allocator);
+	RUN_TEST(test_prom_fixed_capacity);
+	RUN_TEST(test_prom_fixed_capacity_max_series);
+	RUN_TEST(test_prom_periodic_collector);
+	RUN_TEST(test_prom_pool);
+	return UNITY_END();
+}
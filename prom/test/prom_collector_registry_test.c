@@ -15,8 +15,11 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE		// memmem
+
 #include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "prom_test_helpers.h"
 #include "prom_log.h"
@@ -65,8 +68,8 @@ test_pcr_must_register(void) {
 	pms_t *test_sample_a = pms_from_labels(test_counter, labels);
 	pms_t *test_sample_b = pms_from_labels(test_gauge, labels);
 
-	TEST_ASSERT_EQUAL_DOUBLE(1.0, test_sample_a->r_value);
-	TEST_ASSERT_EQUAL_DOUBLE(2.0, test_sample_b->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(1.0, *test_sample_a->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(2.0, *test_sample_b->r_value);
 	prom_registry_test_destroy();
 }
 
@@ -94,9 +97,9 @@ test_pcr_bridge(void) {
 		"# TYPE test_gauge gauge",
 		"test_gauge{label=\"foo\"}",
 		"# HELP test_histogram histogram under test",
-		"# TYPE test_histogram histogram\ntest_histogram{le=\"5.0\"}",
-		"test_histogram{le=\"10.0\"}",
-		"test_histogram{le=\"+Inf\"}",
+		"# TYPE test_histogram histogram\ntest_histogram_bucket{le=\"5.0\"}",
+		"test_histogram_bucket{le=\"10.0\"}",
+		"test_histogram_bucket{le=\"+Inf\"}",
 		"test_histogram_count",
 		"test_histogram_sum",
 		"# HELP process_max_fds Max. number of open file descriptors "
@@ -120,6 +123,490 @@ test_pcr_bridge(void) {
 	prom_registry_test_destroy();
 }
 
+/**
+ * @brief Read the whole export of the given cursor using the given chunk size.
+ *	Its length gets stored in \c size unless \c NULL.
+ */
+static char *
+read_cursor_len(pcr_cursor_t *cursor, size_t chunk, size_t *size) {
+	size_t len = 0, max = chunk + 1;
+	char *result = malloc(max);
+	ssize_t n;
+
+	while ((n = pcr_cursor_read(cursor, result + len, chunk)) > 0) {
+		TEST_ASSERT_TRUE(n <= chunk);
+		len += n;
+		while (max - len <= chunk)
+			result = realloc(result, max *= 2);
+	}
+	TEST_ASSERT_EQUAL_INT(0, n);
+	result[len] = '\0';
+	if (size != NULL)
+		*size = len;
+	return result;
+}
+
+static char *
+read_cursor(pcr_cursor_t *cursor, size_t chunk) {
+	return read_cursor_len(cursor, chunk, NULL);
+}
+
+void
+test_pcr_cursor(void) {
+	pcr_t *r = pcr_new("cursor");
+	prom_collector_t *c = pcr_get(r, COLLECTOR_NAME_DEFAULT);
+	const char *label[] = { "label" };
+	prom_counter_t *counter = prom_counter_new("test_counter",
+		"counter under test", 1, label);
+	prom_histogram_t *histogram = prom_histogram_new("test_histogram",
+		"histogram under test", phb_linear(5.0, 5.0, 2), 1, label);
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_add_metric(c, counter));
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_add_metric(c, histogram));
+
+	char value[16];
+	const char *values[] = { value };
+	for (int i = 0; i < 100; i++) {
+		sprintf(value, "v%d", i);
+		prom_counter_add(counter, i, values);
+		prom_histogram_observe(histogram, i, values);
+	}
+
+	// Same output as pcr_bridge(), no matter how it gets chunked.
+	char *expected = pcr_bridge(r);
+	size_t chunks[] = { 1, 7, 100, 4096, 1 << 20 };
+	for (int i = 0; i < 5; i++) {
+		pcr_cursor_t *cursor = pcr_cursor_new(r);
+		TEST_ASSERT_NOT_NULL(cursor);
+		char *result = read_cursor(cursor, chunks[i]);
+		TEST_ASSERT_EQUAL_STRING(expected, result);
+		// Reading after the end is fine.
+		TEST_ASSERT_EQUAL_INT(0, pcr_cursor_read(cursor, result, 1));
+		free(result);
+		pcr_cursor_destroy(cursor);
+	}
+	free(expected);
+
+	// Other formats, too.
+	size_t len, expected_len;
+	for (int f = PROM_FORMAT_PROTOBUF; f < PROM_FORMAT_COUNT; f++) {
+		expected = pcr_export(r, f, 0, &expected_len);
+		TEST_ASSERT_NOT_NULL(expected);
+		for (int i = 0; i < 5; i++) {
+			pcr_cursor_t *cursor = pcr_cursor_new_format(r, f);
+			TEST_ASSERT_NOT_NULL(cursor);
+			char *result = read_cursor_len(cursor, chunks[i], &len);
+			TEST_ASSERT_EQUAL_UINT(expected_len, len);
+			TEST_ASSERT_EQUAL_MEMORY(expected, result, len);
+			free(result);
+			pcr_cursor_destroy(cursor);
+		}
+		if (f == PROM_FORMAT_OPENMETRICS) {
+			TEST_ASSERT_EQUAL_STRING("# EOF\n", expected + expected_len - 6);
+			TEST_ASSERT_NOT_NULL(strstr(expected,
+				"test_counter_total{label=\"v1\"} 1\n"));
+		}
+		free(expected);
+	}
+	TEST_ASSERT_NULL(pcr_cursor_new_format(r, PROM_FORMAT_COUNT));
+
+	// Aborting an export is fine, too.
+	pcr_cursor_t *cursor = pcr_cursor_new(r);
+	TEST_ASSERT_EQUAL_INT(10, pcr_cursor_read(cursor, value, 10));
+	pcr_cursor_destroy(cursor);
+
+	TEST_ASSERT_NULL(pcr_cursor_new(NULL));
+	pcr_destroy(r);
+}
+
+void
+test_pcr_cursor_scrape(void) {
+	prom_registry_test_init();
+	const char *labels[] = {"foo"};
+	prom_counter_inc(test_counter, labels);
+
+	pcr_cursor_t *cursor = pcr_cursor_new(PROM_COLLECTOR_REGISTRY);
+	char *result = read_cursor(cursor, 16);
+	pcr_cursor_destroy(cursor);
+	TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"foo\"} 1\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result, "process_max_fds"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		METRIC_NAME_SCRAPE "{collector=\"" METRIC_LABEL_SCRAPE "\"}"));
+	free(result);
+	prom_registry_test_destroy();
+}
+
+static void *
+bridge_thread(void *arg) {
+	pcr_t *r = (pcr_t *) arg;
+	const char *expected = pcr_bridge(r);
+	void *result = NULL;
+	for (int i = 0; i < 200 && result == NULL; i++) {
+		char *s = pcr_bridge(r);
+		if (strcmp(expected, s) != 0)
+			result = (void *) 1;
+		free(s);
+	}
+	free((char *) expected);
+	return result;
+}
+
+void
+test_pcr_bridge_concurrent(void) {
+	pcr_t *r = pcr_new("concurrent");
+	const char *label[] = { "label" };
+	prom_counter_t *counter = prom_counter_new("test_counter",
+		"counter under test", 1, label);
+	TEST_ASSERT_EQUAL_INT(0,
+		prom_collector_add_metric(pcr_get(r, COLLECTOR_NAME_DEFAULT), counter));
+	char value[16];
+	const char *values[] = { value };
+	for (int i = 0; i < 1000; i++) {
+		sprintf(value, "v%d", i);
+		prom_counter_add(counter, i, values);
+	}
+
+	// Concurrent scrapes must not garble each other's output.
+	pthread_t threads[4];
+	for (int i = 0; i < 4; i++)
+		pthread_create(&threads[i], NULL, bridge_thread, r);
+	for (int i = 0; i < 4; i++) {
+		void *result;
+		pthread_join(threads[i], &result);
+		TEST_ASSERT_NULL(result);
+	}
+	TEST_ASSERT_TRUE(r->formatter_count > 0);
+	TEST_ASSERT_TRUE(r->bridge_size > 0);
+	pcr_destroy(r);
+}
+
+static atomic_int slow_running, slow_peak, slow_rendezvous;
+
+static prom_map_t *
+slow_collect(prom_collector_t *self) {
+	int running = atomic_fetch_add(&slow_running, 1) + 1;
+	int peak = atomic_load(&slow_peak);
+	while (running > peak
+		&& !atomic_compare_exchange_weak(&slow_peak, &peak, running))
+		;
+	// Wait until the given number of collectors runs at the same time.
+	for (int i = 0; i < 500
+		&& atomic_load(&slow_running) < atomic_load(&slow_rendezvous); i++)
+	{
+		usleep(10000);
+	}
+	usleep(50000);
+	atomic_fetch_sub(&slow_running, 1);
+	return self->metrics;
+}
+
+void
+test_pcr_workers(void) {
+	pcr_t *r = pcr_new("workers");
+	const char *label[] = { "label" };
+	const char *values[] = { "v" };
+	char name[32];
+	for (int i = 0; i < 4; i++) {
+		sprintf(name, "slow%d", i);
+		prom_collector_t *c = prom_collector_new(name);
+		prom_collector_set_collect_fn(c, &slow_collect);
+		sprintf(name, "slow%d_total", i);
+		prom_counter_t *counter = prom_counter_new(name, "slow counter", 1,
+			label);
+		prom_counter_add(counter, i, values);
+		TEST_ASSERT_EQUAL_INT(0, prom_collector_add_metric(c, counter));
+		TEST_ASSERT_EQUAL_INT(0, pcr_register_collector(r, c));
+	}
+
+	// Byte-for-byte the same export, but collectors run concurrently.
+	char *expected, *result;
+	expected = pcr_bridge(r);
+	TEST_ASSERT_EQUAL_INT(1, atomic_load(&slow_peak));
+	TEST_ASSERT_EQUAL_INT(0, pcr_set_workers(r, 4));
+	atomic_store(&slow_peak, 0);
+	atomic_store(&slow_rendezvous, 4);
+	result = pcr_bridge(r);
+	atomic_store(&slow_rendezvous, 0);
+	TEST_ASSERT_EQUAL_INT(4, atomic_load(&slow_peak));
+	TEST_ASSERT_EQUAL_STRING(expected, result);
+	free(result);
+	pcr_cursor_t *cursor = pcr_cursor_new(r);
+	result = read_cursor(cursor, 100);
+	pcr_cursor_destroy(cursor);
+	TEST_ASSERT_EQUAL_STRING(expected, result);
+	free(result);
+	free(expected);
+
+	// Each collector still gets timed on its own.
+	TEST_ASSERT_EQUAL_INT(0, pcr_enable_scrape_metrics(r));
+	r->features |= PROM_SCRAPETIME_ALL;
+	result = pcr_bridge(r);
+	for (int i = 0; i < 4; i++) {
+		sprintf(name, "{collector=\"slow%d\"} 0.0", i);
+		TEST_ASSERT_NOT_NULL(strstr(result, name));
+	}
+	free(result);
+
+	TEST_ASSERT_EQUAL_INT(0, pcr_set_workers(r, 0));
+	TEST_ASSERT_NULL(r->workers);
+	pcr_destroy(r);
+}
+
+static atomic_int hang_ms, hang_calls;
+
+static prom_map_t *
+hang_collect(prom_collector_t *self) {
+	atomic_fetch_add(&hang_calls, 1);
+	usleep(atomic_load(&hang_ms) * 1000);
+	return self->metrics;
+}
+
+/**
+ * @brief Wait for the abandoned job of the given collector to return.
+ */
+static void
+wait_abandoned(prom_collector_t *c) {
+	for (int i = 0; i < 500 && atomic_load(&c->abandoned) > 0; i++)
+		usleep(10000);
+	TEST_ASSERT_EQUAL_UINT(0, atomic_load(&c->abandoned));
+}
+
+static atomic_int overlap_calls;
+
+static prom_map_t *
+overlap_collect(prom_collector_t *self) {
+	// Block until the other export runs the collector as well.
+	atomic_fetch_add(&overlap_calls, 1);
+	for (int i = 0; i < 500 && atomic_load(&overlap_calls) < 2; i++)
+		usleep(10000);
+	usleep(200000);
+	return self->metrics;
+}
+
+static void *
+overlap_thread(void *arg) {
+	return pcr_bridge((pcr_t *) arg);
+}
+
+void
+test_pcr_workers_concurrent(void) {
+	pcr_t *r = pcr_new("overlap");
+	const char *label[] = { "label" };
+	const char *values[] = { "v" };
+	prom_collector_t *c = prom_collector_new("slowc");
+	prom_collector_set_collect_fn(c, &overlap_collect);
+	prom_counter_t *counter = prom_counter_new("slowc_total", "slow counter",
+		1, label);
+	prom_counter_add(counter, 7, values);
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_add_metric(c, counter));
+	TEST_ASSERT_EQUAL_INT(0, pcr_register_collector(r, c));
+	TEST_ASSERT_EQUAL_INT(0, pcr_set_workers(r, 2));
+
+	// A collector busy with another export is no missed deadline: both
+	// exports run it and get its metrics.
+	pthread_t thread;
+	char *result, *other;
+	TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, overlap_thread, r));
+	for (int i = 0; i < 500 && atomic_load(&overlap_calls) == 0; i++)
+		usleep(10000);
+	result = pcr_bridge(r);
+	TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, (void **) &other));
+	TEST_ASSERT_EQUAL_INT(2, atomic_load(&overlap_calls));
+	TEST_ASSERT_NOT_NULL(strstr(result, "slowc_total{label=\"v\"} 7\n"));
+	TEST_ASSERT_EQUAL_STRING(result, other);
+	free(other);
+	free(result);
+
+	result = pcr_bridge(r);
+	TEST_ASSERT_NULL(strstr(result, METRIC_NAME_TIMEOUTS));
+	free(result);
+	pcr_destroy(r);
+}
+
+void
+test_pcr_timeout(void) {
+	pcr_t *r = pcr_new("timeout");
+	const char *label[] = { "label" };
+	const char *values[] = { "v" };
+	prom_collector_t *c = prom_collector_new("hang");
+	prom_collector_set_collect_fn(c, &hang_collect);
+	prom_counter_t *counter = prom_counter_new("hang_total", "hanging counter",
+		1, label);
+	prom_counter_add(counter, 3, values);
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_add_metric(c, counter));
+	TEST_ASSERT_EQUAL_INT(0, pcr_register_collector(r, c));
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_set_timeout(c, 100));
+	TEST_ASSERT_EQUAL_INT(0, pcr_set_workers(r, 2));
+
+	// In time: fresh export, which becomes the snapshot.
+	char *result;
+	atomic_store(&hang_ms, 0);
+	result = pcr_bridge(r);
+	TEST_ASSERT_NOT_NULL(strstr(result, "hang_total{label=\"v\"} 3\n"));
+	TEST_ASSERT_NULL(strstr(result, METRIC_NAME_TIMEOUTS));
+	free(result);
+
+	// Too late: the snapshot gets used, the miss counted, and the job left
+	// running.
+	atomic_store(&hang_ms, 1000);
+	prom_counter_add(counter, 1, values);
+	result = pcr_bridge(r);
+	TEST_ASSERT_EQUAL_UINT(1, atomic_load(&c->abandoned));
+	TEST_ASSERT_NOT_NULL(strstr(result, "hang_total{label=\"v\"} 3\n"));
+	free(result);
+
+	// Still hanging: skipped, i.e. not run again.
+	int calls = atomic_load(&hang_calls);
+	result = pcr_bridge(r);
+	TEST_ASSERT_EQUAL_INT(calls, atomic_load(&hang_calls));
+	TEST_ASSERT_NOT_NULL(strstr(result, "hang_total{label=\"v\"} 3\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		METRIC_NAME_TIMEOUTS "{collector=\"hang\"} 1\n"));
+	free(result);
+
+	// The late export of the abandoned job is the new snapshot. Skipping
+	// did not count as another miss.
+	wait_abandoned(c);
+	result = pcr_bridge(r);
+	TEST_ASSERT_EQUAL_UINT(1, atomic_load(&c->abandoned));
+	TEST_ASSERT_NOT_NULL(strstr(result, "hang_total{label=\"v\"} 4\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		METRIC_NAME_TIMEOUTS "{collector=\"hang\"} 1\n"));
+	free(result);
+
+	// The registry wide budget applies to collectors without one, too.
+	wait_abandoned(c);
+	prom_collector_set_timeout(c, 0);
+	result = pcr_bridge_timeout(r, 100);
+	TEST_ASSERT_EQUAL_UINT(1, atomic_load(&c->abandoned));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		METRIC_NAME_TIMEOUTS "{collector=\"hang\"} 2\n"));
+	free(result);
+
+	// Waits for the hanging collector.
+	pcr_destroy(r);
+}
+
+void
+test_pcr_max_series(void) {
+	prom_registry_test_init();
+	const char *keys[] = { "path" };
+	const char *values[][1] = { {"a"}, {"b"}, {"c"}, {"d"}, {"e"}, {"f"} };
+
+	// before and after the limit got set
+	TEST_ASSERT_EQUAL_INT(0, pcr_set_max_series(PROM_COLLECTOR_REGISTRY, 2));
+	prom_histogram_t *h = pcr_must_register_metric(prom_histogram_new(
+		"test_paths", "histogram under test", phb_linear(1.0, 1.0, 2), 1,
+		keys));
+	TEST_ASSERT_NOT_NULL(h);
+
+	// New label sets beyond the limit end up in the overflow series.
+	for (int i = 0; i < 4; i++) {
+		TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(test_counter, values[i]));
+		TEST_ASSERT_EQUAL_INT(0, prom_histogram_observe(h, 1, values[i]));
+	}
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(test_counter, values[3]));
+	TEST_ASSERT_EQUAL_UINT(3, prom_map_size(test_counter->samples));
+	TEST_ASSERT_EQUAL_UINT(3, prom_map_size(h->samples));
+	TEST_ASSERT_EQUAL_UINT64(3, prom_metric_dropped(test_counter));
+	TEST_ASSERT_EQUAL_UINT64(2, prom_metric_dropped(h));
+
+	// A higher limit makes room for new series again.
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_max_series(test_counter, 3));
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(test_counter, values[4]));
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_inc(test_counter, values[5]));
+	TEST_ASSERT_EQUAL_UINT(4, prom_map_size(test_counter->samples));
+
+	char *result = pcr_bridge(PROM_COLLECTOR_REGISTRY);
+	TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"b\"} 1\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"e\"} 1\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		"test_counter{label=\"" PROM_OVERFLOW_LABEL_VALUE "\"} 4\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		"test_paths_count{path=\"" PROM_OVERFLOW_LABEL_VALUE "\"} 2\n"));
+	TEST_ASSERT_NULL(strstr(result, "\"d\""));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		METRIC_NAME_REJECTED "{metric=\"test_counter\"} 4\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		METRIC_NAME_REJECTED "{metric=\"test_paths\"} 2\n"));
+	free(result);
+	prom_registry_test_destroy();
+}
+
+static atomic_int periodic_calls, periodic_export_calls;
+static pthread_t periodic_exporter;
+
+static prom_map_t *
+periodic_collect(prom_collector_t *self) {
+	atomic_fetch_add(&periodic_calls, 1);
+	if (pthread_equal(pthread_self(), periodic_exporter))
+		atomic_fetch_add(&periodic_export_calls, 1);
+	usleep(100000);
+	return self->metrics;
+}
+
+/**
+ * @brief Wait until the collect function of test_pcr_periodic() got called
+ *	the given number of times.
+ */
+static void
+wait_periodic_calls(int calls) {
+	for (int i = 0; i < 500 && atomic_load(&periodic_calls) < calls; i++)
+		usleep(10000);
+	TEST_ASSERT_TRUE(atomic_load(&periodic_calls) >= calls);
+}
+
+void
+test_pcr_periodic(void) {
+	pcr_t *r = pcr_new("periodic");
+	const char *label[] = { "label" };
+	const char *values[] = { "v" };
+	periodic_exporter = pthread_self();
+	prom_collector_t *c = prom_collector_new("expensive");
+	prom_collector_set_collect_fn(c, &periodic_collect);
+	prom_counter_t *counter = prom_counter_new("expensive_total",
+		"expensive counter", 1, label);
+	prom_counter_add(counter, 5, values);
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_add_metric(c, counter));
+	TEST_ASSERT_EQUAL_INT(0, prom_collector_set_interval(c, 200));
+	TEST_ASSERT_EQUAL_INT(0, pcr_register_collector(r, c));
+	TEST_ASSERT_NOT_NULL(r->scheduler);
+
+	// Wait for the first snapshot.
+	for (int i = 0; i < 500 && atomic_load(&c->refreshed) == 0; i++)
+		usleep(10000);
+	TEST_ASSERT_TRUE(atomic_load(&c->refreshed) != 0);
+
+	// Exports do not call the collect function, and the cursor gets the
+	// same snapshot.
+	char *result = pcr_bridge(r);
+	TEST_ASSERT_NOT_NULL(strstr(result, "expensive_total{label=\"v\"} 5\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		METRIC_NAME_SNAPSHOT_AGE "{collector=\"expensive\"} "));
+	free(result);
+	pcr_cursor_t *cursor = pcr_cursor_new(r);
+	result = read_cursor(cursor, 10);
+	pcr_cursor_destroy(cursor);
+	TEST_ASSERT_NOT_NULL(strstr(result, "expensive_total{label=\"v\"} 5\n"));
+	free(result);
+	// Snapshots exist for every format.
+	size_t len;
+	result = pcr_export(r, PROM_FORMAT_PROTOBUF, 0, &len);
+	TEST_ASSERT_NOT_NULL(memmem(result, len, "expensive_total", 15));
+	free(result);
+	TEST_ASSERT_EQUAL_INT(0, atomic_load(&periodic_export_calls));
+
+	// Changes show up with the next refresh, which is done, once the one
+	// after it started.
+	prom_counter_add(counter, 1, values);
+	wait_periodic_calls(atomic_load(&periodic_calls) + 2);
+	TEST_ASSERT_EQUAL_INT(0, pcr_set_workers(r, 2));
+	result = pcr_bridge(r);
+	TEST_ASSERT_NOT_NULL(strstr(result, "expensive_total{label=\"v\"} 6\n"));
+	free(result);
+
+	pcr_destroy(r);
+}
+
 void
 test_pcr_default_init(void) {
 	TEST_ASSERT_EQUAL_INT_MESSAGE(0, pcr_default_init(),
@@ -218,6 +705,14 @@ main(int argc, const char **argv) {
 	RUN_TEST(test_pcr_must_register);
 	RUN_TEST(test_pcr_default_init);
 	RUN_TEST(test_pcr_bridge);
+	RUN_TEST(test_pcr_bridge_concurrent);
+	RUN_TEST(test_pcr_workers);
+	RUN_TEST(test_pcr_workers_concurrent);
+	RUN_TEST(test_pcr_timeout);
+	RUN_TEST(test_pcr_max_series);
+	RUN_TEST(test_pcr_periodic);
+	RUN_TEST(test_pcr_cursor);
+	RUN_TEST(test_pcr_cursor_scrape);
 	RUN_TEST(test_pcr_check_name);
 	RUN_TEST(test_large_registry);
 	return UNITY_END();
@@ -16,6 +16,8 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "prom_test_helpers.h"
 
@@ -30,10 +32,10 @@ test_counter_inc(void) {
 
 	prom_counter_inc(c, sample_labels_a);
 	pms_t *sample = pms_from_labels(c, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(1.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(1.0, *sample->r_value);
 
 	sample = pms_from_labels(c, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
 
 	prom_counter_destroy(c);
 }
@@ -46,10 +48,10 @@ test_counter_add(void) {
 
 	prom_counter_add(c, 100000000.1, sample_labels_a);
 	pms_t *sample = pms_from_labels(c, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, *sample->r_value);
 
 	sample = pms_from_labels(c, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
 
 	prom_counter_destroy(c);
 }
@@ -62,14 +64,14 @@ test_counter_reset(void) {
 
 	prom_counter_reset(g, 100000000.1, sample_labels_a);
 	pms_t *sample = pms_from_labels(g, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, *sample->r_value);
 
 	sample = pms_from_labels(g, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
 
 	prom_counter_reset(g, 1, sample_labels_a);
 	sample = pms_from_labels(g, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(1, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(1, *sample->r_value);
 
 	TEST_ASSERT_TRUE_MESSAGE(prom_counter_reset(g, -1, sample_labels_a) > 0,
 		"prom_counter_reset() should not allow negative values");
@@ -77,11 +79,128 @@ test_counter_reset(void) {
 	prom_counter_destroy(g);
 }
 
+void
+test_counter_bind(void) {
+	prom_counter_t *c = prom_counter_new("test_counter", "counter under test",
+		2, (const char *[]) {"foo", "bar"});
+	TEST_ASSERT(c);
+
+	prom_counter_handle_t *h = prom_counter_bind(c, sample_labels_a);
+	TEST_ASSERT_NOT_NULL(h);
+	TEST_ASSERT_EQUAL_PTR(h, pms_from_labels(c, sample_labels_a));
+	TEST_ASSERT_EQUAL_PTR(h, prom_counter_bind(c, sample_labels_a));
+
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_handle_inc(h));
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_handle_add(h, 2.5));
+	prom_counter_inc(c, sample_labels_a);
+	TEST_ASSERT_EQUAL_DOUBLE(4.5, *h->r_value);
+	TEST_ASSERT_TRUE(prom_counter_handle_add(h, -1) > 0);
+	TEST_ASSERT_EQUAL_INT(0, prom_counter_handle_reset(h, 1));
+	TEST_ASSERT_EQUAL_DOUBLE(1.0, *h->r_value);
+	TEST_ASSERT_TRUE(prom_counter_handle_inc(NULL) > 0);
+
+	prom_counter_destroy(c);
+
+	// unlabeled counters get their handle on construction
+	c = prom_counter_new("test_counter", "counter under test", 0, NULL);
+	TEST_ASSERT(c);
+	TEST_ASSERT_NOT_NULL(c->unlabeled);
+	h = prom_counter_bind(c, NULL);
+	TEST_ASSERT_EQUAL_PTR(c->unlabeled, h);
+	prom_counter_handle_inc(h);
+	prom_counter_inc(c, NULL);
+	TEST_ASSERT_EQUAL_DOUBLE(2.0, *h->r_value);
+	TEST_ASSERT_EQUAL_INT(1, prom_map_size(c->samples));
+
+	prom_counter_destroy(c);
+}
+
+static void *
+inc_handle(void *arg) {
+	for (int i = 0; i < 10000; i++)
+		prom_counter_handle_inc((prom_counter_handle_t *) arg);
+	return NULL;
+}
+
+void
+test_counter_striped(void) {
+	prom_counter_t *c = prom_counter_new("test_counter", "counter under test",
+		2, (const char *[]) {"foo", "bar"});
+	TEST_ASSERT(c);
+
+	prom_counter_handle_t *a = prom_counter_bind(c, sample_labels_a);
+	prom_counter_add(c, 5.0, sample_labels_a);
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_stripes(c, 8));
+	TEST_ASSERT_EQUAL_INT(8, a->stripes->count);
+	TEST_ASSERT_EQUAL_DOUBLE(5.0, pms_get(a));
+
+	// new samples get striped as well
+	prom_counter_handle_t *b = prom_counter_bind(c, sample_labels_b);
+	TEST_ASSERT_EQUAL_INT(8, b->stripes->count);
+
+	pthread_t t[4];
+	for (int i = 0; i < 4; i++)
+		pthread_create(&t[i], NULL, inc_handle, a);
+	for (int i = 0; i < 4; i++)
+		pthread_join(t[i], NULL);
+	TEST_ASSERT_EQUAL_DOUBLE(40005.0, pms_get(a));
+
+	pmf_t *mf = pmf_new();
+	pmf_load_metric(mf, c, NULL, true);
+	char *result = pmf_dump(mf);
+	TEST_ASSERT_NOT_NULL(strstr(result,"test_counter{foo=\"f\",bar=\"b\"} 40005\n"));
+	free(result);
+	pmf_destroy(mf);
+
+	// only counters and gauges can be striped
+	prom_histogram_t *h = prom_histogram_new("test_histogram",
+		"histogram under test", phb_linear(5.0, 5.0, 2), 0, NULL);
+	TEST_ASSERT_TRUE(prom_metric_set_stripes(h, 8) > 0);
+	prom_histogram_destroy(h);
+
+	prom_counter_destroy(c);
+}
+
+static void *
+inc_labeled(void *arg) {
+	for (int i = 0; i < 100000; i++) {
+		prom_counter_inc((prom_counter_t *) arg, sample_labels_a);
+		pms_get(pms_from_labels((prom_counter_t *) arg, sample_labels_a));
+	}
+	return NULL;
+}
+
+void
+test_counter_stripe_concurrent(void) {
+	prom_counter_t *c = prom_counter_new("test_counter", "counter under test",
+		2, (const char *[]) {"foo", "bar"});
+	TEST_ASSERT(c);
+	prom_counter_handle_t *a = prom_counter_bind(c, sample_labels_a);
+
+	// Samples get striped, while they are updated via handles and lookups.
+	pthread_t t[4];
+	for (int i = 0; i < 2; i++) {
+		pthread_create(&t[i], NULL, inc_handle, a);
+		pthread_create(&t[i + 2], NULL, inc_labeled, c);
+	}
+	sched_yield();
+	TEST_ASSERT_EQUAL_INT(0, prom_metric_set_stripes(c, 8));
+	for (int i = 0; i < 4; i++)
+		pthread_join(t[i], NULL);
+	TEST_ASSERT_EQUAL_INT(8, a->stripes->count);
+	TEST_ASSERT_EQUAL_DOUBLE(220000.0, pms_get(a));
+
+	prom_counter_destroy(c);
+}
+
 int
 main(int argc, const char **argv) {
 	UNITY_BEGIN();
 	RUN_TEST(test_counter_inc);
 	RUN_TEST(test_counter_add);
 	RUN_TEST(test_counter_reset);
+	RUN_TEST(test_counter_bind);
+	RUN_TEST(test_counter_striped);
+	RUN_TEST(test_counter_stripe_concurrent);
 	return UNITY_END();
 }
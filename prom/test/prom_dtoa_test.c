@@ -0,0 +1,123 @@
+/**
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <locale.h>
+#include <math.h>
+
+#include "prom_test_helpers.h"
+#include "prom_dtoa_i.h"
+
+static void
+assert_dtoa(const char *expected, double value) {
+	char buf[PROM_DTOA_BUFSZ];
+	size_t len = prom_dtoa(value, buf);
+	TEST_ASSERT_EQUAL_STRING(expected, buf);
+	TEST_ASSERT_EQUAL_UINT(strlen(expected), len);
+}
+
+void
+test_prom_dtoa(void) {
+	assert_dtoa("0", 0.0);
+	assert_dtoa("0", -0.0);
+	assert_dtoa("1", 1.0);
+	assert_dtoa("-12", -12.0);
+	assert_dtoa("9007199254740991", 9007199254740991.0);
+	assert_dtoa("0.1", 0.1);
+	assert_dtoa("0.3", 0.3);
+	assert_dtoa("0.30000000000000004", 0.1 + 0.2);
+	assert_dtoa("0.25", 0.25);
+	assert_dtoa("-1.5", -1.5);
+	assert_dtoa("123.456", 123.456);
+	assert_dtoa("0.001234", 0.001234);
+	assert_dtoa("1.5e-07", 1.5e-7);
+	assert_dtoa("100000000000000000000", 1e20);
+	assert_dtoa("1e+21", 1e21);
+	assert_dtoa("1.7976931348623157e+308", 1.7976931348623157e308);
+	assert_dtoa("5e-324", 5e-324);
+	assert_dtoa("2.2250738585072014e-308", 2.2250738585072014e-308);
+	assert_dtoa("+Inf", INFINITY);
+	assert_dtoa("-Inf", -INFINITY);
+	assert_dtoa("NaN", NAN);
+}
+
+void
+test_prom_dtoa_roundtrip(void) {
+	char buf[PROM_DTOA_BUFSZ], ref[64];
+	uint64_t x = 88172645463325252ULL;
+	size_t longer = 0;
+
+	for (int i = 0; i < 1000000; i++) {
+		// xorshift64 over all bit patterns, i.e. all magnitudes
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		double v;
+		memcpy(&v, &x, sizeof(v));
+		if (!isfinite(v))
+			continue;
+		prom_dtoa(v, buf);
+		TEST_ASSERT_TRUE_MESSAGE(strtod(buf, NULL) == v, buf);
+
+		// Compare with the shortest %g representation, which round-trips.
+		int p = 1;
+		while (sprintf(ref, "%.*g", p, v) && strtod(ref, NULL) != v)
+			p++;
+		// significant digits, i.e. without leading and trailing zeros
+		char digits[PROM_DTOA_BUFSZ];
+		size_t n = 0;
+		for (char *s = buf; *s != '\0' && *s != 'e'; s++) {
+			if (*s >= '0' && *s <= '9' && (n > 0 || *s != '0'))
+				digits[n++] = *s;
+		}
+		while (n > 0 && digits[n - 1] == '0')
+			n--;
+		if (n > (size_t) p)
+			longer++;
+	}
+	// Grisu2 is not always the shortest, but in > 99.5% of all cases.
+	TEST_ASSERT_TRUE(longer < 5000);
+}
+
+void
+test_prom_dtoa_locale(void) {
+	char buf[PROM_DTOA_BUFSZ];
+	// Independent of the locale, if one with a decimal comma is available.
+	setlocale(LC_NUMERIC, "de_DE.UTF-8");
+	prom_dtoa(0.5, buf);
+	TEST_ASSERT_EQUAL_STRING("0.5", buf);
+	setlocale(LC_NUMERIC, "C");
+}
+
+void
+test_prom_u64toa(void) {
+	char buf[PROM_DTOA_BUFSZ];
+	TEST_ASSERT_EQUAL_UINT(1, prom_u64toa(0, buf));
+	TEST_ASSERT_EQUAL_STRING("0", buf);
+	TEST_ASSERT_EQUAL_UINT(2, prom_u64toa(42, buf));
+	TEST_ASSERT_EQUAL_STRING("42", buf);
+	TEST_ASSERT_EQUAL_UINT(3, prom_u64toa(100, buf));
+	TEST_ASSERT_EQUAL_STRING("100", buf);
+	TEST_ASSERT_EQUAL_UINT(20, prom_u64toa(UINT64_MAX, buf));
+	TEST_ASSERT_EQUAL_STRING("18446744073709551615", buf);
+}
+
+int
+main(int argc, const char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_prom_dtoa);
+	RUN_TEST(test_prom_dtoa_roundtrip);
+	RUN_TEST(test_prom_dtoa_locale);
+	RUN_TEST(test_prom_u64toa);
+	return UNITY_END();
+}
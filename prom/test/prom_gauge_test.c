@@ -28,10 +28,10 @@ test_gauge_inc(void) {
 
 	prom_gauge_inc(g, sample_labels_a);
 	pms_t *sample = pms_from_labels(g, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(1.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(1.0, *sample->r_value);
 
 	sample = pms_from_labels(g, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
 
 	prom_gauge_destroy(g);
 }
@@ -44,10 +44,10 @@ test_gauge_dec(void) {
 
 	prom_gauge_dec(g, sample_labels_a);
 	pms_t *sample = pms_from_labels(g, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(-1.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(-1.0, *sample->r_value);
 
 	sample = pms_from_labels(g, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
 
 	prom_gauge_destroy(g);
 }
@@ -60,10 +60,10 @@ test_gauge_add(void) {
 
 	prom_gauge_add(g, 100000000.1, sample_labels_a);
 	pms_t *sample = pms_from_labels(g, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, *sample->r_value);
 
 	sample = pms_from_labels(g, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
 
 	prom_gauge_destroy(g);
 }
@@ -76,10 +76,10 @@ test_gauge_sub(void) {
 
 	prom_gauge_sub(g, 100000000.1, sample_labels_a);
 	pms_t *sample = pms_from_labels(g, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(-100000000.1, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(-100000000.1, *sample->r_value);
 
 	sample = pms_from_labels(g, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
 
 	prom_gauge_destroy(g);
 }
@@ -92,10 +92,32 @@ test_gauge_set(void) {
 
 	prom_gauge_set(g, 100000000.1, sample_labels_a);
 	pms_t *sample = pms_from_labels(g, sample_labels_a);
-	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(100000000.1, *sample->r_value);
 
 	sample = pms_from_labels(g, sample_labels_b);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *sample->r_value);
+
+	prom_gauge_destroy(g);
+}
+
+void
+test_gauge_bind(void) {
+	prom_gauge_t *g = prom_gauge_new("test_gauge", "gauge under test",
+		2, (const char *[]) {"foo", "bar"});
+	TEST_ASSERT(g);
+
+	prom_gauge_handle_t *h = prom_gauge_bind(g, sample_labels_a);
+	TEST_ASSERT_NOT_NULL(h);
+	TEST_ASSERT_EQUAL_PTR(h, pms_from_labels(g, sample_labels_a));
+
+	prom_gauge_handle_inc(h);
+	prom_gauge_handle_add(h, 10.0);
+	prom_gauge_handle_dec(h);
+	prom_gauge_handle_sub(h, 2.5);
+	TEST_ASSERT_EQUAL_DOUBLE(7.5, *h->r_value);
+	prom_gauge_handle_set(h, -3.0);
+	TEST_ASSERT_EQUAL_DOUBLE(-3.0, *pms_from_labels(g, sample_labels_a)->r_value);
+	TEST_ASSERT_NULL(prom_counter_bind(g, sample_labels_a));
 
 	prom_gauge_destroy(g);
 }
@@ -108,5 +130,6 @@ main(int argc, const char **argv) {
 	RUN_TEST(test_gauge_add);
 	RUN_TEST(test_gauge_sub);
 	RUN_TEST(test_gauge_set);
+	RUN_TEST(test_gauge_bind);
 	return UNITY_END();
 }
@@ -16,6 +16,9 @@
  * limitations under the License.
  */
 
+#include <math.h>
+
+#include "prom_histogram_buckets_i.h"
 #include "prom_test_helpers.h"
 
 void
@@ -50,11 +53,69 @@ test_phb_expontential(void) {
 	phb_destroy(result);
 }
 
+// Check all kernels against the simple scan incl. bounds and their
+// neighbors, NaN and +-Inf.
+static void
+check_index(phb_t *b) {
+	phb_search_fn *fn[] = { phb_search_branchless, phb_search_sse2,
+		phb_search_avx2 };
+	size_t n = phb_count(b);
+	double v[] = { NAN, INFINITY, -INFINITY, 0.0, -1.0, 1e300 };
+
+	for (size_t i = 0; i < n + 6; i++) {
+		double values[3];
+		if (i < n) {
+			values[0] = b->upper_bound[i];
+			values[1] = nextafter(values[0], -INFINITY);
+			values[2] = nextafter(values[0], INFINITY);
+		} else {
+			values[0] = values[1] = values[2] = v[i - n];
+		}
+		for (int k = 0; k < 3; k++) {
+			size_t expected = phb_search_scan(b->upper_bound, n, values[k]);
+			TEST_ASSERT_EQUAL_UINT(expected, phb_index(b, values[k]));
+			for (int f = 0; f < 3; f++) {
+				if (phb_search_supported(fn[f]))
+					TEST_ASSERT_EQUAL_UINT(expected,
+						fn[f](b->upper_bound, n, values[k]));
+			}
+		}
+	}
+}
+
+void
+test_phb_index(void) {
+	phb_t *b = phb_linear(0.1, 0.1, 60);
+	TEST_ASSERT_EQUAL_INT(PHB_LINEAR, b->layout);
+	check_index(b);
+	TEST_ASSERT_EQUAL_UINT(0, phb_index(b, 0.1));
+	TEST_ASSERT_EQUAL_UINT(1, phb_index(b, 0.15));
+	TEST_ASSERT_EQUAL_UINT(60, phb_index(b, NAN));
+	phb_destroy(b);
+
+	b = phb_exponential(0.001, 1.5, 40);
+	TEST_ASSERT_EQUAL_INT(PHB_EXPONENTIAL, b->layout);
+	check_index(b);
+	phb_destroy(b);
+
+	b = phb_new(11, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0,
+		10.0);
+	TEST_ASSERT_EQUAL_INT(PHB_ARBITRARY, b->layout);
+	check_index(b);
+	TEST_ASSERT_EQUAL_UINT(3, phb_index(b, 0.03));
+	phb_destroy(b);
+
+	b = phb_new(3, 1.0, 2.0, 3.0);
+	check_index(b);
+	phb_destroy(b);
+}
+
 int
 main(int argc, const char **argv) {
 	UNITY_BEGIN();
 	RUN_TEST(test_phb_new);
 	RUN_TEST(test_phb_linear);
 	RUN_TEST(test_phb_expontential);
+	RUN_TEST(test_phb_index);
 	return UNITY_END();
 }
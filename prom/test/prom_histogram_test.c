@@ -15,6 +15,8 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+
 #include "prom_test_helpers.h"
 
 void
@@ -29,53 +31,118 @@ test_prom_histogram(void) {
 	prom_histogram_observe(h, 22.0, NULL);
 
 	pms_histogram_t *h_sample = pms_histogram_from_labels(h, NULL);
+	uint64_t counts[4], count;
+	double sum;
+
+	TEST_ASSERT_EQUAL_INT(0,
+		pms_histogram_snapshot(h_sample, counts, &count, &sum));
 
 	// Test counter for each bucket
-	const char *bucket_key = bucket->key[0];
-	const char *l_value = prom_map_get(h_sample->l_values, bucket_key);
-	pms_t *sample = (pms_t *) prom_map_get(h_sample->samples, l_value);
-	TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"5.0\"}", sample->l_value);
-	TEST_ASSERT_EQUAL_DOUBLE(1.0, sample->r_value);
-	bucket_key = NULL;
-
-	bucket_key = bucket->key[1];
-	l_value = prom_map_get(h_sample->l_values, bucket_key);
-	sample = (pms_t *) prom_map_get(h_sample->samples, l_value);
-	TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"10.0\"}", sample->l_value);
-	TEST_ASSERT_EQUAL_DOUBLE(2.0, sample->r_value);
-	bucket_key = NULL;
-
-	bucket_key = bucket->key[2];
-	l_value = prom_map_get(h_sample->l_values, bucket_key);
-	sample = (pms_t *) prom_map_get(h_sample->samples, l_value);
-	TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"15.0\"}", sample->l_value);
-	TEST_ASSERT_EQUAL_DOUBLE(3.0, sample->r_value);
-	bucket_key = NULL;
-
-	l_value = prom_map_get(h_sample->l_values, "+Inf");
-	sample = (pms_t *) prom_map_get(h_sample->samples, l_value);
-	TEST_ASSERT_EQUAL_STRING("test_histogram{le=\"+Inf\"}", sample->l_value);
-	TEST_ASSERT_EQUAL_DOUBLE(4.0, sample->r_value);
+	TEST_ASSERT_EQUAL_UINT64(1, counts[0]);
+	TEST_ASSERT_EQUAL_UINT64(2, counts[1]);
+	TEST_ASSERT_EQUAL_UINT64(3, counts[2]);
+	TEST_ASSERT_EQUAL_UINT64(4, counts[3]);
 
 	// Test total count. Should equal value ini +Inf
-	l_value = prom_map_get(h_sample->l_values, "count");
-	pms_t *sample_count = (pms_t *) prom_map_get(h_sample->samples, l_value);
-	TEST_ASSERT_EQUAL_STRING("test_histogram_count", sample_count->l_value);
-	TEST_ASSERT_EQUAL_DOUBLE(4.0, sample_count->r_value);
+	TEST_ASSERT_EQUAL_UINT64(4, count);
 
 	// Test sum
-	l_value = prom_map_get(h_sample->l_values, "sum");
-	sample = (pms_t *) prom_map_get(h_sample->samples, l_value);
-	TEST_ASSERT_EQUAL_STRING("test_histogram_sum", sample->l_value);
-	TEST_ASSERT_EQUAL_DOUBLE(41.0, sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(41.0, sum);
+
+	// Lines get generated from the shared bucket keys at render time
+	pmf_t *mf = pmf_new();
+	TEST_ASSERT_EQUAL_INT(0,
+		pmf_load_histogram_sample(mf, h, h_sample, NULL));
+	char *result = pmf_dump(mf);
+	TEST_ASSERT_EQUAL_STRING(
+		"test_histogram_bucket{le=\"5.0\"} 1\n"
+		"test_histogram_bucket{le=\"10.0\"} 2\n"
+		"test_histogram_bucket{le=\"15.0\"} 3\n"
+		"test_histogram_bucket{le=\"+Inf\"} 4\n"
+		"test_histogram_count 4\n"
+		"test_histogram_sum 41\n", result);
+	free(result);
+	pmf_destroy(mf);
+
+	// A second snapshot must see the same values, NaN goes to +Inf only.
+	prom_histogram_observe(h, 0.0 / 0.0, NULL);
+	TEST_ASSERT_EQUAL_INT(0,
+		pms_histogram_snapshot(h_sample, counts, &count, &sum));
+	TEST_ASSERT_EQUAL_UINT64(3, counts[2]);
+	TEST_ASSERT_EQUAL_UINT64(5, counts[3]);
+	TEST_ASSERT_EQUAL_UINT64(5, count);
 
 	prom_histogram_destroy(h);
 	h = NULL;
 }
 
+static void *
+observe_ones(void *arg) {
+	for (int i = 0; i < 20000; i++)
+		pms_histogram_observe((pms_histogram_t *) arg, 1.0);
+	return NULL;
+}
+
+void
+test_prom_histogram_concurrent(void) {
+	prom_histogram_t *h = prom_histogram_new("test_histogram",
+		"histogram under test", phb_linear(5.0, 5.0, 3), 0, NULL);
+	pms_histogram_t *hs = pms_histogram_from_labels(h, NULL);
+	uint64_t counts[4], count;
+	double sum;
+	pthread_t t[4];
+
+	for (int i = 0; i < 4; i++)
+		pthread_create(&t[i], NULL, observe_ones, hs);
+	// Every snapshot taken while observing must be consistent.
+	for (int i = 0; i < 200; i++) {
+		TEST_ASSERT_EQUAL_INT(0, pms_histogram_snapshot(hs, counts, &count,
+			&sum));
+		TEST_ASSERT_EQUAL_UINT64(count, counts[0]);
+		TEST_ASSERT_EQUAL_UINT64(count, counts[3]);
+		TEST_ASSERT_EQUAL_DOUBLE((double) count, sum);
+	}
+	for (int i = 0; i < 4; i++)
+		pthread_join(t[i], NULL);
+
+	TEST_ASSERT_EQUAL_INT(0, pms_histogram_snapshot(hs, counts, &count, &sum));
+	TEST_ASSERT_EQUAL_UINT64(80000, count);
+	TEST_ASSERT_EQUAL_UINT64(80000, counts[3]);
+	TEST_ASSERT_EQUAL_DOUBLE(80000.0, sum);
+	prom_histogram_destroy(h);
+}
+
+void
+test_prom_histogram_bind(void) {
+	prom_histogram_t *h = prom_histogram_new("test_histogram",
+		"histogram under test", phb_linear(5.0, 5.0, 3), 1,
+		(const char *[]) { "foo" });
+	const char *labels[] = { "bar" };
+	uint64_t count;
+
+	prom_histogram_handle_t *hh = prom_histogram_bind(h, labels);
+	TEST_ASSERT_NOT_NULL(hh);
+	TEST_ASSERT_EQUAL_PTR(hh, pms_histogram_from_labels(h, labels));
+	TEST_ASSERT_EQUAL_INT(0, prom_histogram_handle_observe(hh, 3.0));
+	TEST_ASSERT_EQUAL_INT(0, prom_histogram_observe(h, 12.0, labels));
+
+	TEST_ASSERT_EQUAL_INT(0, pms_histogram_snapshot(hh, NULL, &count, NULL));
+	TEST_ASSERT_EQUAL_UINT64(2, count);
+	prom_histogram_destroy(h);
+
+	// unlabeled histograms get their handle on construction
+	h = prom_histogram_new("test_histogram", "histogram under test",
+		phb_linear(5.0, 5.0, 3), 0, NULL);
+	TEST_ASSERT_NOT_NULL(h->unlabeled);
+	TEST_ASSERT_EQUAL_PTR(h->unlabeled, prom_histogram_bind(h, NULL));
+	prom_histogram_destroy(h);
+}
+
 int
 main(int argc, const char **argv) {
 	UNITY_BEGIN();
 	RUN_TEST(test_prom_histogram);
+	RUN_TEST(test_prom_histogram_concurrent);
+	RUN_TEST(test_prom_histogram_bind);
 	return UNITY_END();
 }
@@ -15,6 +15,10 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
 #include "prom_test_helpers.h"
 
 void
@@ -27,10 +31,10 @@ test_prom_map(void) {
 	TEST_ASSERT_NULL(prom_map_get(map, "nope"));
 	TEST_ASSERT_EQUAL_INT(2, prom_map_size(map));
 
-	for (pll_node_t *current_node = map->keys->head; current_node != NULL;
-		current_node = current_node->next)
-	{
-		const char *key = (const char *) current_node->item;
+	prom_map_iter_t iter;
+	prom_map_iter_init(&iter, map);
+	while (prom_map_iter_next(&iter)) {
+		const char *key = iter.key;
 		const char *expected;
 		if (strcmp(key, "foo") == 0) {
 			expected = "bar";
@@ -41,6 +45,7 @@ test_prom_map(void) {
 		}
 		const char *result = prom_map_get(map, key);
 		TEST_ASSERT_EQUAL_STRING(expected, result);
+		TEST_ASSERT_EQUAL_PTR(result, iter.value);
 	}
 
 	prom_map_destroy(map);
@@ -88,10 +93,193 @@ test_prom_map_when_large(void) {
 	prom_map_destroy(map);
 }
 
+void
+test_prom_map_delete(void) {
+	prom_map_t *map = prom_map_new();
+	prom_map_set_free_value_fn(map, free);
+	char buf[16];
+
+	for (int i = 0; i < 1000; i++) {
+		int *v = malloc(sizeof(int));
+		*v = i;
+		sprintf(buf, "key%d", i);
+		TEST_ASSERT_EQUAL_INT(0, prom_map_set(map, buf, v));
+	}
+	// Delete every odd key: the remaining ones keep their insertion order.
+	for (int i = 1; i < 1000; i += 2) {
+		sprintf(buf, "key%d", i);
+		TEST_ASSERT_EQUAL_INT(0, prom_map_delete(map, buf));
+		TEST_ASSERT_NULL(prom_map_get(map, buf));
+	}
+	TEST_ASSERT_EQUAL_INT(500, prom_map_size(map));
+	for (int i = 0; i < 1000; i += 2) {
+		sprintf(buf, "key%d", i);
+		TEST_ASSERT_EQUAL_INT(i, *((int *) prom_map_get(map, buf)));
+	}
+
+	int expected = 0;
+	prom_map_iter_t iter;
+	prom_map_iter_init(&iter, map);
+	while (prom_map_iter_next(&iter)) {
+		TEST_ASSERT_EQUAL_INT(expected, *((int *) iter.value));
+		expected += 2;
+	}
+	TEST_ASSERT_EQUAL_INT(1000, expected);
+
+	// Re-adding deleted keys appends them.
+	for (int i = 1; i < 1000; i += 2) {
+		int *v = malloc(sizeof(int));
+		*v = i;
+		sprintf(buf, "key%d", i);
+		TEST_ASSERT_EQUAL_INT(0, prom_map_set(map, buf, v));
+	}
+	TEST_ASSERT_EQUAL_INT(1000, prom_map_size(map));
+	for (int i = 0; i < 1000; i++) {
+		sprintf(buf, "key%d", i);
+		TEST_ASSERT_EQUAL_INT(i, *((int *) prom_map_get(map, buf)));
+	}
+	prom_map_destroy(map);
+}
+
+static bool
+match_int(const void *value, const void *arg) {
+	return *((const int *) value) == *((const int *) arg);
+}
+
+void
+test_prom_map_hashed(void) {
+	prom_map_t *map = prom_map_new();
+	int values[] = { 1, 2, 3 };
+	int x = 2;
+
+	// colliding fingerprints get resolved by the match function
+	for (int i = 0; i < 3; i++)
+		TEST_ASSERT_EQUAL_INT(0, prom_map_set_hashed(map, 42, match_int,
+			&values[i], "same", &values[i]));
+	TEST_ASSERT_EQUAL_INT(3, prom_map_size(map));
+	for (int i = 0; i < 3; i++)
+		TEST_ASSERT_EQUAL_PTR(&values[i],
+			prom_map_get_hashed(map, 42, match_int, &values[i]));
+	TEST_ASSERT_EQUAL_PTR(&values[1], prom_map_get_hashed(map, 42, match_int, &x));
+	TEST_ASSERT_NULL(prom_map_get_hashed(map, 43, match_int, &x));
+	x = 4;
+	TEST_ASSERT_NULL(prom_map_get_hashed(map, 42, match_int, &x));
+
+	const char *a[] = { "ab", "c" };
+	const char *b[] = { "a", "bc" };
+	const char *c[] = { "c", "ab" };
+	TEST_ASSERT_TRUE(prom_map_hash_strings(a, 2) != prom_map_hash_strings(b, 2));
+	TEST_ASSERT_TRUE(prom_map_hash_strings(a, 2) != prom_map_hash_strings(c, 2));
+	TEST_ASSERT_TRUE(prom_map_hash_strings(a, 2) == prom_map_hash_strings(a, 2));
+	prom_map_destroy(map);
+}
+
+void
+test_prom_map_incremental_resize(void) {
+	prom_map_t *map = prom_map_new();
+	char buf[64];
+	size_t resizes = 0;
+
+	// Every insert has to be cheap, even those, which trigger a resize: no
+	// modification migrates more than a fixed number of slots.
+	for (size_t i = 0; i < 1000000; i++) {
+		sprintf(buf, "test_metric{label=\"%zu\"}", i);
+		size_t max_size = map->max_size;
+		TEST_ASSERT_EQUAL_INT(0, prom_map_set(map, buf, map));
+		if (max_size != map->max_size)
+			resizes++;
+		// lookups and deletes must work while migrating
+		if (atomic_load(&map->table)->prev != NULL && (i & 0x3ff) == 0) {
+			TEST_ASSERT_EQUAL_PTR(map, prom_map_get(map, "test_metric{label=\"1\"}"));
+			TEST_ASSERT_EQUAL_INT(0, prom_map_delete(map, buf));
+			TEST_ASSERT_NULL(prom_map_get(map, buf));
+			TEST_ASSERT_EQUAL_INT(0, prom_map_set(map, buf, map));
+		}
+	}
+	TEST_ASSERT_EQUAL_INT(1000000, prom_map_size(map));
+	TEST_ASSERT_EQUAL_INT(2097152, map->max_size);
+	for (size_t i = 0; i < 1000000; i += 997) {
+		sprintf(buf, "test_metric{label=\"%zu\"}", i);
+		TEST_ASSERT_EQUAL_PTR(map, prom_map_get(map, buf));
+	}
+	TEST_ASSERT_EQUAL_UINT(16, resizes);
+	TEST_ASSERT_EQUAL_UINT(16, map->resizes);
+	TEST_ASSERT_EQUAL_UINT(PROM_MAP_MIGRATE_STEP, map->moved_max);
+	prom_map_destroy(map);
+}
+
+#define CONCURRENT_KEYS 200000
+
+typedef struct {
+	prom_map_t *map;
+	int *values;
+	atomic_size_t published;
+	atomic_bool done;
+	size_t misses;
+} concurrent_t;
+
+static void *
+concurrent_reader(void *arg) {
+	concurrent_t *c = (concurrent_t *) arg;
+	char buf[64];
+	size_t seed = (size_t) pthread_self();
+
+	while (!atomic_load(&c->done)) {
+		size_t n = atomic_load(&c->published);
+		if (n == 0)
+			continue;
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		size_t i = (seed >> 33) % n;
+		sprintf(buf, "key%zu", i);
+		if (prom_map_get(c->map, buf) != &c->values[i])
+			c->misses++;
+	}
+	return NULL;
+}
+
+void
+test_prom_map_concurrent_get(void) {
+	concurrent_t c = { .map = prom_map_new(),
+		.values = malloc(sizeof(int) * CONCURRENT_KEYS) };
+	atomic_init(&c.published, 0);
+	atomic_init(&c.done, false);
+	pthread_t readers[3];
+	char buf[64];
+
+	// Lookups of published keys must never fail, even while the map grows
+	// and other entries get deleted.
+	for (int i = 0; i < 3; i++)
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&readers[i], NULL,
+			concurrent_reader, &c));
+	for (size_t i = 0; i < CONCURRENT_KEYS; i++) {
+		sprintf(buf, "key%zu", i);
+		TEST_ASSERT_EQUAL_INT(0, prom_map_set(c.map, buf, &c.values[i]));
+		atomic_store(&c.published, i + 1);
+		sprintf(buf, "tmp%zu", i);
+		TEST_ASSERT_EQUAL_INT(0, prom_map_set(c.map, buf, &c.values[i]));
+		if (i & 1)
+			TEST_ASSERT_EQUAL_INT(0, prom_map_delete(c.map, buf));
+		if ((i & 0xfff) == 0)
+			sched_yield();
+	}
+	atomic_store(&c.done, true);
+	for (int i = 0; i < 3; i++)
+		pthread_join(readers[i], NULL);
+
+	TEST_ASSERT_EQUAL_INT(0, c.misses);
+	TEST_ASSERT_EQUAL_INT(CONCURRENT_KEYS * 3 / 2, prom_map_size(c.map));
+	prom_map_destroy(c.map);
+	free(c.values);
+}
+
 int
 main(int argc, const char **argv) {
 	UNITY_BEGIN();
 	RUN_TEST(test_prom_map);
 	RUN_TEST(test_prom_map_when_large);
+	RUN_TEST(test_prom_map_delete);
+	RUN_TEST(test_prom_map_hashed);
+	RUN_TEST(test_prom_map_incremental_resize);
+	RUN_TEST(test_prom_map_concurrent_get);
 	return UNITY_END();
 }
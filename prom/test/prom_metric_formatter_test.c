@@ -138,6 +138,153 @@ test_pmf_load_metrics(void) {
 	PROM_COLLECTOR_REGISTRY = NULL;
 }
 
+void
+test_pmf_load_metric_pb(void) {
+	pmf_t *mf = pmf_new();
+	const char *keys[] = {"a"};
+	const char *values[] = {"b"};
+	// Reference encoding produced by protoc --encode, preceded by its length.
+	const unsigned char expected[] = {
+		0x1d, 0x0a, 0x01, 0x63, 0x12, 0x01, 0x68, 0x18, 0x00, 0x22, 0x13,
+		0x0a, 0x06, 0x0a, 0x01, 0x61, 0x12, 0x01, 0x62, 0x1a, 0x09, 0x09,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40
+	};
+	prom_metric_t *m = prom_metric_new(PROM_COUNTER, "c", "h", 1, keys);
+	pms_t *sample = pms_from_labels(m, values);
+	pms_add(sample, 2);
+
+	mf->format = PROM_FORMAT_PROTOBUF;
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(mf, m, "", false));
+	TEST_ASSERT_EQUAL_UINT(sizeof(expected), psb_len(mf->string_builder));
+	TEST_ASSERT_EQUAL_MEMORY(expected, psb_str(mf->string_builder),
+		sizeof(expected));
+	prom_metric_destroy(m);
+
+	// Compact: no help. The +Inf bucket is implied by the sample count.
+	const unsigned char hexpected[] = {
+		0x21, 0x0a, 0x01, 0x68, 0x18, 0x04, 0x22, 0x1a, 0x3a, 0x18, 0x08,
+		0x02, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x40, 0x1a,
+		0x0b, 0x08, 0x01, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0,
+		0x3f
+	};
+	prom_histogram_t *h = prom_histogram_new("h", "help", phb_new(1, 1.0),
+		0, NULL);
+	prom_histogram_observe(h, 0.5, NULL);
+	prom_histogram_observe(h, 2.5, NULL);
+	pmf_clear(mf);
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(mf, h, "", true));
+	TEST_ASSERT_EQUAL_UINT(sizeof(hexpected), psb_len(mf->string_builder));
+	TEST_ASSERT_EQUAL_MEMORY(hexpected, psb_str(mf->string_builder),
+		sizeof(hexpected));
+	prom_histogram_destroy(h);
+	pmf_destroy(mf);
+}
+
+void
+test_pmf_load_metric_om(void) {
+	pmf_t *mf = pmf_new();
+	const char *keys[] = {"a"};
+	const char *values[] = {"b"};
+	prom_metric_t *c = prom_metric_new(PROM_COUNTER, "c", "say \"hi\"\n\\",
+		1, keys);
+	prom_metric_t *t = prom_metric_new(PROM_COUNTER, "t_total", "t", 0, NULL);
+	prom_metric_t *u = prom_metric_new(PROM_UNTYPED, "u", "u", 0, NULL);
+	pms_add(pms_from_labels(c, values), 2);
+	pms_add(pms_from_labels(t, NULL), 3);
+	pms_add(pms_from_labels(u, NULL), 4);
+
+	mf->format = PROM_FORMAT_OPENMETRICS;
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(mf, c, "p_", false));
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(mf, t, NULL, false));
+	// The TYPE line is needed to make the samples counters.
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(mf, t, NULL, true));
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(mf, u, NULL, false));
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_end(mf));
+	char *result = pmf_dump(mf);
+	TEST_ASSERT_EQUAL_STRING(
+		"# HELP p_c say \\\"hi\\\"\\n\\\\\n"
+		"# TYPE p_c counter\n"
+		"p_c_total{a=\"b\"} 2\n"
+		"# HELP t t\n"
+		"# TYPE t counter\n"
+		"t_total 3\n"
+		"# TYPE t counter\n"
+		"t_total 3\n"
+		"# HELP u u\n"
+		"# TYPE u unknown\n"
+		"u 4\n"
+		"# EOF\n", result);
+	free(result);
+
+	// Other formats have no end marker.
+	mf->format = PROM_FORMAT_TEXT;
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_end(mf));
+	TEST_ASSERT_EQUAL_INT(0, psb_len(mf->string_builder));
+	prom_metric_destroy(c);
+	prom_metric_destroy(t);
+	prom_metric_destroy(u);
+	pmf_destroy(mf);
+}
+
+void
+test_pmf_load_metric_cached(void) {
+	pmf_t *mf = pmf_new();
+	const char *keys[] = { "label" };
+	const char *v1[] = { "v1" };
+	const char *v2[] = { "v2" };
+	prom_metric_t *c = prom_metric_new(PROM_COUNTER, "test_counter",
+		"counter under test", 1, keys);
+	prom_histogram_t *h = prom_histogram_new("test_histogram",
+		"histogram under test", phb_linear(1, 1, 2), 1, keys);
+	pms_add(pms_from_labels(c, v1), 1);
+	pms_add(pms_from_labels(c, v2), 2);
+	prom_histogram_observe(h, 0.5, v1);
+
+	pmf_load_metric(mf, c, NULL, false);
+	pmf_load_metric(mf, h, NULL, false);
+	char *first = pmf_dump(mf);
+	// unchanged: spliced from the cache
+	pmf_load_metric(mf, c, NULL, false);
+	pmf_load_metric(mf, h, NULL, false);
+	char *result = pmf_dump(mf);
+	TEST_ASSERT_EQUAL_STRING(first, result);
+	free(result);
+
+	pms_add(pms_from_labels(c, v2), 1);
+	prom_histogram_observe(h, 1.5, v1);
+	pmf_load_metric(mf, c, NULL, false);
+	pmf_load_metric(mf, h, NULL, false);
+	result = pmf_dump(mf);
+	TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"v1\"} 1\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result, "test_counter{label=\"v2\"} 3\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result,
+		"test_histogram_bucket{label=\"v1\",le=\"1.0\"} 1\n"
+		"test_histogram_bucket{label=\"v1\",le=\"2.0\"} 2\n"
+		"test_histogram_bucket{label=\"v1\",le=\"+Inf\"} 2\n"
+		"test_histogram_count{label=\"v1\"} 2\n"
+		"test_histogram_sum{label=\"v1\"} 2\n"));
+	free(result);
+
+	// neither prefix nor format may be taken from the cache
+	pmf_load_metric(mf, c, "p_", false);
+	result = pmf_dump(mf);
+	TEST_ASSERT_NOT_NULL(strstr(result, "# TYPE p_test_counter counter\n"));
+	TEST_ASSERT_NOT_NULL(strstr(result, "\np_test_counter{label=\"v2\"} 3\n"));
+	free(result);
+	mf->format = PROM_FORMAT_OPENMETRICS;
+	pmf_load_metric(mf, c, "p_", true);
+	result = pmf_dump(mf);
+	TEST_ASSERT_EQUAL_STRING("# TYPE p_test_counter counter\n"
+		"p_test_counter_total{label=\"v1\"} 1\n"
+		"p_test_counter_total{label=\"v2\"} 3\n", result);
+	free(result);
+
+	free(first);
+	prom_histogram_destroy(h);
+	prom_metric_destroy(c);
+	pmf_destroy(mf);
+}
+
 int
 main(int argc, const char **argv) {
 	UNITY_BEGIN();
@@ -145,5 +292,8 @@ main(int argc, const char **argv) {
 	RUN_TEST(test_pmf_load_sample);
 	RUN_TEST(test_pmf_load_metric);
 	RUN_TEST(test_pmf_load_metrics);
+	RUN_TEST(test_pmf_load_metric_pb);
+	RUN_TEST(test_pmf_load_metric_om);
+	RUN_TEST(test_pmf_load_metric_cached);
 	return UNITY_END();
 }
@@ -25,13 +25,13 @@ test_pms_add(void) {
 	TEST_ASSERT(s);
 
 	pms_add(s, 2.6);
-	TEST_ASSERT_EQUAL_DOUBLE(2.6, s->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(2.6, *s->r_value);
 
 	pms_add(s, 29.9);
-	TEST_ASSERT_EQUAL_DOUBLE(32.5, s->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(32.5, *s->r_value);
 
 	pms_add(s, 1000001.125);
-	TEST_ASSERT_EQUAL_DOUBLE(1000033.625, s->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(1000033.625, *s->r_value);
 
 	pms_destroy(s);
 }
@@ -42,10 +42,10 @@ test_pms_sub(void) {
 	TEST_ASSERT(s);
 
 	pms_sub(s, 99.91);
-	TEST_ASSERT_EQUAL_DOUBLE(0.20453210000000865, s->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.20453210000000865, *s->r_value);
 
 	pms_sub(s, 0.20453210000000865);
-	TEST_ASSERT_EQUAL_DOUBLE(0.0, s->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, *s->r_value);
 
 	pms_destroy(s);
 }
@@ -56,10 +56,38 @@ test_prom_metric_set(void) {
 	TEST_ASSERT(s);
 
 	pms_set(s, 99.91);
-	TEST_ASSERT_EQUAL_DOUBLE(99.91, s->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(99.91, *s->r_value);
 
 	pms_set(s, 0.20453210000000865);
-	TEST_ASSERT_EQUAL_DOUBLE(0.20453210000000865, s->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(0.20453210000000865, *s->r_value);
+
+	pms_destroy(s);
+}
+
+void
+test_pms_stripe(void) {
+	pms_t *s = pms_new(PROM_GAUGE, l_value, 10.0);
+	TEST_ASSERT(s);
+
+	TEST_ASSERT_EQUAL_INT(0, pms_stripe(s, 4));
+	TEST_ASSERT_EQUAL_INT(4, s->stripes->count);
+	TEST_ASSERT_EQUAL_INT(0,
+		((uintptr_t) s->stripes->cells) % PROM_CACHE_LINE_SIZE);
+	TEST_ASSERT_EQUAL_DOUBLE(10.0, pms_get(s));
+
+	pms_add(s, 2.5);
+	pms_sub(s, 0.5);
+	TEST_ASSERT_EQUAL_DOUBLE(12.0, pms_get(s));
+
+	// cells get folded into the new value
+	pms_set(s, 3.0);
+	TEST_ASSERT_EQUAL_DOUBLE(3.0, pms_get(s));
+	pms_add(s, 1.0);
+	TEST_ASSERT_EQUAL_DOUBLE(4.0, pms_get(s));
+
+	// already striped
+	TEST_ASSERT_EQUAL_INT(0, pms_stripe(s, 8));
+	TEST_ASSERT_EQUAL_INT(4, s->stripes->count);
 
 	pms_destroy(s);
 }
@@ -70,5 +98,6 @@ main(int argc, const char **argv) {
 	RUN_TEST(test_pms_add);
 	RUN_TEST(test_pms_sub);
 	RUN_TEST(test_prom_metric_set);
+	RUN_TEST(test_pms_stripe);
 	return UNITY_END();
 }
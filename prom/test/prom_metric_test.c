@@ -24,7 +24,7 @@ test_metric_with_no_labels(void) {
 	pms_t *sample = pms_from_labels(metric, NULL);
 	pms_set(sample, 1.0);
 	sample = pms_from_labels(metric, NULL);
-	TEST_ASSERT_EQUAL_DOUBLE(1.0, (_Atomic double)sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(1.0, (_Atomic double) *sample->r_value);
 	prom_metric_destroy(metric);
 	metric = NULL;
 }
@@ -37,15 +37,82 @@ test_metric_sample_from_labels(void) {
 	pms_t *sample = pms_from_labels(metric, values);
 	pms_set(sample, 1.0);
 	sample = pms_from_labels(metric, values);
-	TEST_ASSERT_EQUAL_DOUBLE(1.0, (_Atomic double)sample->r_value);
+	TEST_ASSERT_EQUAL_DOUBLE(1.0, (_Atomic double) *sample->r_value);
 	prom_metric_destroy(metric);
 	metric = NULL;
 }
 
+void
+test_metric_sample_store(void) {
+	prom_metric_t *metric = prom_metric_new(PROM_COUNTER, "test_metric",
+		"test counter", 1, (const char *[]) {"id"});
+	char label[16];
+	const char *values[] = { label };
+
+	for (int i = 0; i < 100; i++) {
+		sprintf(label, "%d", i);
+		pms_add(pms_from_labels(metric, values), i);
+	}
+	TEST_ASSERT_EQUAL_UINT(100, pms_store_count(&metric->store));
+	for (size_t id = 0; id < 100; id++) {
+		sprintf(label, "%zu", id);
+		pms_t *sample = pms_store_get(&metric->store, id);
+		// looked up samples are the ones in the store, in insertion order
+		TEST_ASSERT_EQUAL_PTR(sample, pms_from_labels(metric, values));
+		TEST_ASSERT_EQUAL_DOUBLE(id, pms_get(sample));
+		// each segment of values starts on a new cache line
+		if (((id + 1) & id) == 0) {
+			TEST_ASSERT_EQUAL_UINT(0, (uintptr_t) sample->r_value
+				% PROM_CACHE_LINE_SIZE);
+		} else {
+			TEST_ASSERT_EQUAL_PTR(pms_store_get(&metric->store,
+				id - 1)->r_value + 1, sample->r_value);
+		}
+	}
+	prom_metric_destroy(metric);
+}
+
+void
+test_metric_interned_labels(void) {
+	size_t interned = prom_intern_count();
+	const char *keys[] = { "method" };
+	const char *get[] = { "GET" };
+	const char *post[] = { "POST" };
+	prom_metric_t *a = prom_metric_new(PROM_COUNTER, "test_a", "a", 1, keys);
+	prom_metric_t *b = prom_metric_new(PROM_GAUGE, "test_b", "b", 1, keys);
+	pms_t *a_get = pms_from_labels(a, get);
+	pms_t *b_get = pms_from_labels(b, get);
+	pms_t *b_post = pms_from_labels(b, post);
+
+	// keys and values are shared across metrics and series
+	TEST_ASSERT_EQUAL_PTR(a->label_keys[0], b->label_keys[0]);
+	TEST_ASSERT_EQUAL_PTR(a_get->label_values[0], b_get->label_values[0]);
+	TEST_ASSERT_EQUAL_UINT(interned + 3, prom_intern_count());
+
+	// series render from the labels, changed values reuse the label set
+	pmf_t *pmf = pmf_new();
+	pms_set(b_get, 1);
+	pms_set(b_post, 2);
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(pmf, b, NULL, true));
+	pms_add(b_get, 2);
+	pmf_clear(pmf);
+	TEST_ASSERT_EQUAL_INT(0, pmf_load_metric(pmf, b, NULL, true));
+	TEST_ASSERT_EQUAL_STRING("test_b{method=\"GET\"} 3\n"
+		"test_b{method=\"POST\"} 2\n\n", psb_str(pmf->string_builder));
+	pmf_destroy(pmf);
+
+	prom_metric_destroy(a);
+	TEST_ASSERT_EQUAL_UINT(interned + 3, prom_intern_count());
+	prom_metric_destroy(b);
+	TEST_ASSERT_EQUAL_UINT(interned, prom_intern_count());
+}
+
 int
 main(int argc, const char **argv) {
 	UNITY_BEGIN();
 	RUN_TEST(test_metric_with_no_labels);
 	RUN_TEST(test_metric_sample_from_labels);
+	RUN_TEST(test_metric_sample_store);
+	RUN_TEST(test_metric_interned_labels);
 	return UNITY_END();
 }
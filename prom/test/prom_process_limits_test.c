@@ -53,7 +53,7 @@ test_ppc_limits(void) {
 	TEST_ASSERT_TRUE(fd[FD_LIMITS] >= 0);
 	TEST_ASSERT_EQUAL_INT(1 << PM_MAX_FDS, ppc_limits_update(fd, m, NULL));
 	pms_t *sample = pms_from_labels(m[PM_MAX_FDS], NULL);
-	TEST_ASSERT_EQUAL_INT(1048576, sample->r_value);
+	TEST_ASSERT_EQUAL_INT(1048576, *sample->r_value);
 
 	prom_gauge_destroy(m[PM_MAX_FDS]);
 	prom_gauge_destroy(n[PM_MAX_FDS]);
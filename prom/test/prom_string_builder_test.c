@@ -40,6 +40,21 @@ test_psb_add_char(void) {
 	psb_destroy(sb);
 }
 
+void
+test_psb_add_bytes(void) {
+	psb_t *sb = psb_new();
+	char bytes[300];
+	for (int i = 0; i < 300; i++)
+		bytes[i] = i % 7;
+	TEST_ASSERT_EQUAL_INT(0, psb_add_bytes(sb, bytes, 300));
+	TEST_ASSERT_EQUAL_INT(0, psb_add_bytes(sb, "x", 0));
+	TEST_ASSERT_EQUAL_INT(300, psb_len(sb));
+	TEST_ASSERT_EQUAL_MEMORY(bytes, psb_str(sb), 300);
+	TEST_ASSERT_EQUAL_INT('\0', psb_str(sb)[300]);
+
+	psb_destroy(sb);
+}
+
 void
 test_psb_dump(void) {
 	psb_t *sb = psb_new();
@@ -54,11 +69,32 @@ test_psb_dump(void) {
 	free((char *) result);
 }
 
+void
+test_psb_reset(void) {
+	psb_t *sb = psb_new();
+	TEST_ASSERT_EQUAL_INT(0, psb_reserve(sb, 4096));
+	char *buf = psb_str(sb);
+	for (int i = 0; i < 100; i++) {
+		// Neither filling nor resetting reallocates the reserved buffer.
+		for (int k = 0; k < 4000; k++)
+			psb_add_char(sb, 'x');
+		TEST_ASSERT_EQUAL_PTR(buf, psb_str(sb));
+		TEST_ASSERT_EQUAL_INT(0, psb_reset(sb));
+		TEST_ASSERT_EQUAL_INT(0, psb_len(sb));
+		TEST_ASSERT_EQUAL_STRING("", psb_str(sb));
+	}
+	psb_add_str(sb, "foo");
+	TEST_ASSERT_EQUAL_STRING("foo", psb_str(sb));
+	psb_destroy(sb);
+}
+
 int
 main(int argc, const char **argv) {
 	UNITY_BEGIN();
 	RUN_TEST(test_psb_add_str);
 	RUN_TEST(test_psb_add_char);
+	RUN_TEST(test_psb_add_bytes);
 	RUN_TEST(test_psb_dump);
+	RUN_TEST(test_psb_reset);
 	return UNITY_END();
 }
@@ -6,6 +6,7 @@
 #include "prom.h"
 #include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
+#include "prom_intern_i.h"
 #include "prom_linked_list_i.h"
 #include "prom_linked_list_t.h"
 #include "prom_map_i.h"
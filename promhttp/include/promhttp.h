@@ -24,6 +24,7 @@
  * https://www.gnu.org/software/libmicrohttpd/manual/libmicrohttpd.html#index-_002aMHD_005fAcceptPolicyCallback
  */
 
+#include <stdbool.h>
 #include <string.h>
 
 #include "microhttpd.h"
@@ -38,6 +39,44 @@
  */
 void promhttp_set_active_collector_registry(pcr_t *registry);
 
+/**
+ * @brief	Serve /metrics from a shared render instead of streaming each
+ *	request directly from the registry (the default).
+ *
+ * Requests arriving while a render is in flight wait for it and share its
+ * result (single-flight), so concurrent scrapes, e.g. by HA Prometheus
+ * pairs, run collectors only once. The number of requests by result gets
+ * counted by the metric \c promhttp_cache_requests_total of the active
+ * registry's default collector, so the active registry should be set first.
+ *
+ * @param ttl	If > 0, serve requests within \c ttl ms after a render
+ *	completed from it without touching the registry at all.
+ * @param prerender	If \c true, re-render in a background thread shortly
+ *	before the current render expires, so requests never wait for
+ *	collectors. Needs \c ttl > 0. Use \c false to stop the thread again.
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int promhttp_set_cache(unsigned int ttl, bool prerender);
+
+/**
+ * @brief	Set the zlib level used to compress /metrics responses.
+ *
+ * Responses get compressed with gzip or deflate if the request's
+ * \c Accept-Encoding header allows it. Streamed responses get compressed on
+ * the fly chunk by chunk, cached renders once per encoding and shared by all
+ * requests served from them. Uncompressed and compressed bytes as well as the
+ * time spent compressing get counted by encoding in the metrics
+ * \c promhttp_compression_input_bytes_total,
+ * \c promhttp_compression_output_bytes_total and
+ * \c promhttp_compression_seconds_total of the active registry's default
+ * collector, which get created on the first compression.
+ *
+ * @param level	\c 0 disables compression, \c 1 (the default) is the
+ *	fastest, \c 9 the best compression, \c -1 uses zlib's default (\c 6).
+ * @return A non-zero integer value upon failure, \c 0 otherwise.
+ */
+int promhttp_set_compression(int level);
+
 /**
  *  @brief Start a daemon in the background and return a reference to it.
  *
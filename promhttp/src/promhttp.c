@@ -15,7 +15,16 @@
  * limitations under the License.
  */
 
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <zlib.h>
 
 #include "microhttpd.h"
 #include "prom.h"
@@ -23,6 +32,79 @@
 
 pcr_t *PROM_ACTIVE_REGISTRY;
 
+/**
+ * @brief Content codings a /metrics response may get compressed with.
+ */
+typedef enum promhttp_encoding {
+	PROMHTTP_IDENTITY = 0,
+	PROMHTTP_GZIP,
+	PROMHTTP_DEFLATE,
+} promhttp_encoding_t;
+
+#define PROMHTTP_ENCODING_COUNT 3
+
+static const char *ENCODING[PROMHTTP_ENCODING_COUNT] = {
+	"identity", "gzip", "deflate"
+};
+
+/**
+ * @brief A rendered /metrics export shared by all requests served from it.
+ */
+typedef struct promhttp_render {
+	char *body;
+	size_t len;
+	uint64_t time;			/**< when rendering completed, in ms */
+	atomic_uint refs;
+	pthread_mutex_t lock;	/**< guards encoded */
+	/** compressed variants of the body, created on demand */
+	struct promhttp_render *encoded[PROMHTTP_ENCODING_COUNT];
+} promhttp_render_t;
+
+/**
+ * @brief The cache state of a single exposition format.
+ */
+typedef struct promhttp_slot {
+	promhttp_render_t *current;	/**< the last completed render */
+	bool rendering;			/**< whether a render is in flight */
+	uint64_t generation;	/**< number of completed renders */
+	bool requested;			/**< whether it should get prerendered */
+} promhttp_slot_t;
+
+/**
+ * @brief The render cache. Unless enabled via promhttp_set_cache(), each
+ *	request gets streamed directly from the registry.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;	/**< signals completed renders and stop */
+	bool enabled;
+	unsigned int ttl;		/**< in ms */
+	promhttp_slot_t slot[PROM_FORMAT_COUNT];	/**< by format */
+	bool prerender;			/**< whether the prerender thread should run */
+	unsigned int budget;	/**< render budget of the last request, in ms */
+	bool thread_running;
+	pthread_t thread;
+	prom_counter_t *requests;	/**< requests by result: hit, miss, shared */
+} cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static const char *CACHE_HIT[] = { "hit" };
+static const char *CACHE_MISS[] = { "miss" };
+static const char *CACHE_SHARED[] = { "shared" };
+
+/**
+ * @brief Content-Type of the response by format.
+ */
+static const char *CONTENT_TYPE[PROM_FORMAT_COUNT] = {
+	[PROM_FORMAT_TEXT] = "text/plain; version=0.0.4; charset=utf-8",
+	[PROM_FORMAT_PROTOBUF] = "application/vnd.google.protobuf; "
+		"proto=io.prometheus.client.MetricFamily; encoding=delimited",
+	[PROM_FORMAT_OPENMETRICS] =
+		"application/openmetrics-text; version=1.0.0; charset=utf-8",
+};
+
 void
 promhttp_set_active_collector_registry(pcr_t *registry) {
 	PROM_ACTIVE_REGISTRY = (registry == NULL)
@@ -32,6 +114,690 @@ promhttp_set_active_collector_registry(pcr_t *registry) {
 		PROM_WARN("No registry set to answer http requests", "");
 }
 
+static uint64_t
+now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Create a new render with the given number of references. It takes
+ *	over the given body.
+ * @return \c NULL on error, in which case the body gets freed.
+ */
+static promhttp_render_t *
+render_new(char *body, size_t len, unsigned int refs) {
+	promhttp_render_t *r = (body == NULL)
+		? NULL
+		: prom_calloc(1, sizeof(promhttp_render_t));
+	if (r == NULL) {
+		prom_free(body);
+		return NULL;
+	}
+	if (pthread_mutex_init(&r->lock, NULL)) {
+		prom_free(body);
+		prom_free(r);
+		return NULL;
+	}
+	r->body = body;
+	r->len = len;
+	r->time = now_ms();
+	atomic_init(&r->refs, refs);
+	return r;
+}
+
+static void
+render_unref(promhttp_render_t *r) {
+	if (r == NULL || atomic_fetch_sub(&r->refs, 1) != 1)
+		return;
+	for (int i = 0; i < PROMHTTP_ENCODING_COUNT; i++)
+		render_unref(r->encoded[i]);
+	pthread_mutex_destroy(&r->lock);
+	prom_free(r->body);
+	prom_free(r);
+}
+
+/**
+ * @brief Render the active registry in the given format and make it the
+ *	current render of this format. The caller must hold the cache lock and is
+ *	the only one rendering this format.
+ * @return The new render with a reference for the caller, or \c NULL.
+ */
+static promhttp_render_t *
+render_locked(prom_format_t format) {
+	promhttp_slot_t *slot = &cache.slot[format];
+	unsigned int budget = cache.budget;
+	slot->rendering = true;
+	pthread_mutex_unlock(&cache.lock);
+
+	size_t len = 0;
+	char *body = pcr_export(PROM_ACTIVE_REGISTRY, format, budget, &len);
+	// one for the cache, one for the caller
+	promhttp_render_t *r = render_new(body, len, 2);
+
+	pthread_mutex_lock(&cache.lock);
+	if (r != NULL) {
+		render_unref(slot->current);
+		slot->current = r;
+	}
+	slot->rendering = false;
+	slot->generation++;
+	pthread_cond_broadcast(&cache.cond);
+	return r;
+}
+
+/**
+ * @brief Get a render to answer a /metrics request with: a cached one, if
+ *	still fresh, the one currently in flight, or a new one.
+ * @param format	The format requested.
+ * @param budget	Time budget for a new render in ms, \c 0 if unknown.
+ * @return A render with a reference for the caller, or \c NULL on error.
+ */
+static promhttp_render_t *
+render_get(prom_format_t format, unsigned int budget) {
+	promhttp_slot_t *slot = &cache.slot[format];
+	promhttp_render_t *r = NULL;
+	const char **result = CACHE_MISS;
+
+	pthread_mutex_lock(&cache.lock);
+	// Prerendering uses the one of the last request.
+	if (budget > 0)
+		cache.budget = budget;
+	if (!slot->requested) {
+		slot->requested = true;
+		pthread_cond_broadcast(&cache.cond);
+	}
+	uint64_t generation = slot->generation;
+	for (;;) {
+		if (slot->current != NULL && cache.ttl > 0
+			&& now_ms() - slot->current->time < cache.ttl)
+		{
+			r = slot->current;
+			result = CACHE_HIT;
+			break;
+		}
+		if (!slot->rendering) {
+			if (generation != slot->generation && slot->current != NULL) {
+				// Someone rendered for us while we were waiting.
+				r = slot->current;
+				result = CACHE_SHARED;
+				break;
+			}
+			r = render_locked(format);
+			pthread_mutex_unlock(&cache.lock);
+			goto end;
+		}
+		pthread_cond_wait(&cache.cond, &cache.lock);
+	}
+	atomic_fetch_add(&r->refs, 1);
+	pthread_mutex_unlock(&cache.lock);
+
+end:
+	if (cache.requests != NULL)
+		prom_counter_inc(cache.requests, result);
+	return r;
+}
+
+/**
+ * @brief Keeps the cache warm: renders whenever the current render of a
+ *	format requested so far is about to expire. Text always gets prerendered.
+ */
+static void *
+prerender_thread(void *arg) {
+	pthread_mutex_lock(&cache.lock);
+	cache.slot[PROM_FORMAT_TEXT].requested = true;
+	while (cache.prerender) {
+		uint64_t now = now_ms();
+		uint64_t due = UINT64_MAX;
+		bool rendered = false;
+		for (int format = 0; format < PROM_FORMAT_COUNT; format++) {
+			promhttp_slot_t *slot = &cache.slot[format];
+			if (!slot->requested)
+				continue;
+			uint64_t t = (slot->current == NULL) ? now
+				: slot->current->time + cache.ttl - cache.ttl / 4;
+			if (t <= now && !slot->rendering) {
+				promhttp_render_t *r = render_locked(format);
+				render_unref(r);
+				if (r != NULL) {
+					rendered = true;
+					break;
+				}
+			}
+			if (t < due)
+				due = t;
+		}
+		if (rendered)
+			continue;
+		// Retry failed renders after a while, too.
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		uint64_t ms = (due == UINT64_MAX) ? cache.ttl
+			: (due > now) ? due - now : cache.ttl / 4 + 1;
+		ts.tv_sec += ms / 1000;
+		ts.tv_nsec += (ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&cache.cond, &cache.lock, &ts);
+	}
+	pthread_mutex_unlock(&cache.lock);
+	return NULL;
+}
+
+int
+promhttp_set_cache(unsigned int ttl, bool prerender) {
+	if (prerender && ttl == 0) {
+		PROM_WARN("Prerendering needs a TTL > 0.", NULL);
+		return 1;
+	}
+
+	// Count requests by result in the active registry.
+	if (cache.requests == NULL && PROM_ACTIVE_REGISTRY != NULL) {
+		const char *label[] = { "result" };
+		prom_counter_t *c = prom_counter_new("promhttp_cache_requests_total",
+			"Number of /metrics requests by cache result: hit (cached render), "
+			"shared (render in flight) or miss (new render).", 1, label);
+		if (c != NULL && prom_collector_add_metric(pcr_get(PROM_ACTIVE_REGISTRY,
+			COLLECTOR_NAME_DEFAULT), c) == 0)
+		{
+			cache.requests = c;
+		} else {
+			prom_counter_destroy(c);
+		}
+	}
+
+	pthread_mutex_lock(&cache.lock);
+	bool stop = cache.thread_running && !prerender;
+	cache.enabled = true;
+	cache.ttl = ttl;
+	cache.prerender = prerender;
+	pthread_cond_broadcast(&cache.cond);
+	pthread_mutex_unlock(&cache.lock);
+
+	if (stop) {
+		pthread_join(cache.thread, NULL);
+		cache.thread_running = false;
+	}
+	if (prerender && !cache.thread_running) {
+		if (pthread_create(&cache.thread, NULL, prerender_thread, NULL)) {
+			PROM_WARN("Unable to start the prerender thread.", NULL);
+			return 2;
+		}
+		cache.thread_running = true;
+	}
+	return 0;
+}
+
+/**
+ * @brief The zlib compression level used by default: fast, but already
+ *	shrinks text exports to about a tenth.
+ */
+#define PROMHTTP_COMPRESSION_LEVEL 1
+
+/**
+ * @brief Response compression settings and self-metrics.
+ */
+static struct {
+	pthread_mutex_t lock;	/**< guards the creation of the metrics */
+	atomic_int level;		/**< zlib level, 0 = no compression */
+	bool metrics;			/**< whether the metrics got created */
+	prom_counter_t *input;	/**< bytes compressed by encoding */
+	prom_counter_t *output;	/**< compressed bytes by encoding */
+	prom_counter_t *seconds;	/**< time spent compressing by encoding */
+} compression = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.level = PROMHTTP_COMPRESSION_LEVEL,
+};
+
+int
+promhttp_set_compression(int level) {
+	if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION) {
+		PROM_WARN("Invalid compression level %d.", level);
+		return 1;
+	}
+	atomic_store(&compression.level, level);
+	return 0;
+}
+
+/**
+ * @brief Create a counter labeled by encoding in the active registry.
+ * @return \c NULL on error.
+ */
+static prom_counter_t *
+compression_counter(const char *name, const char *help) {
+	const char *label[] = { "encoding" };
+	prom_counter_t *c = prom_counter_new(name, help, 1, label);
+	if (c != NULL && prom_collector_add_metric(pcr_get(PROM_ACTIVE_REGISTRY,
+		COLLECTOR_NAME_DEFAULT), c))
+	{
+		prom_counter_destroy(c);
+		c = NULL;
+	}
+	return c;
+}
+
+/**
+ * @brief Account a compression. The metrics get created in the active
+ *	registry on first use, so that they show up only if compression is used.
+ */
+static void
+compression_account(promhttp_encoding_t encoding, uint64_t input,
+	uint64_t output, double seconds)
+{
+	const char *labels[] = { ENCODING[encoding] };
+
+	pthread_mutex_lock(&compression.lock);
+	if (!compression.metrics && PROM_ACTIVE_REGISTRY != NULL) {
+		compression.metrics = true;
+		compression.input = compression_counter(
+			"promhttp_compression_input_bytes_total",
+			"Number of /metrics response bytes before compression.");
+		compression.output = compression_counter(
+			"promhttp_compression_output_bytes_total",
+			"Number of /metrics response bytes after compression.");
+		compression.seconds = compression_counter(
+			"promhttp_compression_seconds_total",
+			"Time spent compressing /metrics responses in seconds.");
+	}
+	pthread_mutex_unlock(&compression.lock);
+
+	if (compression.input != NULL)
+		prom_counter_add(compression.input, input, labels);
+	if (compression.output != NULL)
+		prom_counter_add(compression.output, output, labels);
+	if (compression.seconds != NULL)
+		prom_counter_add(compression.seconds, seconds, labels);
+}
+
+static double
+elapsed(struct timespec *start) {
+	struct timespec end;
+	if (clock_gettime(CLOCK_MONOTONIC, &end))
+		return 0;
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/**
+ * @brief Prepare the given stream to compress with the given encoding.
+ * @return \c 0 on success, a non-zero value otherwise.
+ */
+static int
+compression_init(z_stream *z, promhttp_encoding_t encoding) {
+	memset(z, 0, sizeof(z_stream));
+	// gzip wraps the deflate stream in a gzip header, deflate in a zlib one.
+	int bits = (encoding == PROMHTTP_GZIP) ? 15 + 16 : 15;
+	return deflateInit2(z, atomic_load(&compression.level), Z_DEFLATED, bits,
+		8, Z_DEFAULT_STRATEGY) != Z_OK;
+}
+
+/**
+ * @brief Compress the given render with the given encoding at once.
+ * @return A new render with one reference, or \c NULL on error.
+ */
+static promhttp_render_t *
+render_compress(promhttp_render_t *r, promhttp_encoding_t encoding) {
+	struct timespec start;
+	z_stream z;
+	size_t len = 0;
+	char *body = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (compression_init(&z, encoding))
+		return NULL;
+	uLong size = deflateBound(&z, r->len);
+	if ((body = prom_malloc(size)) != NULL) {
+		z.next_in = (Bytef *) r->body;
+		z.avail_in = r->len;
+		z.next_out = (Bytef *) body;
+		z.avail_out = size;
+		if (deflate(&z, Z_FINISH) == Z_STREAM_END) {
+			len = z.total_out;
+		} else {
+			prom_free(body);
+			body = NULL;
+		}
+	}
+	deflateEnd(&z);
+	if (body == NULL)
+		return NULL;
+	compression_account(encoding, r->len, len, elapsed(&start));
+	promhttp_render_t *c = render_new(body, len, 1);
+	if (c != NULL)
+		c->time = r->time;
+	return c;
+}
+
+/**
+ * @brief Get the given render compressed with the given encoding. Gets
+ *	compressed only once, all other requests share the result.
+ * @return The compressed render with a reference for the caller, or \c NULL
+ *	on error.
+ */
+static promhttp_render_t *
+render_encoded(promhttp_render_t *r, promhttp_encoding_t encoding) {
+	pthread_mutex_lock(&r->lock);
+	if (r->encoded[encoding] == NULL)
+		r->encoded[encoding] = render_compress(r, encoding);
+	promhttp_render_t *c = r->encoded[encoding];
+	if (c != NULL)
+		atomic_fetch_add(&c->refs, 1);
+	pthread_mutex_unlock(&r->lock);
+	return c;
+}
+
+/**
+ * @brief A /metrics response streamed from a cursor through the compressor.
+ */
+typedef struct promhttp_stream {
+	z_stream z;
+	promhttp_encoding_t encoding;
+	pcr_cursor_t *cursor;
+	bool eof;				/**< whether the cursor is exhausted */
+	bool done;				/**< whether the compressor is done */
+	double seconds;			/**< time spent compressing */
+	size_t len;				/**< bytes in the input buffer */
+	char in[];
+} promhttp_stream_t;
+
+/**
+ * @brief Create a new compressing stream for the given cursor.
+ * @return \c NULL on error.
+ */
+static promhttp_stream_t *
+promhttp_stream_new(pcr_cursor_t *cursor, promhttp_encoding_t encoding,
+	size_t size)
+{
+	promhttp_stream_t *s = prom_malloc(sizeof(promhttp_stream_t) + size);
+	if (s == NULL)
+		return NULL;
+	if (compression_init(&s->z, encoding)) {
+		prom_free(s);
+		return NULL;
+	}
+	s->encoding = encoding;
+	s->cursor = cursor;
+	s->eof = s->done = false;
+	s->seconds = 0;
+	s->len = size;
+	return s;
+}
+
+static ssize_t
+promhttp_read_stream(void *cls, uint64_t pos, char *buf, size_t max) {
+	promhttp_stream_t *s = (promhttp_stream_t *) cls;
+	struct timespec start;
+
+	s->z.next_out = (Bytef *) buf;
+	s->z.avail_out = max;
+	// deflate() buffers internally: feed it until something comes out.
+	while (s->z.avail_out == max && !s->done) {
+		if (s->z.avail_in == 0 && !s->eof) {
+			ssize_t n = pcr_cursor_read(s->cursor, s->in, s->len);
+			if (n < 0)
+				return MHD_CONTENT_READER_END_WITH_ERROR;
+			s->eof = n == 0;
+			s->z.next_in = (Bytef *) s->in;
+			s->z.avail_in = n;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		int ret = deflate(&s->z, s->eof ? Z_FINISH : Z_NO_FLUSH);
+		s->seconds += elapsed(&start);
+		if (ret == Z_STREAM_END)
+			s->done = true;
+		else if (ret != Z_OK && ret != Z_BUF_ERROR)
+			return MHD_CONTENT_READER_END_WITH_ERROR;
+	}
+	size_t n = max - s->z.avail_out;
+	return (n == 0) ? MHD_CONTENT_READER_END_OF_STREAM : n;
+}
+
+static void
+promhttp_free_stream(void *cls) {
+	promhttp_stream_t *s = (promhttp_stream_t *) cls;
+	compression_account(s->encoding, s->z.total_in, s->z.total_out,
+		s->seconds);
+	deflateEnd(&s->z);
+	pcr_cursor_destroy(s->cursor);
+	prom_free(s);
+}
+
+/**
+ * @brief Share of the scrape timeout announced by Prometheus in percent,
+ *	which may be spent on rendering. The rest is left for the transfer.
+ */
+#define PROMHTTP_BUDGET_SHARE 90
+
+/**
+ * @brief Get the time budget for rendering the response to the given
+ *	request from the scrape timeout Prometheus sends along.
+ * @return The budget in ms, \c 0 if unknown.
+ */
+static unsigned int
+scrape_budget(struct MHD_Connection *connection) {
+	const char *s = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+		"X-Prometheus-Scrape-Timeout-Seconds");
+	if (s == NULL)
+		return 0;
+
+	char *end;
+	double timeout = strtod(s, &end);
+	if (end == s || !(timeout > 0) || timeout > 86400)
+		return 0;
+	unsigned int budget = timeout * 10 * PROMHTTP_BUDGET_SHARE;
+	return (budget == 0) ? 1 : budget;
+}
+
+/**
+ * @brief Get the quality value of the given media range parameters.
+ * @param params	The parameters following the media type, i.e. either
+ *	empty or starting with a \c ';'.
+ * @param format	The format the media type stands for. Protobuf requires
+ *	the MetricFamily message in delimited encoding, OpenMetrics a version
+ *	compatible with 1.0.0, if any. Text imposes no constraints, so it can be
+ *	used for any header with q-values.
+ * @return The q-value in the range 0..1000, \c 0 if not acceptable.
+ */
+static unsigned int
+accept_quality(const char *params, size_t len, prom_format_t format) {
+	unsigned int q = 1000;
+	bool message = false, delimited = true, version = true;
+
+	while (len > 0) {
+		size_t n;
+		// skip ';' and whitespace
+		while (len > 0 && (*params == ';' || isspace((unsigned char) *params)))
+		{
+			params++;
+			len--;
+		}
+		for (n = 0; n < len && params[n] != ';'; n++)
+			;
+		if (n > 2 && strncasecmp(params, "q=", 2) == 0) {
+			double d = strtod(params + 2, NULL);
+			q = (d > 0 && d <= 1) ? d * 1000 + 0.5 : 0;
+		} else if (n == 39 && strncmp(params,
+			"proto=io.prometheus.client.MetricFamily", 39) == 0)
+		{
+			message = true;
+		} else if (n >= 9 && strncasecmp(params, "encoding=", 9) == 0) {
+			delimited = n == 18
+				&& strncasecmp(params + 9, "delimited", 9) == 0;
+		} else if (n >= 8 && strncasecmp(params, "version=", 8) == 0) {
+			// 0.0.1 is what Prometheus asks for besides 1.0.0.
+			version = (n == 13 && (strncmp(params + 8, "1.0.0", 5) == 0
+				|| strncmp(params + 8, "0.0.1", 5) == 0));
+		}
+		params += n;
+		len -= n;
+	}
+	if (format == PROM_FORMAT_PROTOBUF)
+		return (message && delimited) ? q : 0;
+	if (format == PROM_FORMAT_OPENMETRICS)
+		return version ? q : 0;
+	return q;
+}
+
+/**
+ * @brief Choose the exposition format for the response to the given request
+ *	based on its Accept header: the one with the highest q-value. Text wins
+ *	ties and is the default, other formats get used only if explicitly asked
+ *	for.
+ */
+static prom_format_t
+accept_format(struct MHD_Connection *connection) {
+	const char *s = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+		"Accept");
+	unsigned int best[PROM_FORMAT_COUNT] = { 0 };
+	prom_format_t format = PROM_FORMAT_TEXT;
+
+	if (s == NULL)
+		return format;
+	while (*s != '\0') {
+		size_t n, type;
+		while (*s == ',' || isspace((unsigned char) *s))
+			s++;
+		for (n = 0; s[n] != '\0' && s[n] != ','; n++)
+			;
+		for (type = 0; type < n && s[type] != ';'
+			&& !isspace((unsigned char) s[type]); type++)
+			;
+		int f = -1;
+		if (type == 31
+			&& strncasecmp(s, "application/vnd.google.protobuf", 31) == 0)
+		{
+			f = PROM_FORMAT_PROTOBUF;
+		} else if (type == 28
+			&& strncasecmp(s, "application/openmetrics-text", 28) == 0)
+		{
+			f = PROM_FORMAT_OPENMETRICS;
+		} else if ((type == 10 && strncasecmp(s, "text/plain", 10) == 0)
+			|| (type == 6 && strncasecmp(s, "text/*", 6) == 0)
+			|| (type == 3 && strncmp(s, "*/*", 3) == 0))
+		{
+			f = PROM_FORMAT_TEXT;
+		}
+		if (f >= 0) {
+			unsigned int q = accept_quality(s + type, n - type, f);
+			if (q > best[f])
+				best[f] = q;
+		}
+		s += n;
+	}
+	for (int f = 0; f < PROM_FORMAT_COUNT; f++) {
+		if (best[f] > best[format])
+			format = f;
+	}
+	return format;
+}
+
+/**
+ * @brief Choose the content coding for the response to the given request
+ *	based on its Accept-Encoding header: the compression with the highest
+ *	q-value, unless identity is preferred explicitly. gzip wins ties.
+ */
+static promhttp_encoding_t
+accept_encoding(struct MHD_Connection *connection) {
+	if (atomic_load(&compression.level) == 0)
+		return PROMHTTP_IDENTITY;
+	const char *s = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+		MHD_HTTP_HEADER_ACCEPT_ENCODING);
+	// -1: not mentioned
+	int q[PROMHTTP_ENCODING_COUNT] = { -1, -1, -1 };
+	int any = -1;
+	promhttp_encoding_t encoding = PROMHTTP_IDENTITY;
+
+	if (s == NULL)
+		return encoding;
+	while (*s != '\0') {
+		size_t n, type;
+		while (*s == ',' || isspace((unsigned char) *s))
+			s++;
+		for (n = 0; s[n] != '\0' && s[n] != ','; n++)
+			;
+		for (type = 0; type < n && s[type] != ';'
+			&& !isspace((unsigned char) s[type]); type++)
+			;
+		int v = accept_quality(s + type, n - type, PROM_FORMAT_TEXT);
+		if (type == 1 && *s == '*') {
+			any = v;
+		} else {
+			for (int i = 0; i < PROMHTTP_ENCODING_COUNT; i++) {
+				if (strlen(ENCODING[i]) == type
+					&& strncasecmp(s, ENCODING[i], type) == 0)
+				{
+					q[i] = v;
+				}
+			}
+		}
+		s += n;
+	}
+	int best = 0;
+	for (int i = PROMHTTP_GZIP; i < PROMHTTP_ENCODING_COUNT; i++) {
+		int v = (q[i] < 0) ? any : q[i];
+		if (v > best) {
+			best = v;
+			encoding = i;
+		}
+	}
+	return (q[PROMHTTP_IDENTITY] > best) ? PROMHTTP_IDENTITY : encoding;
+}
+
+/**
+ * @brief Add the headers describing the body of a /metrics response.
+ */
+static void
+add_headers(struct MHD_Response *response, prom_format_t format,
+	promhttp_encoding_t encoding)
+{
+	MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE,
+		CONTENT_TYPE[format]);
+	MHD_add_response_header(response, MHD_HTTP_HEADER_VARY,
+		"Accept, Accept-Encoding");
+	if (encoding != PROMHTTP_IDENTITY)
+		MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING,
+			ENCODING[encoding]);
+}
+
+static ssize_t
+promhttp_read_render(void *cls, uint64_t pos, char *buf, size_t max) {
+	promhttp_render_t *r = (promhttp_render_t *) cls;
+	if (pos >= r->len)
+		return MHD_CONTENT_READER_END_OF_STREAM;
+	size_t n = r->len - pos;
+	if (n > max)
+		n = max;
+	memcpy(buf, r->body + pos, n);
+	return n;
+}
+
+static void
+promhttp_free_render(void *cls) {
+	render_unref((promhttp_render_t *) cls);
+}
+
+/**
+ * @brief Size of the chunks /metrics gets streamed with. Output starts as
+ *	soon as the first one is rendered, and no more than about one chunk per
+ *	connection gets buffered.
+ */
+#define PROMHTTP_CHUNK_SIZE (64 * 1024)
+
+static ssize_t
+promhttp_read_metrics(void *cls, uint64_t pos, char *buf, size_t max) {
+	ssize_t n = pcr_cursor_read((pcr_cursor_t *) cls, buf, max);
+	if (n < 0)
+		return MHD_CONTENT_READER_END_WITH_ERROR;
+	return (n == 0) ? MHD_CONTENT_READER_END_OF_STREAM : n;
+}
+
+static void
+promhttp_free_metrics(void *cls) {
+	pcr_cursor_destroy((pcr_cursor_t *) cls);
+}
+
 int
 promhttp_handler(void *cls, struct MHD_Connection *connection, const char *url,
 	const char *method, const char *version, const char *upload_data,
@@ -39,7 +805,6 @@ promhttp_handler(void *cls, struct MHD_Connection *connection, const char *url,
 {
 	char *body;
 	struct MHD_Response *response;
-	enum MHD_ResponseMemoryMode mode = MHD_RESPMEM_PERSISTENT;
 	unsigned int status = MHD_HTTP_BAD_REQUEST;
 
 	int ret;
@@ -49,18 +814,71 @@ promhttp_handler(void *cls, struct MHD_Connection *connection, const char *url,
 	} else if (strcmp(url, "/") == 0) {
 		body = "<html><body>See <a href='/metrics'>/metrics</a>.\r\n";
 		status = MHD_HTTP_OK;
+	} else if (strcmp(url, "/metrics") == 0 && cache.enabled) {
+		prom_format_t format = accept_format(connection);
+		promhttp_encoding_t encoding = accept_encoding(connection);
+		promhttp_render_t *r = render_get(format, scrape_budget(connection));
+		if (r == NULL)
+			return MHD_NO;
+		if (encoding != PROMHTTP_IDENTITY) {
+			promhttp_render_t *c = render_encoded(r, encoding);
+			if (c == NULL) {
+				encoding = PROMHTTP_IDENTITY;
+			} else {
+				render_unref(r);
+				r = c;
+			}
+		}
+		response = MHD_create_response_from_callback(r->len,
+			PROMHTTP_CHUNK_SIZE, &promhttp_read_render, r,
+			&promhttp_free_render);
+		if (response == NULL) {
+			render_unref(r);
+			return MHD_NO;
+		}
+		add_headers(response, format, encoding);
+		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+		MHD_destroy_response(response);
+		return ret;
 	} else if (strcmp(url, "/metrics") == 0) {
-		body = pcr_bridge(PROM_ACTIVE_REGISTRY);
-		mode = MHD_RESPMEM_MUST_FREE;
-		status = MHD_HTTP_OK;
+		prom_format_t format = accept_format(connection);
+		promhttp_encoding_t encoding = accept_encoding(connection);
+		pcr_cursor_t *cursor = pcr_cursor_new_format(PROM_ACTIVE_REGISTRY,
+			format);
+		if (cursor == NULL)
+			return MHD_NO;
+		pcr_cursor_set_timeout(cursor, scrape_budget(connection));
+		promhttp_stream_t *stream = (encoding == PROMHTTP_IDENTITY)
+			? NULL
+			: promhttp_stream_new(cursor, encoding, PROMHTTP_CHUNK_SIZE);
+		if (stream == NULL) {
+			encoding = PROMHTTP_IDENTITY;
+			response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN,
+				PROMHTTP_CHUNK_SIZE, &promhttp_read_metrics, cursor,
+				&promhttp_free_metrics);
+		} else {
+			response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN,
+				PROMHTTP_CHUNK_SIZE, &promhttp_read_stream, stream,
+				&promhttp_free_stream);
+		}
+		if (response == NULL) {
+			if (stream == NULL)
+				pcr_cursor_destroy(cursor);
+			else
+				promhttp_free_stream(stream);
+			return MHD_NO;
+		}
+		add_headers(response, format, encoding);
+		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+		MHD_destroy_response(response);
+		return ret;
 	} else {
 		body = "Bad Request\n";
 	}
 
-	response = MHD_create_response_from_buffer(strlen(body), body, mode);
+	response = MHD_create_response_from_buffer(strlen(body), body,
+		MHD_RESPMEM_PERSISTENT);
 	if (response == NULL) {
-		if (mode == MHD_RESPMEM_MUST_FREE)
-			free(body);
 		ret = MHD_NO;
 	} else {
 		ret = MHD_queue_response(connection, status, response);